@@ -0,0 +1,195 @@
+/*
+ * Copyright (C) 2023 Nikolas Koesling <nikolas@koesling.info>.
+ * This program is free software. You can redistribute it and/or modify it under the terms of the MIT License.
+ */
+
+#include "Analog_Scaling.hpp"
+
+#include <array>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+#if defined(__SSE2__)
+#    include <immintrin.h>
+#elif defined(__ARM_NEON)
+#    include <arm_neon.h>
+#endif
+
+namespace {
+
+struct Default_Parameters {
+    uint16_t                                product_id;
+    WAGO_Modbus::Analog_Scaling::Parameters parameters;
+};
+
+// values according to the data sheets of the 750-4xx modules (0x7FFF: upper end of the measuring range)
+// the lowest three bits of the 12 bit modules contain status information
+constexpr std::array<Default_Parameters, 13> DEFAULT_PARAMETERS = {{
+        {452, {0.0F, 20.0F / 32767.0F, 0x0007, false}},  // 2 channels, 0 ... 20 mA
+        {453, {0.0F, 20.0F / 32767.0F, 0x0007, false}},  // 4 channels, 0 ... 20 mA
+        {454, {4.0F, 16.0F / 32767.0F, 0x0007, false}},  // 2 channels, 4 ... 20 mA
+        {455, {4.0F, 16.0F / 32767.0F, 0x0007, false}},  // 4 channels, 4 ... 20 mA
+        {456, {0.0F, 10.0F / 32767.0F, 0x0007, true}},   // 2 channels, -10 ... 10 V
+        {457, {0.0F, 10.0F / 32767.0F, 0x0007, true}},   // 4 channels, -10 ... 10 V
+        {459, {0.0F, 10.0F / 32767.0F, 0x0007, false}},  // 4 channels, 0 ... 10 V
+        {460, {0.0F, 0.1F, 0x0000, true}},               // 4 channels, Pt100 (°C)
+        {461, {0.0F, 0.1F, 0x0000, true}},               // 2 channels, Pt100 (°C)
+        {466, {4.0F, 16.0F / 32767.0F, 0x0007, false}},  // 2 channels, 4 ... 20 mA
+        {467, {0.0F, 10.0F / 32767.0F, 0x0007, false}},  // 2 channels, 0 ... 10 V
+        {468, {0.0F, 10.0F / 32767.0F, 0x0007, false}},  // 4 channels, 0 ... 10 V
+        {469, {0.0F, 0.1F, 0x0000, true}},               // 2 channels, thermocouple (°C)
+}};
+
+}  // namespace
+
+WAGO_Modbus::Analog_Scaling::Parameters WAGO_Modbus::Analog_Scaling::get_default(uint16_t product_id) noexcept {
+    for (const auto &entry : DEFAULT_PARAMETERS)
+        if (entry.product_id == product_id) return entry.parameters;
+    return {};
+}
+
+void WAGO_Modbus::Analog_Scaling::load_config(const std::string &path) {
+    std::ifstream file(path);
+    if (!file.is_open()) throw std::runtime_error("failed to open scaling configuration '" + path + '\'');
+
+    std::string line;
+    std::size_t line_number = 0;
+    while (std::getline(file, line)) {
+        ++line_number;
+
+        std::istringstream sstr(line);
+        std::string        first;
+        if (!(sstr >> first) || first[0] == '#') continue;
+
+        auto invalid = [&]() {
+            std::ostringstream msg;
+            msg << "invalid scaling configuration in line " << line_number << " of '" << path << '\'';
+            return std::runtime_error(msg.str());
+        };
+
+        Parameters  parameters;
+        std::size_t module = 0;
+        try {
+            std::size_t pos = 0;
+            module          = std::stoul(first, &pos, 10);
+            if (pos != first.size() || module == 0) throw invalid();
+        } catch (const std::logic_error &) { throw invalid(); }
+
+        if (!(sstr >> parameters.offset >> parameters.gain)) throw invalid();
+
+        std::string mask;
+        if (sstr >> mask) {
+            try {
+                std::size_t pos   = 0;
+                const auto  value = std::stoul(mask, &pos, 0);
+                if (pos != mask.size() || value > UINT16_MAX) throw invalid();
+                parameters.status_mask = static_cast<uint16_t>(value);
+            } catch (const std::logic_error &) { throw invalid(); }
+
+            std::string sign;
+            if (sstr >> sign) {
+                if (sign == "signed") parameters.is_signed = true;
+                else if (sign != "unsigned")
+                    throw invalid();
+            }
+        }
+
+        std::string rest;
+        if (sstr >> rest) throw invalid();
+
+        set_parameters(module, parameters);
+    }
+}
+
+void WAGO_Modbus::Analog_Scaling::set_parameters(std::size_t module, const Parameters &parameters) {
+    overrides[module] = parameters;
+}
+
+void WAGO_Modbus::Analog_Scaling::build(const Clamp_Table &clamps) {
+    offset.clear();
+    gain.clear();
+    keep.clear();
+    flip.clear();
+
+    for (const auto &[module, parameters] : overrides) {
+        if (module > clamps.size() || clamps.get_size(module - 1, AI) == 0) {
+            std::ostringstream sstr;
+            sstr << "scaling configured for module " << module << ", but it is not an analog input module";
+            throw std::runtime_error(sstr.str());
+        }
+    }
+
+    for (std::size_t i = 0; i < clamps.size(); ++i) {
+        const auto channels = clamps.get_size(i, AI);
+        if (channels == 0) continue;
+
+        const auto configured = overrides.find(i + 1);
+        const auto parameters =
+                configured != overrides.end() ? configured->second : get_default(clamps.get_clampconfig(i));
+
+        // unsigned values are converted as signed values with flipped sign bit (raw - 0x8000)
+        // --> compensate by offset
+        const float bias = parameters.is_signed ? 0.0F : parameters.gain * 32768.0F;
+
+        offset.insert(offset.end(), channels, parameters.offset + bias);
+        gain.insert(gain.end(), channels, parameters.gain);
+        keep.insert(keep.end(), channels, static_cast<uint16_t>(~parameters.status_mask));
+        flip.insert(flip.end(), channels, static_cast<uint16_t>(parameters.is_signed ? 0x0000 : 0x8000));
+    }
+}
+
+void WAGO_Modbus::Analog_Scaling::apply(const uint16_t *raw, float *result) const noexcept {
+    const std::size_t n = gain.size();
+    std::size_t       i = 0;
+
+#if defined(__AVX2__)
+    for (; i + 8 <= n; i += 8) {
+        __m128i v, k, f;
+        std::memcpy(&v, raw + i, sizeof(v));
+        std::memcpy(&k, keep.data() + i, sizeof(k));
+        std::memcpy(&f, flip.data() + i, sizeof(f));
+        v = _mm_xor_si128(_mm_and_si128(v, k), f);
+
+        const __m256 value = _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(v));
+        const __m256 eu    = _mm256_add_ps(_mm256_loadu_ps(offset.data() + i),
+                                        _mm256_mul_ps(_mm256_loadu_ps(gain.data() + i), value));
+        _mm256_storeu_ps(result + i, eu);
+    }
+#elif defined(__SSE2__)
+    for (; i + 8 <= n; i += 8) {
+        __m128i v, k, f;
+        std::memcpy(&v, raw + i, sizeof(v));
+        std::memcpy(&k, keep.data() + i, sizeof(k));
+        std::memcpy(&f, flip.data() + i, sizeof(f));
+        v = _mm_xor_si128(_mm_and_si128(v, k), f);
+
+        // sign extension to 32 bit
+        const __m128 lo = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16));
+        const __m128 hi = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16));
+        _mm_storeu_ps(result + i,
+                      _mm_add_ps(_mm_loadu_ps(offset.data() + i), _mm_mul_ps(_mm_loadu_ps(gain.data() + i), lo)));
+        _mm_storeu_ps(result + i + 4,
+                      _mm_add_ps(_mm_loadu_ps(offset.data() + i + 4),
+                                 _mm_mul_ps(_mm_loadu_ps(gain.data() + i + 4), hi)));
+    }
+#elif defined(__ARM_NEON)
+    for (; i + 8 <= n; i += 8) {
+        const uint16x8_t v = veorq_u16(vandq_u16(vld1q_u16(raw + i), vld1q_u16(keep.data() + i)),
+                                       vld1q_u16(flip.data() + i));
+        const int16x8_t  s = vreinterpretq_s16_u16(v);
+
+        const float32x4_t lo = vcvtq_f32_s32(vmovl_s16(vget_low_s16(s)));
+        const float32x4_t hi = vcvtq_f32_s32(vmovl_s16(vget_high_s16(s)));
+        vst1q_f32(result + i, vaddq_f32(vld1q_f32(offset.data() + i), vmulq_f32(vld1q_f32(gain.data() + i), lo)));
+        vst1q_f32(result + i + 4,
+                  vaddq_f32(vld1q_f32(offset.data() + i + 4), vmulq_f32(vld1q_f32(gain.data() + i + 4), hi)));
+    }
+#endif
+
+    for (; i < n; ++i) {
+        const auto value = static_cast<int16_t>((raw[i] & keep[i]) ^ flip[i]);
+        result[i]        = offset[i] + gain[i] * static_cast<float>(value);
+    }
+}
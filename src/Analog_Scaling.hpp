@@ -0,0 +1,100 @@
+/*
+ * Copyright (C) 2023 Nikolas Koesling <nikolas@koesling.info>.
+ * This program is free software. You can redistribute it and/or modify it under the terms of the MIT License.
+ */
+
+#pragma once
+
+#include "WAGO_MB_Clamps.hpp"
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace WAGO_Modbus {
+
+/**
+ * @brief conversion of the analog input image to engineering units
+ * @details
+ *      Each analog input channel is converted by
+ *          value = offset + gain * raw
+ *      where raw is the register value with the status bits cleared (interpreted as signed or unsigned).
+ *
+ *      The parameters of a module are taken from a built-in table (by product id)
+ *      and can be overwritten per module by a configuration file.
+ */
+class Analog_Scaling final {
+public:
+    /**
+     * @brief scaling parameters of one module
+     */
+    struct Parameters {
+        float    offset      = 0.0F;   //*< value of raw count 0
+        float    gain        = 1.0F;   //*< value per raw count
+        uint16_t status_mask = 0;      //*< status bits (cleared before the conversion)
+        bool     is_signed   = false;  //*< raw value is a two's complement number
+    };
+
+private:
+    std::map<std::size_t, Parameters> overrides;  //*< parameters by module position (1: first module)
+
+    // per channel parameters of the current module list (index: analog input image index)
+    std::vector<float>    offset;  //*< offset (including the bias of unsigned values)
+    std::vector<float>    gain;    //*< gain
+    std::vector<uint16_t> keep;    //*< mask of value bits
+    std::vector<uint16_t> flip;    //*< sign flip (0x8000 for unsigned values)
+
+public:
+    /**
+     * @brief get built-in scaling parameters of an analog input module
+     * @details unknown modules are not scaled (offset 0, gain 1)
+     * @param product_id product id of the module (e.g. 453 for 750-453)
+     * @return scaling parameters
+     */
+    [[nodiscard]] static Parameters get_default(uint16_t product_id) noexcept;
+
+    /**
+     * @brief load scaling configuration file
+     * @details
+     *      One module per line:
+     *          <module> <offset> <gain> [<status mask> [signed|unsigned]]
+     *      module is the position of the module (1: first module after the coupler).
+     *      Empty lines and lines starting with '#' are ignored.
+     * @param path path of the configuration file
+     *
+     * @exception std::runtime_error failed to open scaling configuration
+     * @exception std::runtime_error invalid scaling configuration
+     */
+    void load_config(const std::string &path);
+
+    /**
+     * @brief set scaling parameters of one module
+     * @param module position of the module (1: first module after the coupler)
+     * @param parameters scaling parameters
+     */
+    void set_parameters(std::size_t module, const Parameters &parameters);
+
+    /**
+     * @brief compute the per channel parameters for a module list
+     * @param clamps list of connected modules
+     *
+     * @exception std::runtime_error scaling configured for a module that is not an analog input module
+     */
+    void build(const Clamp_Table &clamps);
+
+    /**
+     * @brief number of channels
+     */
+    [[nodiscard]] inline std::size_t size() const noexcept { return gain.size(); }
+
+    /**
+     * @brief convert analog input image to engineering units
+     * @details vectorized with AVX2, SSE2 or NEON if enabled at compile time (e.g. by -march=native)
+     * @param raw analog input image (size() values)
+     * @param result converted values (space for size() values)
+     */
+    void apply(const uint16_t *raw, float *result) const noexcept;
+};
+
+}  // namespace WAGO_Modbus
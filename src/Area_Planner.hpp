@@ -0,0 +1,136 @@
+/*
+ * Copyright (C) 2023 Nikolas Koesling <nikolas@koesling.info>.
+ * This program is free software. You can redistribute it and/or modify it under the terms of the MIT License.
+ */
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <stdexcept>
+#include <utility>
+
+namespace WAGO_Modbus {
+
+/**
+ * @brief planning of the modbus requests of a process data image
+ * @details
+ *      A process data image of the coupler is accessible through one or more address areas.
+ *      Each area continues the image where the previous area ends, but the addresses of the areas are not contiguous.
+ *      A request can not span two areas and its size is limited by the modbus PDU.
+ *
+ *      The planner splits an image into the minimum number of requests: ceil(n / limit) requests for the n values
+ *      of each area. All functions are constexpr, so the plans can be verified at compile time.
+ */
+namespace Area_Planner {
+
+/**
+ * @brief one planned request
+ */
+struct Request {
+    uint16_t    address;  //*< modbus start address
+    std::size_t size;     //*< number of bits or registers (0: unused entry)
+    std::size_t offset;   //*< index of the first value in the process data image
+};
+
+/**
+ * @brief address areas of one process data image
+ * @tparam AREAS number of address areas
+ */
+template <std::size_t AREAS>
+class Register_Map final {
+public:
+    using Area = std::pair<uint16_t, std::size_t>;  //*< {start address, number of values}
+
+private:
+    std::array<Area, AREAS> areas;
+
+public:
+    /**
+     * @brief create register map
+     * @param areas address areas in image order
+     */
+    constexpr explicit Register_Map(const std::array<Area, AREAS> &areas) : areas(areas) {}
+
+    /**
+     * @brief maximum image size
+     */
+    [[nodiscard]] constexpr std::size_t capacity() const noexcept {
+        std::size_t result = 0;
+        for (const auto &area : areas)
+            result += area.second;
+        return result;
+    }
+
+    /**
+     * @brief get address area
+     * @param i area index
+     */
+    [[nodiscard]] constexpr const Area &get_area(std::size_t i) const { return areas.at(i); }
+
+    /**
+     * @brief number of requests required for an image
+     * @param image_size number of values in the image
+     * @param limit maximum number of values in one request
+     */
+    [[nodiscard]] constexpr std::size_t request_count(std::size_t image_size, std::size_t limit) const noexcept {
+        std::size_t result = 0;
+        for (const auto &area : areas) {
+            const std::size_t n = image_size < area.second ? image_size : area.second;
+            result += (n + limit - 1) / limit;
+            image_size -= n;
+        }
+        return result;
+    }
+
+    /**
+     * @brief plan the requests of an image
+     * @param image_size number of values in the image
+     * @param limit maximum number of values in one request
+     * @param function called with each planned request (Request) in image order
+     *
+     * @exception std::out_of_range image size exceeds register map
+     * @exception std::invalid_argument request size limit is 0
+     */
+    template <typename Function>
+    constexpr void plan(std::size_t image_size, std::size_t limit, Function &&function) const {
+        if (image_size > capacity()) throw std::out_of_range("image size exceeds register map");
+        if (limit == 0) throw std::invalid_argument("request size limit is 0");
+
+        std::size_t offset = 0;
+        for (const auto &area : areas) {
+            const std::size_t end = offset + (image_size - offset < area.second ? image_size - offset : area.second);
+            for (std::size_t i = offset; i < end; i += limit) {
+                const std::size_t size = end - i < limit ? end - i : limit;
+                function(Request {static_cast<uint16_t>(area.first + (i - offset)), size, i});
+            }
+            offset = end;
+        }
+    }
+
+    /**
+     * @brief plan the requests of an image
+     * @tparam MAX_REQUESTS size of the result
+     * @param image_size number of values in the image
+     * @param limit maximum number of values in one request
+     * @return planned requests in image order (unused entries: size 0)
+     *
+     * @exception std::out_of_range image size exceeds register map
+     * @exception std::invalid_argument request size limit is 0
+     * @exception std::out_of_range too many requests
+     */
+    template <std::size_t MAX_REQUESTS>
+    [[nodiscard]] constexpr std::array<Request, MAX_REQUESTS> plan(std::size_t image_size, std::size_t limit) const {
+        std::array<Request, MAX_REQUESTS> result {};
+        std::size_t                       count = 0;
+        plan(image_size, limit, [&result, &count](const Request &request) {
+            if (count == MAX_REQUESTS) throw std::out_of_range("too many requests");
+            result[count++] = request;
+        });
+        return result;
+    }
+};
+
+}  // namespace Area_Planner
+
+}  // namespace WAGO_Modbus
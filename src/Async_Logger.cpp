@@ -0,0 +1,149 @@
+/*
+ * Copyright (C) 2023 Nikolas Koesling <nikolas@koesling.info>.
+ * This program is free software. You can redistribute it and/or modify it under the terms of the MIT License.
+ */
+
+#include "Async_Logger.hpp"
+
+#include "Print_Time.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+static const char *level_text(Async_Logger::Level level) {
+    switch (level) {
+        case Async_Logger::Level::INFO: return "INFO : ";
+        case Async_Logger::Level::WARN: return "WARN : ";
+        case Async_Logger::Level::ERROR: return "ERROR: ";
+        default: return "";
+    }
+}
+
+Async_Logger::Async_Logger(std::ostream &out, std::size_t capacity, std::chrono::milliseconds rate_interval)
+    : out(out), rate_interval(rate_interval), mask(capacity - 1) {
+    if (capacity == 0 || (capacity & (capacity - 1)) != 0)
+        throw std::invalid_argument("log ring capacity must be a power of 2");
+
+    ring.resize(capacity);
+    thread = std::thread(&Async_Logger::run, this);
+}
+
+Async_Logger::~Async_Logger() {
+    stop.store(true, std::memory_order_release);
+    thread.join();
+}
+
+template <typename Function>
+bool Async_Logger::push(Function &&function) noexcept {
+    const auto h = head.load(std::memory_order_relaxed);
+    if (h - tail.load(std::memory_order_acquire) == ring.size()) {
+        dropped.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    auto &record = ring[h & mask];
+    record.time  = std::chrono::system_clock::now();
+    function(record);
+
+    head.store(h + 1, std::memory_order_release);
+    return true;
+}
+
+bool Async_Logger::log(Level level, const char *message, const char *detail) noexcept {
+    return push([level, message, detail](Record &record) {
+        record.message = message;
+        record.unit    = nullptr;
+        record.value   = 0;
+        record.level   = level;
+        if (detail) {
+            std::strncpy(record.detail.data(), detail, record.detail.size() - 1);
+            record.detail.back() = '\0';
+        } else {
+            record.detail[0] = '\0';
+        }
+    });
+}
+
+bool Async_Logger::log(Level level, const char *message, int64_t value, const char *unit) noexcept {
+    return push([level, message, value, unit](Record &record) {
+        record.message   = message;
+        record.unit      = unit ? unit : "";
+        record.value     = value;
+        record.level     = level;
+        record.detail[0] = '\0';
+    });
+}
+
+void Async_Logger::run() {
+    // the records of the last interval are written after stop was set
+    while (!stop.load(std::memory_order_acquire)) {
+        drain();
+        std::this_thread::sleep_for(FLUSH_INTERVAL);
+    }
+
+    drain();
+    write_repetitions(true);
+    out.flush();
+}
+
+void Async_Logger::drain() {
+    const auto h = head.load(std::memory_order_acquire);
+    auto       t = tail.load(std::memory_order_relaxed);
+
+    for (; t != h; ++t) {
+        write(ring[t & mask]);
+        tail.store(t + 1, std::memory_order_release);
+    }
+
+    lost += dropped.exchange(0, std::memory_order_relaxed);
+    write_repetitions(false);
+    out.flush();
+}
+
+void Async_Logger::write(const Record &record) {
+    // errors are never coalesced
+    if (record.level != Level::ERROR && rate_interval.count() > 0) {
+        auto      &repetition = repetitions[record.message];
+        const auto now        = std::chrono::steady_clock::now();
+
+        if (repetition.written != std::chrono::steady_clock::time_point() && now - repetition.written < rate_interval) {
+            repetition.max_value = repetition.suppressed ? std::max(repetition.max_value, record.value) : record.value;
+            repetition.unit      = record.unit;
+            repetition.level     = record.level;
+            ++repetition.suppressed;
+            return;
+        }
+
+        repetition.written = now;
+    }
+
+    out << Print_Time::iso_ms.at(record.time) << ' ' << level_text(record.level) << record.message
+        << record.detail.data();
+    if (record.unit) out << record.value << record.unit;
+    out << '\n';
+}
+
+void Async_Logger::write_repetitions(bool all) {
+    const auto now = std::chrono::steady_clock::now();
+
+    // dropped records are reported like suppressed repetitions
+    if (lost && (all || now - lost_written >= rate_interval)) {
+        out << Print_Time::iso_ms << " WARN : " << lost << " log messages dropped\n";
+        lost_written = now;
+        lost         = 0;
+    }
+
+    for (auto &[message, repetition] : repetitions) {
+        if (repetition.suppressed == 0 || (!all && now - repetition.written < rate_interval)) continue;
+
+        out << Print_Time::iso_ms << ' ' << level_text(repetition.level) << message << "... repeated "
+            << repetition.suppressed << " times";
+        if (repetition.unit) out << " (max: " << repetition.max_value << repetition.unit << ')';
+        out << '\n';
+
+        // the next repetition starts a new interval
+        repetition.written    = now;
+        repetition.suppressed = 0;
+    }
+}
@@ -0,0 +1,144 @@
+/*
+ * Copyright (C) 2023 Nikolas Koesling <nikolas@koesling.info>.
+ * This program is free software. You can redistribute it and/or modify it under the terms of the MIT License.
+ */
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @brief asynchronous logger for the cycle thread
+ * @details
+ *      The cycle thread enqueues fixed size records in a lock free single producer / single consumer ring.
+ *      A background thread formats the records and writes them to the output stream, so logging never blocks the
+ *      cycle thread (no formatting, no stream locks, no write system call). If the ring is full, records are dropped
+ *      and the number of dropped records is reported (at most once per rate interval).
+ *
+ *      Repeated messages are coalesced: a message (except errors) is written at most once per rate interval.
+ *      Suppressed repetitions are counted and reported with their maximum value once the interval expired.
+ *
+ *      Only one thread may call log.
+ */
+class Async_Logger final {
+public:
+    enum class Level : uint8_t { INFO, WARN, ERROR };
+
+    static constexpr std::size_t DETAIL_SIZE = 96;  //*< maximum length of the detail text (including terminator)
+
+private:
+    struct Record {
+        std::chrono::system_clock::time_point time;     // time of the log call
+        const char                           *message;  // static message text (also identifies the message)
+        const char                           *unit;     // unit of value (nullptr: no value)
+        int64_t                               value;    // numeric argument
+        Level                                 level;    // log level
+        std::array<char, DETAIL_SIZE>         detail;   // copy of the detail text (truncated)
+    };
+
+    // coalescing state of a message (background thread only)
+    struct Repetition {
+        std::chrono::steady_clock::time_point written {};            // time at which the message was written
+        std::size_t                           suppressed = 0;        // suppressed repetitions since written
+        int64_t                               max_value  = 0;        // maximum value of the suppressed repetitions
+        const char                           *unit       = nullptr;  // unit of the value
+        Level                                 level      = Level::INFO;  // level of the suppressed repetitions
+    };
+
+    std::ostream             &out;            // output stream (background thread only)
+    std::chrono::milliseconds rate_interval;  // minimum interval of repeated messages
+    std::vector<Record>       ring;           // record ring (size: power of 2)
+    std::size_t               mask;           // ring.size() - 1
+
+    alignas(64) std::atomic<std::size_t> head {0};  // next record to write (producer)
+    alignas(64) std::atomic<std::size_t> tail {0};  // next record to read (background thread)
+
+    std::atomic<uint64_t>                        dropped {0};   // records dropped because the ring was full
+    std::atomic<bool>                            stop {false};  // terminate the background thread
+    std::unordered_map<const char *, Repetition> repetitions;   // coalescing state per message
+    uint64_t                                     lost = 0;      // dropped records that were not reported yet
+    std::chrono::steady_clock::time_point        lost_written;  // time at which dropped records were reported
+    std::thread                                  thread;        // background thread
+
+public:
+    static constexpr std::chrono::milliseconds FLUSH_INTERVAL {10};  //*< interval in which the ring is written
+
+    /**
+     * @brief create logger and start the background thread
+     * @param out output stream
+     * @param capacity number of records in the ring (power of 2)
+     * @param rate_interval minimum interval of repeated messages (0: no coalescing)
+     *
+     * @exception std::invalid_argument capacity is not a power of 2
+     * @exception std::system_error failed to create background thread
+     */
+    explicit Async_Logger(std::ostream             &out,
+                          std::size_t               capacity      = 1024,
+                          std::chrono::milliseconds rate_interval = std::chrono::seconds(1));
+
+    /**
+     * @brief write all queued records and stop the background thread
+     */
+    ~Async_Logger();
+
+    Async_Logger(const Async_Logger &other)            = delete;
+    Async_Logger(Async_Logger &&other)                 = delete;
+    Async_Logger &operator=(const Async_Logger &other) = delete;
+    Async_Logger &operator=(Async_Logger &&other)      = delete;
+
+    /**
+     * @brief enqueue a log message
+     * @param level log level
+     * @param message message text (must have static storage duration, e.g. a string literal)
+     * @param detail detail text that is appended to the message (copied, truncated to DETAIL_SIZE - 1 characters)
+     * @return false if the record was dropped because the ring is full
+     */
+    bool log(Level level, const char *message, const char *detail = nullptr) noexcept;
+
+    /**
+     * @brief enqueue a log message with a numeric value
+     * @param level log level
+     * @param message message text (must have static storage duration, e.g. a string literal)
+     * @param value value that is appended to the message
+     * @param unit unit of the value (must have static storage duration)
+     * @return false if the record was dropped because the ring is full
+     */
+    bool log(Level level, const char *message, int64_t value, const char *unit) noexcept;
+
+private:
+    /**
+     * @brief enqueue a record
+     * @param function function that initializes the record
+     */
+    template <typename Function>
+    bool push(Function &&function) noexcept;
+
+    /**
+     * @brief loop of the background thread
+     */
+    void run();
+
+    /**
+     * @brief write all queued records
+     */
+    void drain();
+
+    /**
+     * @brief write a record (or count it as suppressed repetition)
+     */
+    void write(const Record &record);
+
+    /**
+     * @brief report suppressed repetitions whose rate interval expired
+     * @param all report all suppressed repetitions
+     */
+    void write_repetitions(bool all);
+};
@@ -0,0 +1,226 @@
+/*
+ * Copyright (C) 2023 Nikolas Koesling <nikolas@koesling.info>.
+ * This program is free software. You can redistribute it and/or modify it under the terms of the MIT License.
+ */
+
+#include "Change_Stream.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cstring>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <utility>
+
+static constexpr std::size_t MAX_FILTERS      = 4096;  // maximum number of filters per subscriber
+static constexpr std::size_t FILTER_READ_SIZE = 512;   // maximum number of filter bytes read per publish call
+
+/**
+ * @brief load one value of an image
+ */
+static inline uint16_t load(const void *image, std::size_t type, std::size_t index) noexcept {
+    if (type == WAGO_Modbus::DI || type == WAGO_Modbus::DO) return static_cast<const uint8_t *>(image)[index];
+    return static_cast<const uint16_t *>(image)[index];
+}
+
+WAGO_Modbus::Change_Stream::Change_Stream(const std::string &path, bool force, std::size_t queue_limit)
+    : server(path, force), queue_limit(queue_limit) {}
+
+WAGO_Modbus::Change_Stream::~Change_Stream() {
+    for (const auto &subscriber : subscribers)
+        close(subscriber.fd);
+}
+
+void WAGO_Modbus::Change_Stream::set_layout(const Clamp_Table &clamps, uint64_t generation) {
+    const auto sizes = clamps.get_image_sizes();
+    for (std::size_t t = 0; t < _REG_TYPES_SIZE_; ++t) {
+        const auto type = static_cast<reg_types_t>(t);
+        clamp_of[t].resize(sizes[t]);
+        channel_of[t].resize(sizes[t]);
+        offset_of[t].assign(clamps.get_offsets(type).begin(), clamps.get_offsets(type).end());
+        size_of[t].assign(clamps.get_sizes(type).begin(), clamps.get_sizes(type).end());
+        previous[t].assign(sizes[t], 0);
+
+        for (std::size_t c = 0; c < clamps.size(); ++c) {
+            const std::size_t offset = clamps.get_offset(c, type);
+            for (std::size_t k = 0; k < clamps.get_size(c, type); ++k) {
+                clamp_of[t][offset + k]   = static_cast<uint16_t>(c);
+                channel_of[t][offset + k] = static_cast<uint16_t>(k);
+            }
+        }
+    }
+
+    layout_generation = generation;
+    for (auto &subscriber : subscribers) {
+        select(subscriber);
+        subscriber.snapshot = true;
+    }
+}
+
+void WAGO_Modbus::Change_Stream::publish(const std::array<const void *, _REG_TYPES_SIZE_> &images) {
+    ++cycle;
+
+    for (int fd = server.accept(); fd != -1; fd = server.accept()) {
+        auto &subscriber = subscribers.emplace_back();
+        subscriber.fd    = fd;
+        select(subscriber);
+    }
+
+    // new subscribers receive a snapshot: the previous values are only required if there are subscribers
+    if (subscribers.empty()) return;
+
+    changes.clear();
+    for (std::size_t t = 0; t < _REG_TYPES_SIZE_; ++t) {
+        auto &prev = previous[t];
+        for (std::size_t i = 0; i < prev.size(); ++i) {
+            const auto value = load(images[t], t, i);
+            if (value != prev[i]) {
+                prev[i] = value;
+                changes.emplace_back(static_cast<uint8_t>(t), static_cast<uint16_t>(i));
+            }
+        }
+    }
+
+    for (std::size_t i = 0; i < subscribers.size();) {
+        auto &subscriber = subscribers[i];
+
+        bool keep = read_filters(subscriber);
+        if (keep && !enqueue(subscriber)) {
+            keep = false;
+            ++dropped;
+        }
+        if (keep) keep = flush(subscriber);
+
+        if (keep) {
+            ++i;
+        } else {
+            close(subscriber.fd);
+            subscribers[i] = std::move(subscribers.back());
+            subscribers.pop_back();
+        }
+    }
+}
+
+bool WAGO_Modbus::Change_Stream::read_filters(Subscriber &subscriber) {
+    // one recv per publish call: the cycle is not delayed by a subscriber that sends many filters
+    std::array<uint8_t, FILTER_READ_SIZE + sizeof(Filter)> buffer {};
+    std::memcpy(buffer.data(), subscriber.partial.data(), subscriber.partial_size);
+
+    ssize_t n = 0;
+    do {
+        n = recv(subscriber.fd, buffer.data() + subscriber.partial_size, FILTER_READ_SIZE, MSG_DONTWAIT);
+    } while (n == -1 && errno == EINTR);
+    if (n == 0) return false;
+    if (n == -1) return errno == EAGAIN;
+
+    const std::size_t size  = subscriber.partial_size + static_cast<std::size_t>(n);
+    const std::size_t count = size / sizeof(Filter);
+    if (subscriber.filters.size() + count > MAX_FILTERS) return false;
+
+    // the first filter replaces the selection of all values
+    if (count && subscriber.filters.empty()) {
+        for (std::size_t t = 0; t < _REG_TYPES_SIZE_; ++t)
+            subscriber.selected[t].assign(previous[t].size(), false);
+    }
+
+    // only the new filters are applied
+    for (std::size_t i = 0; i < count; ++i) {
+        Filter filter {};
+        std::memcpy(&filter, buffer.data() + i * sizeof(Filter), sizeof(filter));
+        subscriber.filters.push_back(filter);
+        select(subscriber, filter);
+    }
+
+    subscriber.partial_size = size - count * sizeof(Filter);
+    std::memcpy(subscriber.partial.data(), buffer.data() + count * sizeof(Filter), subscriber.partial_size);
+
+    if (count) subscriber.snapshot = true;
+    return true;
+}
+
+void WAGO_Modbus::Change_Stream::select(Subscriber &subscriber) const {
+    for (std::size_t t = 0; t < _REG_TYPES_SIZE_; ++t)
+        subscriber.selected[t].assign(subscriber.filters.empty() ? 0 : previous[t].size(), false);
+
+    for (const auto &filter : subscriber.filters)
+        select(subscriber, filter);
+}
+
+void WAGO_Modbus::Change_Stream::select(Subscriber &subscriber, const Filter &filter) const {
+    if (filter.image >= _REG_TYPES_SIZE_ || filter.clamp >= offset_of[filter.image].size()) return;
+
+    const std::size_t size   = size_of[filter.image][filter.clamp];
+    const std::size_t offset = offset_of[filter.image][filter.clamp];
+    const std::size_t end    = static_cast<std::size_t>(filter.first_channel) + filter.channel_count;
+    const std::size_t first  = std::min<std::size_t>(filter.first_channel, size);
+    const std::size_t last   = std::min(end, size);
+
+    auto &selected = subscriber.selected[filter.image];
+    std::fill(selected.begin() + static_cast<std::ptrdiff_t>(offset + first),
+              selected.begin() + static_cast<std::ptrdiff_t>(offset + last),
+              true);
+}
+
+bool WAGO_Modbus::Change_Stream::enqueue(Subscriber &subscriber) {
+    const bool all = subscriber.filters.empty();
+
+    batch.resize(sizeof(Batch_Header));
+    std::size_t count = 0;
+
+    auto add = [this, &count](std::size_t t, std::size_t i) {
+        const Record record {clamp_of[t][i], static_cast<uint8_t>(t), 0, channel_of[t][i], previous[t][i]};
+        const auto  *data = reinterpret_cast<const uint8_t *>(&record);
+        batch.insert(batch.end(), data, data + sizeof(record));
+        ++count;
+    };
+
+    if (subscriber.snapshot) {
+        for (std::size_t t = 0; t < _REG_TYPES_SIZE_; ++t) {
+            for (std::size_t i = 0; i < previous[t].size(); ++i)
+                if (all || subscriber.selected[t][i]) add(t, i);
+        }
+    } else {
+        for (const auto &change : changes)
+            if (all || subscriber.selected[change.first][change.second]) add(change.first, change.second);
+        if (count == 0) return true;
+    }
+
+    Batch_Header header {};
+    header.cycle             = cycle;
+    header.layout_generation = static_cast<uint32_t>(layout_generation);
+    header.flags             = subscriber.snapshot ? FLAG_SNAPSHOT : 0;
+    header.count             = static_cast<uint16_t>(count);
+    std::memcpy(batch.data(), &header, sizeof(header));
+
+    if (subscriber.queue.size() - subscriber.sent + batch.size() > queue_limit) return false;
+    subscriber.queue.insert(subscriber.queue.end(), batch.begin(), batch.end());
+    subscriber.snapshot = false;
+    return true;
+}
+
+bool WAGO_Modbus::Change_Stream::flush(Subscriber &subscriber) {
+    auto &queue = subscriber.queue;
+    while (subscriber.sent < queue.size()) {
+        const auto n = send(subscriber.fd,
+                            queue.data() + subscriber.sent,
+                            queue.size() - subscriber.sent,
+                            MSG_DONTWAIT | MSG_NOSIGNAL);
+        if (n == -1) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN) break;
+            return false;
+        }
+        subscriber.sent += static_cast<std::size_t>(n);
+    }
+
+    // discard sent data
+    if (subscriber.sent == queue.size()) {
+        queue.clear();
+        subscriber.sent = 0;
+    } else if (subscriber.sent > queue.size() / 2) {
+        queue.erase(queue.begin(), queue.begin() + static_cast<std::ptrdiff_t>(subscriber.sent));
+        subscriber.sent = 0;
+    }
+    return true;
+}
@@ -0,0 +1,173 @@
+/*
+ * Copyright (C) 2023 Nikolas Koesling <nikolas@koesling.info>.
+ * This program is free software. You can redistribute it and/or modify it under the terms of the MIT License.
+ */
+
+#pragma once
+
+#include "Unix_Socket_Server.hpp"
+#include "WAGO_MB_Clamps.hpp"
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace WAGO_Modbus {
+
+/**
+ * @brief stream of the changed process data values to subscribers on a Unix domain socket
+ * @details
+ *      For consumers that can not map the shared memories (e.g. containers).
+ *      publish compares the images with the values of the previous call and sends one batch per subscriber:
+ *      a Batch_Header followed by Batch_Header::count Record structures. Empty batches are not sent.
+ *      The first batch of a subscriber and the first batch after a layout change contain all values (FLAG_SNAPSHOT).
+ *      All values are stored in host byte order.
+ *
+ *      A subscriber receives all values, unless it sends Filter structures. Each filter adds a range of channels.
+ *      Filters are read in portions of limited size per publish call. A subscriber that sends more than MAX_FILTERS
+ *      filters is disconnected.
+ *
+ *      The sockets are non-blocking and everything runs in the thread that calls publish.
+ *      Data that can not be sent immediately is queued per subscriber.
+ *      A subscriber whose queue exceeds the queue limit is disconnected, so a slow subscriber never delays the cycle.
+ */
+class Change_Stream final {
+public:
+    static constexpr uint16_t FLAG_SNAPSHOT = 0x0001;  //*< batch contains all (selected) values
+
+    struct Batch_Header {
+        uint64_t cycle;              //*< number of the publish call
+        uint32_t layout_generation;  //*< layout generation (lower 32 bits of Coupler_Status::Status::layout_generation)
+        uint16_t flags;              //*< FLAG_SNAPSHOT
+        uint16_t count;              //*< number of records
+    };
+
+    struct Record {
+        uint16_t clamp;     //*< module index (0: first module after the coupler)
+        uint8_t  image;     //*< image (Channel_Map::Image)
+        uint8_t  reserved;  //*< reserved (0)
+        uint16_t channel;   //*< index of the value in the part of the image of the module (see Channel_Map::Entry)
+        uint16_t value;     //*< new value (digital: 0 or 1)
+    };
+
+    /**
+     * @brief channel selection (sent by a subscriber)
+     */
+    struct Filter {
+        uint16_t clamp;          //*< module index (0: first module after the coupler)
+        uint8_t  image;          //*< image (Channel_Map::Image)
+        uint8_t  reserved;       //*< reserved (0)
+        uint16_t first_channel;  //*< first selected channel
+        uint16_t channel_count;  //*< number of selected channels
+    };
+
+    static_assert(std::is_trivially_copyable_v<Batch_Header> && sizeof(Batch_Header) == 16);
+    static_assert(std::is_trivially_copyable_v<Record> && sizeof(Record) == 8);
+    static_assert(std::is_trivially_copyable_v<Filter> && sizeof(Filter) == 8);
+
+private:
+    struct Subscriber {
+        int                                             fd = -1;           // socket
+        std::vector<Filter>                             filters;           // channel selection (empty: all)
+        std::array<std::vector<bool>, _REG_TYPES_SIZE_> selected;          // selected image indices
+        bool                                            snapshot = true;   // next batch contains all values
+        std::vector<uint8_t>                            queue;             // data that was not sent yet
+        std::size_t                                     sent = 0;          // sent bytes of queue
+        std::array<uint8_t, sizeof(Filter)>             partial {};        // incomplete filter
+        std::size_t                                     partial_size = 0;  // size of the incomplete filter
+    };
+
+    Unix_Socket_Server      server;       //*< listening socket
+    std::size_t             queue_limit;  //*< maximum number of queued bytes per subscriber
+    std::vector<Subscriber> subscribers;  //*< connected subscribers
+
+    std::array<std::vector<uint16_t>, _REG_TYPES_SIZE_> previous;    //*< values of the previous publish call
+    std::array<std::vector<uint16_t>, _REG_TYPES_SIZE_> clamp_of;    //*< module of each image index
+    std::array<std::vector<uint16_t>, _REG_TYPES_SIZE_> channel_of;  //*< channel of each image index
+    std::array<std::vector<uint16_t>, _REG_TYPES_SIZE_> offset_of;   //*< first image index of each module
+    std::array<std::vector<uint16_t>, _REG_TYPES_SIZE_> size_of;     //*< number of image values of each module
+
+    std::vector<std::pair<uint8_t, uint16_t>> changes;  //*< changed values of the current cycle {image, index}
+    std::vector<uint8_t>                      batch;    //*< scratch buffer of one batch
+
+    uint64_t    cycle             = 0;  //*< number of publish calls
+    uint64_t    layout_generation = 0;  //*< current layout generation
+    std::size_t dropped           = 0;  //*< number of disconnected slow subscribers
+
+public:
+    /**
+     * @brief create the listening socket
+     * @param path path of the socket file
+     * @param force remove an existing socket file
+     * @param queue_limit maximum number of queued bytes per subscriber
+     *
+     * @exception std::runtime_error socket path too long
+     * @exception std::system_error thrown if one of the system calls socket, bind or listen failed
+     */
+    Change_Stream(const std::string &path, bool force, std::size_t queue_limit);
+
+    ~Change_Stream();
+
+    Change_Stream(const Change_Stream &other)            = delete;
+    Change_Stream(Change_Stream &&other)                 = delete;
+    Change_Stream &operator=(const Change_Stream &other) = delete;
+    Change_Stream &operator=(Change_Stream &&other)      = delete;
+
+    /**
+     * @brief set the module list (must be called before the first publish call and after each layout change)
+     * @details all subscribers receive a snapshot with the next batch
+     * @param clamps list of connected modules
+     * @param generation layout generation
+     */
+    void set_layout(const Clamp_Table &clamps, uint64_t generation);
+
+    /**
+     * @brief accept new subscribers, read their filters, send the changed values and flush the queues
+     * @param images process data images (index: reg_types_t; DI / DO: uint8_t, AI / AO: uint16_t)
+     */
+    void publish(const std::array<const void *, _REG_TYPES_SIZE_> &images);
+
+    /**
+     * @brief number of connected subscribers
+     */
+    [[nodiscard]] inline std::size_t get_subscriber_count() const noexcept { return subscribers.size(); }
+
+    /**
+     * @brief number of subscribers that were disconnected because their queue exceeded the limit
+     */
+    [[nodiscard]] inline std::size_t get_dropped_count() const noexcept { return dropped; }
+
+private:
+    /**
+     * @brief read the filters of a subscriber (at most FILTER_READ_SIZE bytes)
+     * @return false if the connection was closed or the subscriber sent more than MAX_FILTERS filters
+     */
+    bool read_filters(Subscriber &subscriber);
+
+    /**
+     * @brief compute the selected image indices of a subscriber from all its filters (after a layout change)
+     */
+    void select(Subscriber &subscriber) const;
+
+    /**
+     * @brief add the image indices of one filter to the selection of a subscriber
+     * @details O(channel_count): the range is taken from the position of the module in the image
+     */
+    void select(Subscriber &subscriber, const Filter &filter) const;
+
+    /**
+     * @brief append the batch of the current cycle to the queue of a subscriber
+     * @return false if the queue limit is exceeded
+     */
+    bool enqueue(Subscriber &subscriber);
+
+    /**
+     * @brief send queued data (non-blocking)
+     * @return false if the connection was closed
+     */
+    static bool flush(Subscriber &subscriber);
+};
+
+}  // namespace WAGO_Modbus
@@ -0,0 +1,75 @@
+/*
+ * Copyright (C) 2023 Nikolas Koesling <nikolas@koesling.info>.
+ * This program is free software. You can redistribute it and/or modify it under the terms of the MIT License.
+ */
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <type_traits>
+
+namespace WAGO_Modbus {
+
+/**
+ * @brief layout of the channel map shared memory (<prefix>MAP)
+ * @details
+ *      The channel map describes where the values of each module are located in the process data images.
+ *      It is written once when the images are created. Consumers can resolve the image index of a channel once
+ *      at startup:
+ *          index = entry.offset[image] + channel
+ *
+ *      The shared memory consists of a Header followed by Header::clamp_count Entry structures.
+ *      All values are stored in host byte order.
+ */
+namespace Channel_Map {
+static constexpr std::array<char, 8> MAGIC   = {'W', 'A', 'G', 'O', 'M', 'A', 'P', '\0'};
+static constexpr uint32_t            VERSION = 1;
+
+/**
+ * @brief image indices of Header::image_size, Entry::size and Entry::offset
+ */
+enum Image : std::size_t { DI = 0, DO = 1, AI = 2, AO = 3, IMAGES = 4 };  // NOLINT
+
+/**
+ * @brief module types of Entry::type
+ */
+enum Type : uint8_t { DIGITAL_INPUT = 0, DIGITAL_OUTPUT = 1, ANALOG = 2 };  // NOLINT
+
+struct Header {
+    std::array<char, 8>          magic;        //*< MAGIC
+    uint32_t                     version;      //*< VERSION
+    uint32_t                     clamp_count;  //*< number of entries
+    std::array<uint64_t, IMAGES> image_size;   //*< number of values in each image
+};
+
+struct Entry {
+    uint16_t                     index;           //*< module position (0: first module after the coupler)
+    uint16_t                     product_id;      //*< configuration word (digital) or product id (analog)
+    uint8_t                      type;            //*< module type (Type)
+    uint8_t                      data_type;       //*< data type of analog values (Clamp_Data_Type)
+    uint8_t                      status_bytes;    //*< status bytes at the start of the input data
+    uint8_t                      control_bytes;   //*< control bytes at the start of the output data
+    uint16_t                     channels;        //*< number of channels
+    std::array<uint16_t, IMAGES> size;            //*< number of values in each image
+    std::array<uint16_t, IMAGES> offset;          //*< index of the first value in each image
+    uint16_t                     counter_offset;  //*< index of the first value in the 32 bit image (<prefix>CNT)
+    std::array<uint16_t, 2>      reserved;        //*< reserved (0)
+};
+
+static_assert(std::is_standard_layout_v<Header> && std::is_trivially_copyable_v<Header>);
+static_assert(std::is_standard_layout_v<Entry> && std::is_trivially_copyable_v<Entry>);
+static_assert(sizeof(Header) == 48, "unexpected channel map header size");
+static_assert(sizeof(Entry) == 32, "unexpected channel map entry size");
+
+/**
+ * @brief size of the channel map shared memory
+ * @param clamp_count number of modules
+ */
+constexpr std::size_t size(std::size_t clamp_count) {
+    return sizeof(Header) + clamp_count * sizeof(Entry);
+}
+
+}  // namespace Channel_Map
+
+}  // namespace WAGO_Modbus
@@ -0,0 +1,181 @@
+/*
+ * Copyright (C) 2023 Nikolas Koesling <nikolas@koesling.info>.
+ * This program is free software. You can redistribute it and/or modify it under the terms of the MIT License.
+ */
+
+#include "Clamp_Registry.hpp"
+
+#include <array>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+namespace {
+
+using Type = WAGO_Modbus::Clamp_Data_Type;
+
+// NOLINTBEGIN(*-magic-numbers)
+constexpr std::array<WAGO_Modbus::Clamp_Descriptor, 24> BUILTIN_DESCRIPTORS = {{
+        // id, channels, input words, output words, status bytes, control bytes, type, name
+        {404, 1, 3, 3, 1, 1, Type::UINT32, "750-404 up/down counter"},
+        {452, 2, 2, 0, 0, 0, Type::UINT16, "750-452 2AI 0-20mA"},
+        {453, 4, 4, 0, 0, 0, Type::UINT16, "750-453 4AI 0-20mA"},
+        {454, 2, 2, 0, 0, 0, Type::UINT16, "750-454 2AI 4-20mA"},
+        {455, 4, 4, 0, 0, 0, Type::UINT16, "750-455 4AI 4-20mA"},
+        {456, 2, 2, 0, 0, 0, Type::INT16, "750-456 2AI +-10V"},
+        {457, 4, 4, 0, 0, 0, Type::INT16, "750-457 4AI +-10V"},
+        {459, 4, 4, 0, 0, 0, Type::UINT16, "750-459 4AI 0-10V"},
+        {460, 4, 4, 0, 0, 0, Type::INT16, "750-460 4AI Pt100"},
+        {461, 2, 2, 0, 0, 0, Type::INT16, "750-461 2AI Pt100"},
+        {466, 2, 2, 0, 0, 0, Type::UINT16, "750-466 2AI 4-20mA"},
+        {467, 2, 2, 0, 0, 0, Type::UINT16, "750-467 2AI 0-10V"},
+        {468, 4, 4, 0, 0, 0, Type::UINT16, "750-468 4AI 0-10V"},
+        {469, 2, 2, 0, 0, 0, Type::INT16, "750-469 2AI TC"},
+        {472, 2, 2, 0, 0, 0, Type::UINT16, "750-472 2AI 0-20mA"},
+        {550, 2, 0, 2, 0, 0, Type::UINT16, "750-550 2AO 0-10V"},
+        {552, 2, 0, 2, 0, 0, Type::UINT16, "750-552 2AO 0-20mA"},
+        {553, 4, 0, 4, 0, 0, Type::UINT16, "750-553 4AO 0-20mA"},
+        {554, 2, 0, 2, 0, 0, Type::UINT16, "750-554 2AO 4-20mA"},
+        {555, 4, 0, 4, 0, 0, Type::UINT16, "750-555 4AO 4-20mA"},
+        {556, 2, 0, 2, 0, 0, Type::INT16, "750-556 2AO +-10V"},
+        {559, 4, 0, 4, 0, 0, Type::UINT16, "750-559 4AO 0-10V"},
+        {630, 1, 2, 0, 0, 0, Type::UINT32, "750-630 SSI encoder interface"},
+        {652, 1, 3, 3, 1, 1, Type::BYTES, "750-652 serial interface"},
+}};
+// NOLINTEND(*-magic-numbers)
+
+/**
+ * @brief check built-in descriptors (unique analog product ids, consistent sizes)
+ */
+constexpr bool builtin_descriptors_valid() {
+    for (std::size_t i = 0; i < BUILTIN_DESCRIPTORS.size(); ++i) {
+        const auto &descriptor = BUILTIN_DESCRIPTORS[i];
+        if (descriptor.product_id > WAGO_Modbus::Clamp_Registry::MAX_PRODUCT_ID) return false;
+        if (descriptor.input_words * 2 < descriptor.status_bytes) return false;
+        if (descriptor.output_words * 2 < descriptor.control_bytes) return false;
+        if ((descriptor.type == Type::UINT32 || descriptor.type == Type::INT32) &&
+            (descriptor.status_bytes + 1) / 2 + descriptor.channels * 2 > descriptor.input_words)
+            return false;
+        if (descriptor.input_words == 0 && descriptor.output_words == 0) return false;
+
+        for (std::size_t j = i + 1; j < BUILTIN_DESCRIPTORS.size(); ++j)
+            if (descriptor.product_id == BUILTIN_DESCRIPTORS[j].product_id) return false;
+    }
+    return true;
+}
+
+static_assert(builtin_descriptors_valid(), "invalid built-in module descriptor");
+
+}  // namespace
+
+WAGO_Modbus::Clamp_Registry::Clamp_Registry()
+    : descriptors(BUILTIN_DESCRIPTORS.begin(), BUILTIN_DESCRIPTORS.end()), index(MAX_PRODUCT_ID + 1, NO_ENTRY) {
+    for (std::size_t i = 0; i < descriptors.size(); ++i)
+        index[descriptors[i].product_id] = static_cast<uint16_t>(i);
+}
+
+void WAGO_Modbus::Clamp_Registry::add(const Clamp_Descriptor &descriptor) {
+    if (descriptor.product_id > MAX_PRODUCT_ID) throw std::invalid_argument("invalid product id");
+
+    auto &entry = index[descriptor.product_id];
+    if (entry != NO_ENTRY) {
+        descriptors[entry] = descriptor;
+    } else {
+        entry = static_cast<uint16_t>(descriptors.size());
+        descriptors.push_back(descriptor);
+    }
+}
+
+void WAGO_Modbus::Clamp_Registry::load_config(const std::string &path) {
+    std::ifstream file(path);
+    if (!file.is_open()) throw std::runtime_error("failed to open module configuration '" + path + '\'');
+
+    std::string line;
+    std::size_t line_number = 0;
+    while (std::getline(file, line)) {
+        ++line_number;
+
+        std::istringstream sstr(line);
+        std::string        first;
+        if (!(sstr >> first) || first[0] == '#') continue;
+
+        auto invalid = [&]() {
+            std::ostringstream msg;
+            msg << "invalid module configuration in line " << line_number << " of '" << path << '\'';
+            return std::runtime_error(msg.str());
+        };
+
+        // product id, channels, input words, output words, status bytes, control bytes
+        std::array<unsigned long, 6> values {};
+        try {
+            std::size_t pos = 0;
+            values[0]       = std::stoul(first, &pos, 0);
+            if (pos != first.size()) throw invalid();
+        } catch (const std::logic_error &) { throw invalid(); }
+
+        for (std::size_t i = 1; i < values.size(); ++i)
+            if (!(sstr >> values[i])) throw invalid();
+
+        if (values[0] > MAX_PRODUCT_ID) throw invalid();
+        for (std::size_t i = 1; i < values.size(); ++i)
+            if (values[i] > UINT8_MAX) throw invalid();
+
+        const auto input_words   = static_cast<uint8_t>(values[2]);
+        const auto output_words  = static_cast<uint8_t>(values[3]);
+        const auto status_bytes  = static_cast<uint8_t>(values[4]);
+        const auto control_bytes = static_cast<uint8_t>(values[5]);
+        if (input_words == 0 && output_words == 0) throw invalid();
+        if (input_words * 2 < status_bytes || output_words * 2 < control_bytes) throw invalid();
+
+        std::string type_str;
+        if (!(sstr >> type_str)) throw invalid();
+
+        Clamp_Data_Type type;
+        if (type_str == "uint16") type = Clamp_Data_Type::UINT16;
+        else if (type_str == "int16")
+            type = Clamp_Data_Type::INT16;
+        else if (type_str == "uint32")
+            type = Clamp_Data_Type::UINT32;
+        else if (type_str == "int32")
+            type = Clamp_Data_Type::INT32;
+        else if (type_str == "bytes")
+            type = Clamp_Data_Type::BYTES;
+        else
+            throw invalid();
+
+        const auto channels = static_cast<uint8_t>(values[1]);
+        if ((type == Clamp_Data_Type::UINT32 || type == Clamp_Data_Type::INT32) &&
+            (status_bytes + 1) / 2 + channels * 2 > input_words)
+            throw invalid();
+
+        // remaining text of the line: name
+        std::string name;
+        std::getline(sstr >> std::ws, name);
+        names.emplace_back(std::move(name));
+
+        add({static_cast<uint16_t>(values[0]),
+             channels,
+             input_words,
+             output_words,
+             status_bytes,
+             control_bytes,
+             type,
+             names.back()});
+    }
+}
+
+const WAGO_Modbus::Clamp_Descriptor *WAGO_Modbus::Clamp_Registry::find(uint16_t product_id) const noexcept {
+    if (product_id > MAX_PRODUCT_ID) return nullptr;
+    const auto entry = index[product_id];
+    return entry == NO_ENTRY ? nullptr : &descriptors[entry];
+}
+
+const WAGO_Modbus::Clamp_Descriptor &WAGO_Modbus::Clamp_Registry::get(uint16_t product_id) const {
+    const auto *descriptor = find(product_id);
+    if (!descriptor) {
+        std::ostringstream sstr;
+        sstr << "Unknown product ID for analog clamp: " << product_id;
+        throw std::runtime_error(sstr.str());
+    }
+    return *descriptor;
+}
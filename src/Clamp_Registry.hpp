@@ -0,0 +1,115 @@
+/*
+ * Copyright (C) 2023 Nikolas Koesling <nikolas@koesling.info>.
+ * This program is free software. You can redistribute it and/or modify it under the terms of the MIT License.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace WAGO_Modbus {
+
+/**
+ * @brief data type of the values of a module
+ */
+enum class Clamp_Data_Type : uint8_t {
+    UINT16,  //*< one unsigned 16 bit value per channel
+    INT16,   //*< one signed 16 bit value per channel (two's complement)
+    UINT32,  //*< one unsigned 32 bit value per channel (two words)
+    INT32,   //*< one signed 32 bit value per channel (two words)
+    BYTES,   //*< byte stream (e.g. serial interface)
+};
+
+/**
+ * @brief process image layout of an analog or complex module
+ * @details
+ *      Complex modules start with status (input) and control (output) bytes.
+ *      The channel values start at the next word boundary.
+ *      32 bit values are stored with the low word first.
+ */
+struct Clamp_Descriptor {
+    uint16_t         product_id;     //*< product id as reported in the module configuration (e.g. 453 for 750-453)
+    uint8_t          channels;       //*< number of channels
+    uint8_t          input_words;    //*< words in the analog input image (including status bytes)
+    uint8_t          output_words;   //*< words in the analog output image (including control bytes)
+    uint8_t          status_bytes;   //*< status bytes at the start of the input data
+    uint8_t          control_bytes;  //*< control bytes at the start of the output data
+    Clamp_Data_Type  type;           //*< data type of the channel values
+    std::string_view name;           //*< description
+};
+
+/**
+ * @brief lookup table of the known analog and complex modules
+ * @details
+ *      Contains the built-in descriptors and can be extended by a configuration file.
+ *      Descriptors are looked up in constant time by an index over all analog product ids.
+ */
+class Clamp_Registry final {
+public:
+    static constexpr uint16_t MAX_PRODUCT_ID = 0x7FFF;  //*< highest analog product id (bit 15: digital module)
+
+private:
+    static constexpr uint16_t NO_ENTRY = 0xFFFF;  // index value of unknown product ids
+
+    std::vector<Clamp_Descriptor> descriptors;  // known modules
+    std::vector<uint16_t>         index;        // index in descriptors by product id
+    std::deque<std::string>       names;        // storage of the names of loaded descriptors
+
+public:
+    /**
+     * @brief create registry with the built-in descriptors
+     */
+    Clamp_Registry();
+
+    ~Clamp_Registry()                                      = default;
+    Clamp_Registry(const Clamp_Registry &other)            = delete;
+    Clamp_Registry(Clamp_Registry &&other)                 = delete;
+    Clamp_Registry &operator=(const Clamp_Registry &other) = delete;
+    Clamp_Registry &operator=(Clamp_Registry &&other)      = delete;
+
+    /**
+     * @brief add descriptor
+     * @details replaces the descriptor with the same product id
+     * @param descriptor module descriptor. The name must stay valid as long as the registry exists.
+     *
+     * @exception std::invalid_argument invalid product id
+     */
+    void add(const Clamp_Descriptor &descriptor);
+
+    /**
+     * @brief load descriptors from a configuration file
+     * @details
+     *      One module per line:
+     *          <product id> <channels> <input words> <output words> <status bytes> <control bytes> <type> [<name>]
+     *      type is one of uint16, int16, uint32, int32 or bytes.
+     *      Empty lines and lines starting with '#' are ignored.
+     *      Loaded descriptors replace built-in descriptors with the same product id.
+     * @param path path of the configuration file
+     *
+     * @exception std::runtime_error failed to open module configuration
+     * @exception std::runtime_error invalid module configuration
+     */
+    void load_config(const std::string &path);
+
+    /**
+     * @brief find descriptor
+     * @param product_id product id of the module
+     * @return descriptor or nullptr if the product id is unknown
+     */
+    [[nodiscard]] const Clamp_Descriptor *find(uint16_t product_id) const noexcept;
+
+    /**
+     * @brief get descriptor
+     * @param product_id product id of the module
+     * @return descriptor
+     *
+     * @exception std::runtime_error Unknown product ID for analog clamp
+     */
+    [[nodiscard]] const Clamp_Descriptor &get(uint16_t product_id) const;
+};
+
+}  // namespace WAGO_Modbus
@@ -0,0 +1,34 @@
+/*
+ * Copyright (C) 2023 Nikolas Koesling <nikolas@koesling.info>.
+ * This program is free software. You can redistribute it and/or modify it under the terms of the MIT License.
+ */
+
+#include "Counter_Decoder.hpp"
+
+void WAGO_Modbus::Counter_Decoder::build(const Clamp_Table &clamps) {
+    source.clear();
+    offsets.clear();
+
+    for (std::size_t i = 0; i < clamps.size(); ++i) {
+        offsets.push_back(static_cast<uint16_t>(source.size()));
+
+        const auto type = clamps.get_data_type(i);
+        if (clamps.get_type(i) != Clamp_Type::ANALOG) continue;
+        if (type != Clamp_Data_Type::UINT32 && type != Clamp_Data_Type::INT32) continue;
+
+        // values start at the first word boundary after the status bytes
+        const std::size_t first = clamps.get_offset(i, AI) + (clamps.get_status_bytes(i) + 1) / 2;
+        for (std::size_t c = 0; c < clamps.get_channels(i); ++c)
+            source.push_back(static_cast<uint16_t>(first + 2 * c));
+    }
+}
+
+void WAGO_Modbus::Counter_Decoder::decode(const uint16_t *ai, uint32_t *result) const noexcept {
+    const std::size_t n   = source.size();
+    const uint16_t   *src = source.data();
+
+    for (std::size_t i = 0; i < n; ++i) {
+        const auto index = src[i];
+        result[i]        = static_cast<uint32_t>(ai[index]) | (static_cast<uint32_t>(ai[index + 1]) << 16u);
+    }
+}
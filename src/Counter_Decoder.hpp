@@ -0,0 +1,54 @@
+/*
+ * Copyright (C) 2023 Nikolas Koesling <nikolas@koesling.info>.
+ * This program is free software. You can redistribute it and/or modify it under the terms of the MIT License.
+ */
+
+#pragma once
+
+#include "WAGO_MB_Clamps.hpp"
+
+#include <cstdint>
+#include <vector>
+
+namespace WAGO_Modbus {
+
+/**
+ * @brief decode the 32 bit values of complex modules (counters, encoders, ...)
+ * @details
+ *      The 32 bit values are spread over two words of the analog input image (low word first).
+ *      The word indices of all values are computed once by build.
+ *      decode only combines the words, the result is stored contiguously (one uint32_t per channel).
+ *      Signed values (Clamp_Data_Type::INT32) are stored as two's complement.
+ */
+class Counter_Decoder final {
+private:
+    std::vector<uint16_t> source;   //*< index of the low word of each value in the analog input image
+    std::vector<uint16_t> offsets;  //*< index of the first value of each module in the result (per module)
+
+public:
+    /**
+     * @brief compute the word indices of all 32 bit values for a module list
+     * @param clamps list of connected modules
+     */
+    void build(const Clamp_Table &clamps);
+
+    /**
+     * @brief number of 32 bit values
+     */
+    [[nodiscard]] inline std::size_t size() const noexcept { return source.size(); }
+
+    /**
+     * @brief index of the first value of a module in the result
+     * @param i module index
+     */
+    [[nodiscard]] inline std::size_t get_offset(std::size_t i) const noexcept { return offsets[i]; }
+
+    /**
+     * @brief decode 32 bit values
+     * @param ai analog input image
+     * @param result decoded values (space for size() values)
+     */
+    void decode(const uint16_t *ai, uint32_t *result) const noexcept;
+};
+
+}  // namespace WAGO_Modbus
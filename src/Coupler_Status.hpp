@@ -0,0 +1,94 @@
+/*
+ * Copyright (C) 2023 Nikolas Koesling <nikolas@koesling.info>.
+ * This program is free software. You can redistribute it and/or modify it under the terms of the MIT License.
+ */
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <type_traits>
+
+namespace WAGO_Modbus {
+
+/**
+ * @brief layout of the status shared memory (<prefix>STATUS)
+ * @details
+ *      The shared memory contains one Status structure. All values are stored in host byte order.
+ *      New fields are only appended. Consumers can check Status::size before they access a field.
+ *
+ *      The values are protected by a sequence lock: sequence is odd while the values are updated.
+ *      Use read to get a consistent copy of the values.
+ *
+ *      If modules are added or removed, the images, the channel map and the 32 bit image are recreated with the new
+ *      layout and layout_generation is incremented. The status shared memory itself is not recreated.
+ *      Consumers that see a new layout_generation have to map the other shared memories again.
+ */
+namespace Coupler_Status {
+static constexpr std::array<char, 8> MAGIC   = {'W', 'A', 'G', 'O', 'S', 'T', 'A', '\0'};
+static constexpr uint32_t            VERSION = 1;
+
+struct Status {
+    std::array<char, 8>   magic;     //*< MAGIC
+    uint32_t              version;   //*< VERSION
+    uint32_t              size;      //*< size of this structure
+    std::atomic<uint32_t> sequence;  //*< sequence lock (odd: update in progress)
+    uint32_t              reserved;  //*< reserved (0)
+
+    // diagnostics (read in the idle time of the cycle)
+    uint64_t diagnostics_time;     //*< time of the last complete diagnostics read (ns since epoch)
+    uint64_t diagnostics_count;    //*< number of complete diagnostics reads
+    uint64_t diagnostics_errors;   //*< number of failed diagnostics reads
+    uint16_t io_module_diagnosis;  //*< diagnosis of the I/O modules (0x1050)
+    uint16_t led_error_code;       //*< error code of the I/O LED (0x1020)
+    uint16_t led_error_argument;   //*< error argument of the I/O LED (0x1021)
+    uint16_t coupler_diagnostics;  //*< fieldbus coupler diagnostics (0x2036)
+
+    // layout of the process data images
+    uint64_t                layout_generation;   //*< incremented each time the images are recreated
+    std::array<uint16_t, 4> process_image_bits;  //*< image sizes reported by the coupler in bits (AO, AI, DO, DI)
+
+    // outputs
+    uint64_t output_conflicts;  //*< rejected claims and writes of the output ownership (see Output_Ownership)
+
+    // cycle
+    uint64_t cycle_period;    //*< effective cycle time in ns (0: as fast as possible)
+    uint64_t cycle_duration;  //*< average duration of the image transfers of a cycle in ns
+
+    // latency of the transfers (kernel socket timestamps, see Modbus_Transport::Latency; 0: not measured)
+    uint64_t latency_samples;    //*< number of transfers with kernel timestamps
+    uint64_t wire_latency;       //*< average time spent in the network and the coupler in ns
+    uint64_t wire_latency_max;   //*< maximum time spent in the network and the coupler in ns
+    uint64_t transfer_overhead;  //*< average time of a transfer spent in this application and the kernel in ns
+
+    // outputs (continued)
+    uint64_t transaction_aborts;  //*< aborted output transactions (see Output_Transaction::TIMEOUT_CYCLES)
+};
+
+static_assert(std::is_standard_layout_v<Status>);
+static_assert(sizeof(Status) == 136, "unexpected status size");
+static_assert(std::atomic<uint32_t>::is_always_lock_free, "sequence lock requires lock free atomics");
+
+/**
+ * @brief read a consistent copy of the values
+ * @details function is called repeatedly until the values were not modified during the call
+ * @param status status shared memory
+ * @param function function that copies the required values
+ */
+template <typename Function>
+inline void read(const Status &status, Function &&function) {
+    for (;;) {
+        const auto begin = status.sequence.load(std::memory_order_acquire);
+        if (begin & 1u) continue;
+
+        function(status);
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (status.sequence.load(std::memory_order_relaxed) == begin) return;
+    }
+}
+
+}  // namespace Coupler_Status
+
+}  // namespace WAGO_Modbus
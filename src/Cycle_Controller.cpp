@@ -0,0 +1,38 @@
+/*
+ * Copyright (C) 2023 Nikolas Koesling <nikolas@koesling.info>.
+ * This program is free software. You can redistribute it and/or modify it under the terms of the MIT License.
+ */
+
+#include "Cycle_Controller.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+Cycle_Controller::Cycle_Controller(std::chrono::nanoseconds min_period,
+                                   std::chrono::nanoseconds max_period,
+                                   std::chrono::nanoseconds initial_period)
+    : min_period(min_period), max_period(max_period), period(initial_period), next_period(initial_period) {
+    if (max_period < min_period) throw std::invalid_argument("maximum cycle time less than minimum cycle time");
+    period      = std::clamp(period, min_period, max_period);
+    next_period = period;
+}
+
+std::chrono::nanoseconds Cycle_Controller::update(std::chrono::nanoseconds duration, std::chrono::nanoseconds reserve) {
+    if (!measured) {
+        average   = duration;
+        deviation = duration / 2;
+        measured  = true;
+    } else {
+        const auto error = duration - average;
+        average += error / AVERAGE_DIVISOR;
+        deviation += (std::chrono::abs(error) - deviation) / DEVIATION_DIVISOR;
+    }
+
+    const auto target = average + DEVIATION_FACTOR * deviation;
+    if (target > period) period = target;
+    else period -= (period - target) / DECREASE_DIVISOR;
+
+    period      = std::clamp(period, min_period, max_period);
+    next_period = std::min(period + reserve, max_period);
+    return next_period;
+}
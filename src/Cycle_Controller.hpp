@@ -0,0 +1,73 @@
+/*
+ * Copyright (C) 2023 Nikolas Koesling <nikolas@koesling.info>.
+ * This program is free software. You can redistribute it and/or modify it under the terms of the MIT License.
+ */
+
+#pragma once
+
+#include <chrono>
+
+/**
+ * @brief adaptive cycle time
+ * @details
+ *      Estimates the achievable cycle time from the measured durations of the cycles.
+ *      The average duration and its mean deviation are smoothed like the round trip time of TCP (RFC 6298).
+ *      The target period is
+ *          average + DEVIATION_FACTOR * deviation
+ *      The period is increased to the target immediately, but decreased only slowly (1 / DECREASE_DIVISOR of the
+ *      difference per cycle), so sporadic fast cycles do not lead to overruns. The period is limited to [min, max].
+ *      A reserve (e.g. a diagnostics read that is due) only extends the next cycle, it does not raise the period.
+ *      With min == max the period is fixed and only the average duration is estimated.
+ */
+class Cycle_Controller final {
+public:
+    static constexpr long AVERAGE_DIVISOR   = 8;   //*< gain of the average duration (1/8)
+    static constexpr long DEVIATION_DIVISOR = 4;   //*< gain of the mean deviation (1/4)
+    static constexpr long DEVIATION_FACTOR  = 4;   //*< weight of the mean deviation in the target period
+    static constexpr long DECREASE_DIVISOR  = 16;  //*< gain of period decreases (1/16)
+
+private:
+    std::chrono::nanoseconds min_period;    // lower bound of the period
+    std::chrono::nanoseconds max_period;    // upper bound of the period
+    std::chrono::nanoseconds period;        // current period (without reserve)
+    std::chrono::nanoseconds next_period;   // period of the next cycle (with reserve)
+    std::chrono::nanoseconds average {};    // smoothed cycle duration
+    std::chrono::nanoseconds deviation {};  // smoothed mean deviation of the cycle duration
+    bool                     measured = false;  // average and deviation are valid
+
+public:
+    /**
+     * @brief create cycle controller
+     * @param min_period lower bound of the period
+     * @param max_period upper bound of the period
+     * @param initial_period period until the first measurement (limited to [min_period, max_period])
+     *
+     * @exception std::invalid_argument max_period less than min_period
+     */
+    Cycle_Controller(std::chrono::nanoseconds min_period,
+                     std::chrono::nanoseconds max_period,
+                     std::chrono::nanoseconds initial_period);
+
+    /**
+     * @brief add the measured duration of a cycle and compute the next period
+     * @param duration duration of the cycle (without idle time)
+     * @param reserve time that is required in the idle time of the next cycle (e.g. a diagnostics read that is due)
+     * @return period of the next cycle (period plus reserve, limited to the upper bound)
+     */
+    std::chrono::nanoseconds update(std::chrono::nanoseconds duration, std::chrono::nanoseconds reserve);
+
+    /**
+     * @brief get the period of the next cycle (return value of the last update)
+     */
+    [[nodiscard]] inline std::chrono::nanoseconds get_period() const noexcept { return next_period; }
+
+    /**
+     * @brief get the smoothed cycle duration
+     */
+    [[nodiscard]] inline std::chrono::nanoseconds get_average_duration() const noexcept { return average; }
+
+    /**
+     * @brief check if the period is at the upper bound
+     */
+    [[nodiscard]] inline bool at_max() const noexcept { return next_period >= max_period; }
+};
@@ -0,0 +1,70 @@
+/*
+ * Copyright (C) 2023 Nikolas Koesling <nikolas@koesling.info>.
+ * This program is free software. You can redistribute it and/or modify it under the terms of the MIT License.
+ */
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <type_traits>
+
+namespace WAGO_Modbus {
+
+/**
+ * @brief message that hands the memfd images to a consumer (see TCP_Coupler_SHM::set_memfd_handover)
+ * @details
+ *      A consumer connects to the handover socket and receives one message, then the connection is closed.
+ *      The message consists of a Header followed by Header::count Entry structures. The file descriptors are passed
+ *      as SCM_RIGHTS ancillary data of the same message, in the order of the entries.
+ *      All values are stored in host byte order.
+ *
+ *      The STATUS memfd persists for the lifetime of the application. If its layout generation changes, the consumer
+ *      closes the other file descriptors and connects again to receive the new images.
+ */
+namespace Image_Handover {
+static constexpr std::array<char, 8> MAGIC   = {'W', 'A', 'G', 'O', 'F', 'D', 'S', '\0'};
+static constexpr uint32_t            VERSION = 1;
+
+/**
+ * @brief images of Entry::image (the first four match Channel_Map::Image)
+ */
+enum Image : uint32_t {  // NOLINT
+    DI     = 0,
+    DO     = 1,
+    AI     = 2,
+    AO     = 3,
+    AI_EU  = 4,
+    CNT    = 5,
+    MAP    = 6,
+    STATUS = 7,
+    OWNERS = 8,
+    IMAGES = 9
+};
+
+/**
+ * @brief flags of Entry::flags
+ */
+enum Flags : uint32_t { WRITABLE = 0x0001 };  // NOLINT
+
+struct Header {
+    std::array<char, 8> magic;              //*< MAGIC
+    uint32_t            version;            //*< VERSION
+    uint32_t            count;              //*< number of entries (and file descriptors)
+    uint64_t            layout_generation;  //*< layout generation of the images
+};
+
+struct Entry {
+    uint32_t image;  //*< image (Image)
+    uint32_t flags;  //*< WRITABLE: the memfd can be mapped writable
+    uint64_t size;   //*< size in bytes
+};
+
+static_assert(std::is_standard_layout_v<Header> && std::is_trivially_copyable_v<Header>);
+static_assert(std::is_standard_layout_v<Entry> && std::is_trivially_copyable_v<Entry>);
+static_assert(sizeof(Header) == 24, "unexpected image handover header size");
+static_assert(sizeof(Entry) == 16, "unexpected image handover entry size");
+
+}  // namespace Image_Handover
+
+}  // namespace WAGO_Modbus
@@ -0,0 +1,53 @@
+/*
+ * Copyright (C) 2023 Nikolas Koesling <nikolas@koesling.info>.
+ * This program is free software. You can redistribute it and/or modify it under the terms of the MIT License.
+ */
+
+#include "Image_Memory.hpp"
+
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <system_error>
+#include <unistd.h>
+
+// available since Linux 5.1
+#ifndef F_SEAL_FUTURE_WRITE
+#    define F_SEAL_FUTURE_WRITE 0x0010
+#endif
+
+Image_Memory::Image_Memory(const std::string &name, std::size_t size, bool exclusive)
+    : shm(std::make_unique<cxxshm::SharedMemory>(name, size, false, exclusive)) {}
+
+Image_Memory::Image_Memory(const std::string &name, std::size_t size, Access access) : name(name), size(size) {
+    fd = memfd_create(name.c_str(), MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if (fd == -1) throw std::system_error(errno, std::generic_category(), "memfd_create " + name);
+
+    auto fail = [this](const char *what) {
+        const int error = errno;
+        if (addr) munmap(addr, this->size);
+        close(fd);
+        throw std::system_error(error, std::generic_category(), std::string(what) + ' ' + this->name);
+    };
+
+    if (ftruncate(fd, static_cast<off_t>(size)) == -1) fail("ftruncate");
+
+    // the writable mapping must exist before F_SEAL_FUTURE_WRITE is applied
+    if (size) {
+        addr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (addr == MAP_FAILED) {
+            addr = nullptr;
+            fail("mmap");
+        }
+    }
+
+    int seals = F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL;
+    if (access == Access::READ_ONLY) seals |= F_SEAL_FUTURE_WRITE;
+    if (fcntl(fd, F_ADD_SEALS, seals) == -1) fail("fcntl(F_ADD_SEALS)");
+}
+
+Image_Memory::~Image_Memory() {
+    if (shm) return;
+    if (addr) munmap(addr, size);
+    close(fd);
+}
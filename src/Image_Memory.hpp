@@ -0,0 +1,84 @@
+/*
+ * Copyright (C) 2023 Nikolas Koesling <nikolas@koesling.info>.
+ * This program is free software. You can redistribute it and/or modify it under the terms of the MIT License.
+ */
+
+#pragma once
+
+#include "cxxshm.hpp"
+
+#include <cstddef>
+#include <memory>
+#include <string>
+
+/**
+ * @brief memory of a process data image
+ * @details
+ *      Either a named POSIX shared memory (cxxshm) or an anonymous sealed memfd.
+ *      A memfd has no name in the file system, so it can not become an orphan. Consumers receive its file descriptor
+ *      (e.g. via SCM_RIGHTS) and can not change its size. Access::READ_ONLY memfds can not be mapped writable by
+ *      consumers.
+ */
+class Image_Memory final {
+public:
+    /**
+     * @brief access of the consumers of a memfd
+     */
+    enum class Access { READ_WRITE, READ_ONLY };
+
+private:
+    std::unique_ptr<cxxshm::SharedMemory> shm;  // named shared memory (nullptr: memfd)
+
+    std::string name;            // name of the memfd
+    int         fd   = -1;       // memfd
+    void       *addr = nullptr;  // mapping of the memfd (nullptr if size is 0)
+    std::size_t size = 0;        // size of the memfd
+
+public:
+    /**
+     * @brief create named shared memory
+     * @param name name of the shared memory
+     * @param size size in bytes
+     * @param exclusive fail if the shared memory already exists
+     *
+     * @exception std::system_error failed to create shared memory
+     */
+    Image_Memory(const std::string &name, std::size_t size, bool exclusive);
+
+    /**
+     * @brief create sealed memfd
+     * @details the size is sealed, READ_ONLY memfds are additionally sealed against new writable mappings
+     * @param name name of the memfd (only for debugging, see /proc/<pid>/fd)
+     * @param size size in bytes
+     * @param access access of the consumers
+     *
+     * @exception std::system_error failed to create, map or seal the memfd
+     */
+    Image_Memory(const std::string &name, std::size_t size, Access access);
+
+    ~Image_Memory();
+
+    Image_Memory(const Image_Memory &other)            = delete;
+    Image_Memory(Image_Memory &&other)                 = delete;
+    Image_Memory &operator=(const Image_Memory &other) = delete;
+    Image_Memory &operator=(Image_Memory &&other)      = delete;
+
+    template <typename T>
+    [[nodiscard]] inline T get_addr() const noexcept {
+        return shm ? shm->get_addr<T>() : reinterpret_cast<T>(addr);
+    }
+
+    template <typename T>
+    [[nodiscard]] inline T &at(std::size_t index) noexcept {
+        return get_addr<T *>()[index];
+    }
+
+    [[nodiscard]] inline std::size_t get_size() const noexcept { return shm ? shm->get_size() : size; }
+
+    [[nodiscard]] inline int get_fd() const noexcept { return shm ? shm->get_fd() : fd; }
+
+    /**
+     * @brief check if the memory is a memfd (and not a named shared memory)
+     */
+    [[nodiscard]] inline bool is_memfd() const noexcept { return !shm; }
+};
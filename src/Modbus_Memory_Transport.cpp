@@ -0,0 +1,107 @@
+/*
+ * Copyright (C) 2023 Nikolas Koesling <nikolas@koesling.info>.
+ * This program is free software. You can redistribute it and/or modify it under the terms of the MIT License.
+ */
+
+#include "Modbus_Memory_Transport.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+Modbus_Memory_Transport::Modbus_Memory_Transport(std::mt19937::result_type seed)
+    : coils(TABLE_SIZE), discrete_inputs(TABLE_SIZE), holding_registers(TABLE_SIZE), input_registers(TABLE_SIZE),
+      rng(seed), fault_distribution(0.0, 1.0) {}
+
+void Modbus_Memory_Transport::set_fault_rate(double probability) {
+    if (probability < 0.0 || probability > 1.0) throw std::invalid_argument("fault rate out of range");
+    fault_rate = probability;
+}
+
+void Modbus_Memory_Transport::connect() {
+    if (connected) throw std::logic_error("already connected to modbus client");
+    connected = true;
+}
+
+void Modbus_Memory_Transport::disconnect() {
+    if (!connected) throw std::logic_error("not connected to modbus client");
+    connected = false;
+}
+
+void Modbus_Memory_Transport::transaction(uint16_t addr, std::size_t size, const char *what) const {
+    if (!connected) throw std::logic_error("not connected to modbus client");
+    if (addr + size > UINT16_MAX) throw std::out_of_range("resulting address out of range");
+
+    ++transactions;
+
+    if (latency.count() > 0) {
+        const auto end = std::chrono::steady_clock::now() + latency;
+        while (std::chrono::steady_clock::now() < end) {}
+    }
+
+    bool fault = false;
+    if (forced_faults) {
+        --forced_faults;
+        fault = true;
+    } else if (fault_rate > 0.0) {
+        fault = fault_distribution(rng) < fault_rate;
+    }
+
+    if (fault) throw std::runtime_error(std::string("failed to ") + what + " modbus client: injected fault");
+}
+
+std::vector<std::vector<uint16_t>>
+        Modbus_Memory_Transport::read_ai(const std::vector<std::pair<std::uint16_t, std::size_t>> &registers) const {
+    return read_ranges(registers, Function::READ_INPUT_REGISTERS, [this](const std::vector<Request> &requests) {
+        for (const auto &request : requests) {
+            transaction(request.addr, request.size, "read from");
+            const auto begin = input_registers.begin() + request.addr;
+            std::copy(begin, begin + static_cast<std::ptrdiff_t>(request.size), static_cast<uint16_t *>(request.data));
+        }
+    });
+}
+
+std::vector<std::vector<uint16_t>>
+        Modbus_Memory_Transport::read_ao(const std::vector<std::pair<std::uint16_t, std::size_t>> &registers) const {
+    return read_ranges(registers, Function::READ_HOLDING_REGISTERS, [this](const std::vector<Request> &requests) {
+        for (const auto &request : requests) {
+            transaction(request.addr, request.size, "read from");
+            const auto begin = holding_registers.begin() + request.addr;
+            std::copy(begin, begin + static_cast<std::ptrdiff_t>(request.size), static_cast<uint16_t *>(request.data));
+        }
+    });
+}
+
+void Modbus_Memory_Transport::write_ao(uint16_t addr, uint16_t value) {
+    transaction(addr, 1, "write to");
+    holding_registers[addr] = value;
+}
+
+void Modbus_Memory_Transport::read_di(uint8_t *result, uint16_t addr, std::size_t size) {
+    transaction(addr, size, "read from");
+    std::copy_n(discrete_inputs.data() + addr, size, result);
+}
+
+void Modbus_Memory_Transport::read_do(uint8_t *result, uint16_t addr, std::size_t size) {
+    transaction(addr, size, "read from");
+    std::copy_n(coils.data() + addr, size, result);
+}
+
+void Modbus_Memory_Transport::read_ai(uint16_t *result, uint16_t addr, std::size_t size) {
+    transaction(addr, size, "read from");
+    std::copy_n(input_registers.data() + addr, size, result);
+}
+
+void Modbus_Memory_Transport::read_ao(uint16_t *result, uint16_t addr, std::size_t size) {
+    transaction(addr, size, "read from");
+    std::copy_n(holding_registers.data() + addr, size, result);
+}
+
+void Modbus_Memory_Transport::write_do(const uint8_t *data, uint16_t addr, std::size_t size) {
+    transaction(addr, size, "write to");
+    std::copy_n(data, size, coils.data() + addr);
+}
+
+void Modbus_Memory_Transport::write_ao(const uint16_t *data, uint16_t addr, std::size_t size) {
+    transaction(addr, size, "write to");
+    std::copy_n(data, size, holding_registers.data() + addr);
+}
@@ -0,0 +1,113 @@
+/*
+ * Copyright (C) 2023 Nikolas Koesling <nikolas@koesling.info>.
+ * This program is free software. You can redistribute it and/or modify it under the terms of the MIT License.
+ */
+
+#pragma once
+
+#include "Modbus_Transport.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+/**
+ * @brief in-process Modbus device
+ * @details
+ *      Stores coils, discrete inputs, holding registers and input registers in local memory.
+ *      Every transaction can be delayed by a configurable latency and can fail by fault injection.
+ *      Intended for deterministic benchmarks and tests of the cycle engine without a network connection.
+ */
+class Modbus_Memory_Transport final : public Modbus_Transport {
+public:
+    static constexpr std::size_t TABLE_SIZE = 0x10000;  //*< number of entries per table (complete address range)
+
+private:
+    std::vector<uint8_t>  coils;              // digital outputs
+    std::vector<uint8_t>  discrete_inputs;    // digital inputs
+    std::vector<uint16_t> holding_registers;  // analog outputs
+    std::vector<uint16_t> input_registers;    // analog inputs
+
+    bool connected = false;  // connection indicator
+
+    std::chrono::nanoseconds latency {0};  // simulated duration of each transaction
+
+    mutable std::mt19937                           rng;                  // random generator for fault injection
+    mutable std::uniform_real_distribution<double> fault_distribution;   // distribution for fault injection
+    double                                         fault_rate    = 0.0;  // probability of a failed transaction
+    mutable std::size_t                            forced_faults = 0;    // number of forced failing transactions
+    mutable std::size_t                            transactions  = 0;    // number of transactions
+
+public:
+    /**
+     * @brief Construct in-process Modbus device
+     * @details all tables are initialized with zero
+     * @param seed seed for the random fault injection
+     */
+    explicit Modbus_Memory_Transport(std::mt19937::result_type seed = std::mt19937::default_seed);
+
+    ~Modbus_Memory_Transport() override = default;
+
+    /**
+     * @brief set simulated duration of each transaction
+     * @details the transaction busy waits to avoid the jitter of the scheduler
+     * @param duration duration of each transaction
+     */
+    inline void set_latency(std::chrono::nanoseconds duration) noexcept { latency = duration; }
+
+    /**
+     * @brief set probability of a failed transaction
+     * @param probability probability in the range [0, 1]
+     *
+     * @exception std::invalid_argument probability out of range
+     */
+    void set_fault_rate(double probability);
+
+    /**
+     * @brief let the next transactions fail
+     * @param count number of transactions that will fail
+     */
+    inline void inject_faults(std::size_t count) noexcept { forced_faults += count; }
+
+    /**
+     * @brief get number of transactions since construction (including failed transactions)
+     */
+    [[nodiscard]] inline std::size_t get_transaction_count() const noexcept { return transactions; }
+
+    [[nodiscard]] inline std::vector<uint8_t>  &get_coils() noexcept { return coils; }
+    [[nodiscard]] inline std::vector<uint8_t>  &get_discrete_inputs() noexcept { return discrete_inputs; }
+    [[nodiscard]] inline std::vector<uint16_t> &get_holding_registers() noexcept { return holding_registers; }
+    [[nodiscard]] inline std::vector<uint16_t> &get_input_registers() noexcept { return input_registers; }
+
+    void connect() override;
+    void disconnect() override;
+
+    [[nodiscard]] std::vector<std::vector<uint16_t>>
+            read_ai(const std::vector<std::pair<std::uint16_t, std::size_t>> &registers) const override;
+    [[nodiscard]] std::vector<std::vector<uint16_t>>
+            read_ao(const std::vector<std::pair<std::uint16_t, std::size_t>> &registers) const override;
+
+    void write_ao(uint16_t addr, uint16_t value) override;
+
+    void read_di(uint8_t *result, uint16_t addr, std::size_t size) override;
+    void read_do(uint8_t *result, uint16_t addr, std::size_t size) override;
+    void read_ai(uint16_t *result, uint16_t addr, std::size_t size) override;
+    void read_ao(uint16_t *result, uint16_t addr, std::size_t size) override;
+    void write_do(const uint8_t *data, uint16_t addr, std::size_t size) override;
+    void write_ao(const uint16_t *data, uint16_t addr, std::size_t size) override;
+
+private:
+    /**
+     * @brief simulate a transaction
+     * @details checks the connection and the address range, applies latency and fault injection
+     * @param addr start address
+     * @param size number of registers
+     * @param what description of the operation for error messages ("read from" or "write to")
+     *
+     * @exception std::logic_error not connected to modbus client
+     * @exception std::out_of_range resulting address out of range
+     * @exception std::runtime_error injected fault
+     */
+    void transaction(uint16_t addr, std::size_t size, const char *what) const;
+};
@@ -0,0 +1,499 @@
+/*
+ * Copyright (C) 2023 Nikolas Koesling <nikolas@koesling.info>.
+ * This program is free software. You can redistribute it and/or modify it under the terms of the MIT License.
+ */
+
+#include "Modbus_Raw_TCP.hpp"
+
+#include "endian.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <linux/errqueue.h>
+#include <linux/net_tstamp.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdexcept>
+#include <sys/socket.h>
+#include <system_error>
+#include <unistd.h>
+
+static constexpr uint8_t     EXCEPTION_FLAG = 0x80;
+static constexpr std::size_t CONTROL_SIZE   = 256;  // buffer for control messages (timestamps, extended errors)
+
+static inline void put_u16(uint8_t *dst, std::size_t value) {
+    dst[0] = static_cast<uint8_t>((value >> 8u) & 0xFFu);
+    dst[1] = static_cast<uint8_t>(value & 0xFFu);
+}
+
+static inline uint16_t get_u16(const uint8_t *src) {
+    return static_cast<uint16_t>((src[0] << 8u) | src[1]);
+}
+
+static inline bool is_write(Modbus_Transport::Function function) {
+    return function == Modbus_Transport::Function::WRITE_MULTIPLE_COILS ||
+           function == Modbus_Transport::Function::WRITE_MULTIPLE_REGISTERS;
+}
+
+static inline bool is_bits(Modbus_Transport::Function function) {
+    return function == Modbus_Transport::Function::READ_COILS ||
+           function == Modbus_Transport::Function::READ_DISCRETE_INPUTS ||
+           function == Modbus_Transport::Function::WRITE_MULTIPLE_COILS;
+}
+
+static inline const char *error_prefix(Modbus_Transport::Function function) {
+    return is_write(function) ? "failed to write to modbus client: " : "failed to read from modbus client: ";
+}
+
+static inline bool is_set(const timespec &time) {
+    return time.tv_sec != 0 || time.tv_nsec != 0;
+}
+
+static inline std::chrono::nanoseconds to_duration(const timespec &time) {
+    return std::chrono::seconds(time.tv_sec) + std::chrono::nanoseconds(time.tv_nsec);
+}
+
+/**
+ * @brief get the kernel timestamps of a received message
+ * @param msg received message
+ * @param timestamps timestamps (0: software, 2: hardware; see scm_timestamping). Not modified if the message does not
+ *                   contain timestamps.
+ * @return true if the message contains timestamps
+ */
+static bool get_timestamps(msghdr &msg, std::array<timespec, 3> &timestamps) {
+    for (auto *cmsg = CMSG_FIRSTHDR(&msg); cmsg != nullptr; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+        if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_TIMESTAMPING) continue;
+
+        scm_timestamping data {};
+        std::memcpy(&data, CMSG_DATA(cmsg), sizeof(data));
+        std::copy(std::begin(data.ts), std::end(data.ts), timestamps.begin());
+        return true;
+    }
+    return false;
+}
+
+Modbus_Raw_TCP::Modbus_Raw_TCP(std::string               host,
+                               std::string               service,
+                               bool                      pipelining,
+                               std::chrono::milliseconds response_timeout)
+    : host(std::move(host)), service(std::move(service)), pipelining(pipelining) {
+    socket_options.response_timeout = response_timeout;
+}
+
+Modbus_Raw_TCP::~Modbus_Raw_TCP() {
+    if (connected) disconnect();
+}
+
+void Modbus_Raw_TCP::connect() {
+    if (connected) throw std::logic_error("already connected to modbus client");
+    open_socket();
+    connected = true;
+}
+
+void Modbus_Raw_TCP::open_socket() const {
+
+    addrinfo hints {};
+    hints.ai_family   = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_protocol = IPPROTO_TCP;
+
+    addrinfo *addresses = nullptr;
+    int       tmp       = getaddrinfo(host.c_str(), service.c_str(), &hints, &addresses);
+    if (tmp != 0) {
+        const std::string error_msg = gai_strerror(tmp);
+        throw std::runtime_error("failed to connect to modbus client: " + error_msg);
+    }
+
+    int connect_errno = 0;
+    for (auto *address = addresses; address != nullptr; address = address->ai_next) {
+        sock = socket(address->ai_family, address->ai_socktype | SOCK_CLOEXEC, address->ai_protocol);
+        if (sock == -1) {
+            connect_errno = errno;
+            continue;
+        }
+
+        if (::connect(sock, address->ai_addr, address->ai_addrlen) == 0) break;
+
+        connect_errno = errno;
+        close(sock);
+        sock = -1;
+    }
+    freeaddrinfo(addresses);
+
+    if (sock == -1) {
+        const std::string error_msg = strerror(connect_errno);
+        throw std::runtime_error("failed to connect to modbus client: " + error_msg);
+    }
+
+    // requests are sent completely by one system call (TCP_NODELAY)
+    try {
+        apply_socket_options();
+    } catch (const std::system_error &) {
+        close(sock);
+        sock = -1;
+        throw;
+    }
+
+    const auto usec =
+            std::chrono::duration_cast<std::chrono::microseconds>(socket_options.response_timeout).count();
+    timeval timeout {};
+    timeout.tv_sec  = usec / 1000000;
+    timeout.tv_usec = usec % 1000000;
+    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    setsockopt(sock, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+    // without timestamps the latency is not measured
+    timestamps_enabled = timestamping && enable_timestamps();
+}
+
+void Modbus_Raw_TCP::disconnect() {
+    if (!connected) throw std::logic_error("not connected to modbus client");
+    if (sock != -1) close(sock);
+    sock               = -1;
+    connected          = false;
+    timestamps_enabled = false;
+}
+
+void Modbus_Raw_TCP::reconnect() const noexcept {
+    if (sock != -1) close(sock);
+    sock               = -1;
+    timestamps_enabled = false;
+
+    try {
+        open_socket();
+    } catch (const std::runtime_error &) {
+        // retried by the next transfer
+    }
+}
+
+void Modbus_Raw_TCP::set_timestamping(bool enable) {
+    if (connected) throw std::logic_error("already connected to modbus client");
+    timestamping = enable;
+}
+
+const Modbus_Transport::Latency *Modbus_Raw_TCP::get_latency() const noexcept {
+    return timestamps_enabled ? &latency : nullptr;
+}
+
+bool Modbus_Raw_TCP::enable_timestamps() const noexcept {
+    // hardware timestamps are only generated if the network interface is configured for them (SIOCSHWTSTAMP)
+    const unsigned flags = SOF_TIMESTAMPING_TX_SOFTWARE | SOF_TIMESTAMPING_RX_SOFTWARE | SOF_TIMESTAMPING_SOFTWARE |
+                           SOF_TIMESTAMPING_TX_HARDWARE | SOF_TIMESTAMPING_RX_HARDWARE |
+                           SOF_TIMESTAMPING_RAW_HARDWARE | SOF_TIMESTAMPING_OPT_TSONLY;
+    return setsockopt(sock, SOL_SOCKET, SO_TIMESTAMPING, &flags, sizeof(flags)) == 0;
+}
+
+void Modbus_Raw_TCP::record_latency(std::chrono::steady_clock::time_point start) const noexcept {
+    const auto duration = std::chrono::steady_clock::now() - start;
+
+    // send timestamps are queued in the error queue (the last one belongs to the last sent byte)
+    std::array<timespec, 3> send_timestamp {};
+    bool                    sent = false;
+    for (;;) {
+        alignas(cmsghdr) std::array<uint8_t, CONTROL_SIZE> control;
+        msghdr                                              msg {};
+        msg.msg_control    = control.data();
+        msg.msg_controllen = control.size();
+        if (recvmsg(sock, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) == -1) break;
+        if (get_timestamps(msg, send_timestamp)) sent = true;
+    }
+
+    // hardware timestamps if available in both directions
+    const std::size_t index = is_set(send_timestamp[2]) && is_set(receive_timestamp[2]) ? 2 : 0;
+    if (!sent || !is_set(send_timestamp[index]) || !is_set(receive_timestamp[index])) {
+        ++latency.missing;
+        return;
+    }
+
+    const auto wire = to_duration(receive_timestamp[index]) - to_duration(send_timestamp[index]);
+    if (wire.count() < 0) {
+        ++latency.missing;
+        return;
+    }
+    const auto overhead = std::max(duration - wire, std::chrono::nanoseconds(0));
+
+    if (latency.samples == 0) {
+        latency.wire     = wire;
+        latency.overhead = overhead;
+    } else {
+        latency.wire += (wire - latency.wire) / 8;
+        latency.overhead += (overhead - latency.overhead) / 8;
+    }
+    latency.wire_max = std::max(latency.wire_max, wire);
+    ++latency.samples;
+}
+
+Modbus_Raw_TCP::Frame Modbus_Raw_TCP::make_frame(const Request &request) {
+    if (request.addr + request.size > UINT16_MAX) throw std::out_of_range("resulting address out of range");
+
+    const std::size_t max_size = max_request_size(request.function);
+    if (request.size == 0 || request.size > max_size) throw std::out_of_range("too many values in one request");
+
+    Frame frame;
+    frame.request = request;
+
+    auto &h = frame.header;
+    // MBAP: transaction id (set on transfer), protocol id, length, unit id
+    put_u16(h.data() + 2, 0);
+    h[6] = UNIT_ID;
+    // PDU: function code, start address, quantity
+    h[7] = static_cast<uint8_t>(request.function);
+    put_u16(h.data() + 8, request.addr);
+    put_u16(h.data() + 10, request.size);
+
+    if (is_write(request.function)) {
+        const auto bytes = is_bits(request.function) ? (request.size + 7) / 8 : request.size * 2;
+        h[12]              = static_cast<uint8_t>(bytes);
+        frame.header_size  = MAX_HEADER_SIZE;
+        frame.payload_size = bytes;
+        frame.payload.resize((bytes + 1) / 2);
+    } else {
+        frame.header_size = MBAP_SIZE + 5;
+    }
+
+    // length: unit id + PDU
+    put_u16(h.data() + 4, frame.header_size - MBAP_SIZE + 1 + frame.payload_size);
+
+    return frame;
+}
+
+void Modbus_Raw_TCP::send_frames(Frame *frames, std::size_t count) const {
+    iov.clear();
+    for (std::size_t i = 0; i < count; ++i) {
+        auto &frame = frames[i];
+        put_u16(frame.header.data(), transaction_id++);
+
+        if (frame.request.function == Function::WRITE_MULTIPLE_COILS) {
+            const auto *src     = static_cast<const uint8_t *>(frame.request.data);
+            auto       *payload = reinterpret_cast<uint8_t *>(frame.payload.data());
+            std::fill_n(payload, frame.payload_size, 0);
+            for (std::size_t b = 0; b < frame.request.size; ++b) {
+                if (src[b]) payload[b / 8] = static_cast<uint8_t>(payload[b / 8] | (1u << (b % 8)));
+            }
+        } else if (frame.request.function == Function::WRITE_MULTIPLE_REGISTERS) {
+            endian::host_to_big_n(
+                    frame.payload.data(), static_cast<const uint16_t *>(frame.request.data), frame.request.size);
+        }
+
+        iov.push_back({frame.header.data(), frame.header_size});
+        if (frame.payload_size) iov.push_back({frame.payload.data(), frame.payload_size});
+    }
+
+    std::size_t index = 0;
+    while (index < iov.size()) {
+        msghdr msg {};
+        msg.msg_iov    = iov.data() + index;
+        msg.msg_iovlen = std::min<std::size_t>(iov.size() - index, IOV_MAX);
+
+        const auto sent = sendmsg(sock, &msg, MSG_NOSIGNAL);
+        if (sent == -1) {
+            if (errno == EINTR) continue;
+            const std::string error_msg = strerror(errno);
+            throw std::runtime_error("failed to write to modbus client: " + error_msg);
+        }
+
+        // skip completely sent buffers, adjust partially sent buffer
+        auto remaining = static_cast<std::size_t>(sent);
+        while (index < iov.size() && remaining >= iov[index].iov_len) {
+            remaining -= iov[index].iov_len;
+            ++index;
+        }
+        if (remaining) {
+            iov[index].iov_base = static_cast<uint8_t *>(iov[index].iov_base) + remaining;
+            iov[index].iov_len -= remaining;
+        }
+    }
+}
+
+void Modbus_Raw_TCP::receive(uint8_t *data, std::size_t size, bool timestamp) const {
+    timestamp = timestamp && timestamps_enabled;
+
+    while (size) {
+        alignas(cmsghdr) std::array<uint8_t, CONTROL_SIZE> control;
+        iovec                                               vec {data, size};
+        msghdr                                              msg {};
+        msg.msg_iov    = &vec;
+        msg.msg_iovlen = 1;
+        if (timestamp) {
+            msg.msg_control    = control.data();
+            msg.msg_controllen = control.size();
+        }
+
+        const auto received = recvmsg(sock, &msg, 0);
+        if (received == -1) {
+            if (errno == EINTR) continue;
+            const std::string error_msg = strerror(errno);
+            throw std::runtime_error("failed to read from modbus client: " + error_msg);
+        }
+        if (received == 0) throw std::runtime_error("failed to read from modbus client: connection closed");
+
+        // timestamp of the first part of the response
+        if (timestamp) timestamp = !get_timestamps(msg, receive_timestamp);
+
+        data += received;
+        size -= static_cast<std::size_t>(received);
+    }
+}
+
+void Modbus_Raw_TCP::receive_response(const Frame &frame) const {
+    const auto &request = frame.request;
+
+    // MBAP header + function code + byte count / exception code
+    std::array<uint8_t, MBAP_SIZE + 2> head {};
+    receive(head.data(), head.size(), true);
+
+    // once per response: the kernel leaves the quick ACK mode on its own
+    rearm_quick_ack();
+
+    if (get_u16(head.data()) != get_u16(frame.header.data()) || get_u16(head.data() + 2) != 0)
+        throw std::runtime_error(std::string(error_prefix(request.function)) + "invalid response header");
+
+    const auto function = static_cast<uint8_t>(request.function);
+    const auto length   = get_u16(head.data() + 4);
+
+    if (head[7] == (function | EXCEPTION_FLAG)) {
+        throw std::runtime_error(std::string(error_prefix(request.function)) + "modbus exception " +
+                                 std::to_string(head[8]));
+    }
+    if (head[7] != function)
+        throw std::runtime_error(std::string(error_prefix(request.function)) + "invalid function code in response");
+
+    if (is_write(request.function)) {
+        // remaining part of start address and quantity
+        std::array<uint8_t, 3> tail {};
+        if (length != 6) throw std::runtime_error("failed to write to modbus client: invalid response length");
+        receive(tail.data(), tail.size());
+        return;
+    }
+
+    const std::size_t bytes          = head[8];
+    const std::size_t expected_bytes = is_bits(request.function) ? (request.size + 7) / 8 : request.size * 2;
+    if (bytes != expected_bytes || length != bytes + 3)
+        throw std::runtime_error("failed to read from modbus client: invalid response length");
+
+    if (is_bits(request.function)) {
+        bit_buffer.resize(bytes);
+        receive(bit_buffer.data(), bytes);
+
+        auto *dst = static_cast<uint8_t *>(request.data);
+        for (std::size_t b = 0; b < request.size; ++b)
+            dst[b] = static_cast<uint8_t>((bit_buffer[b / 8] >> (b % 8)) & 1u);
+    } else {
+        // registers: the destination (shared memory) never holds big endian values, not even partially
+        register_buffer.resize(request.size);
+        receive(reinterpret_cast<uint8_t *>(register_buffer.data()), bytes);
+        endian::big_to_host_n(static_cast<uint16_t *>(request.data), register_buffer.data(), request.size);
+    }
+}
+
+void Modbus_Raw_TCP::transfer(Frame *frames, std::size_t count) const {
+    if (!connected) throw std::logic_error("not connected to modbus client");
+
+    // connection lost by a previous error
+    if (sock == -1) open_socket();
+
+    // latency: one sample per sent batch of requests
+    auto start = std::chrono::steady_clock::time_point();
+
+    try {
+        if (pipelining) {
+            if (timestamps_enabled) start = std::chrono::steady_clock::now();
+            receive_timestamp = {};
+            send_frames(frames, count);
+            for (std::size_t i = 0; i < count; ++i)
+                receive_response(frames[i]);
+            if (timestamps_enabled) record_latency(start);
+        } else {
+            for (std::size_t i = 0; i < count; ++i) {
+                if (timestamps_enabled) start = std::chrono::steady_clock::now();
+                receive_timestamp = {};
+                send_frames(frames + i, 1);
+                receive_response(frames[i]);
+                if (timestamps_enabled) record_latency(start);
+            }
+        }
+    } catch (const std::runtime_error &) {
+        // responses of the failed transfer may still arrive: they must not be read by the next transfer
+        reconnect();
+        throw;
+    }
+}
+
+std::size_t Modbus_Raw_TCP::prepare(const std::vector<Request> &requests) {
+    std::vector<Frame> frames;
+    frames.reserve(requests.size());
+    for (const auto &request : requests)
+        frames.emplace_back(make_frame(request));
+
+    prepared_frames.emplace_back(std::move(frames));
+    return prepared_frames.size() - 1;
+}
+
+void Modbus_Raw_TCP::execute(std::size_t handle) {
+    auto &frames = prepared_frames.at(handle);
+    if (frames.empty()) return;
+    transfer(frames.data(), frames.size());
+}
+
+void Modbus_Raw_TCP::clear_prepared() {
+    prepared_frames.clear();
+}
+
+void Modbus_Raw_TCP::transfer(const std::vector<Request> &requests) const {
+    std::vector<Frame> frames;
+    frames.reserve(requests.size());
+    for (const auto &request : requests)
+        frames.emplace_back(make_frame(request));
+    transfer(frames.data(), frames.size());
+}
+
+std::vector<std::vector<uint16_t>>
+        Modbus_Raw_TCP::read_ai(const std::vector<std::pair<std::uint16_t, std::size_t>> &registers) const {
+    return read_ranges(registers, Function::READ_INPUT_REGISTERS, [this](const std::vector<Request> &requests) {
+        transfer(requests);
+    });
+}
+
+std::vector<std::vector<uint16_t>>
+        Modbus_Raw_TCP::read_ao(const std::vector<std::pair<std::uint16_t, std::size_t>> &registers) const {
+    return read_ranges(registers, Function::READ_HOLDING_REGISTERS, [this](const std::vector<Request> &requests) {
+        transfer(requests);
+    });
+}
+
+void Modbus_Raw_TCP::write_ao(uint16_t addr, uint16_t value) {
+    write_ao(&value, addr, 1);
+}
+
+void Modbus_Raw_TCP::read_di(uint8_t *result, uint16_t addr, std::size_t size) {
+    auto frame = make_frame({Function::READ_DISCRETE_INPUTS, addr, size, result});
+    transfer(&frame, 1);
+}
+
+void Modbus_Raw_TCP::read_do(uint8_t *result, uint16_t addr, std::size_t size) {
+    auto frame = make_frame({Function::READ_COILS, addr, size, result});
+    transfer(&frame, 1);
+}
+
+void Modbus_Raw_TCP::read_ai(uint16_t *result, uint16_t addr, std::size_t size) {
+    auto frame = make_frame({Function::READ_INPUT_REGISTERS, addr, size, result});
+    transfer(&frame, 1);
+}
+
+void Modbus_Raw_TCP::read_ao(uint16_t *result, uint16_t addr, std::size_t size) {
+    auto frame = make_frame({Function::READ_HOLDING_REGISTERS, addr, size, result});
+    transfer(&frame, 1);
+}
+
+void Modbus_Raw_TCP::write_do(const uint8_t *data, uint16_t addr, std::size_t size) {
+    auto frame = make_frame({Function::WRITE_MULTIPLE_COILS, addr, size, const_cast<uint8_t *>(data)});
+    transfer(&frame, 1);
+}
+
+void Modbus_Raw_TCP::write_ao(const uint16_t *data, uint16_t addr, std::size_t size) {
+    auto frame = make_frame({Function::WRITE_MULTIPLE_REGISTERS, addr, size, const_cast<uint16_t *>(data)});
+    transfer(&frame, 1);
+}
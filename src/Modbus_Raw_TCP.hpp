@@ -0,0 +1,204 @@
+/*
+ * Copyright (C) 2023 Nikolas Koesling <nikolas@koesling.info>.
+ * This program is free software. You can redistribute it and/or modify it under the terms of the MIT License.
+ */
+
+#pragma once
+
+#include "Modbus_Transport.hpp"
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <ctime>
+#include <string>
+#include <sys/uio.h>
+#include <vector>
+
+/**
+ * @brief Modbus TCP client that uses a plain socket instead of libmodbus
+ * @details
+ *      The request frames of prepared transfers are computed once by prepare.
+ *      execute sends all frames of a transfer with one system call (pipelining) and
+ *      decodes the response data with one copy from a scratch buffer to the destination memory, so the destination
+ *      never holds values in network byte order.
+ *
+ *      If a transfer fails, the responses that were not read yet would be taken as responses of the next transfer.
+ *      Therefore, the socket is closed and reopened before the error is reported.
+ *
+ *      Optionally, the latency of the transfers is measured with kernel socket timestamps (SO_TIMESTAMPING, see
+ *      set_timestamping). Hardware timestamps are used if the network interface provides them.
+ */
+class Modbus_Raw_TCP final : public Modbus_Transport {
+private:
+    static constexpr std::size_t MBAP_SIZE       = 7;     // size of the Modbus TCP header
+    static constexpr std::size_t MAX_HEADER_SIZE = 13;    // MBAP header + PDU header of write multiple requests
+    static constexpr uint8_t     UNIT_ID         = 0xFF;  // unit identifier (not used by Modbus TCP devices)
+
+    /**
+     * @brief precomputed request frame
+     */
+    struct Frame {
+        Request                              request;           // request of this frame
+        std::array<uint8_t, MAX_HEADER_SIZE> header {};         // MBAP header + PDU header
+        std::size_t                          header_size  = 0;  // used bytes of header
+        std::vector<uint16_t>                payload;           // values of write requests (wire format)
+        std::size_t                          payload_size = 0;  // used bytes of payload
+    };
+
+    std::string host;        // hostname or address of the modbus client
+    std::string service;     // service or port of the modbus client
+    bool        pipelining;         // send all requests of a transfer before reading the responses
+    bool        connected = false;  // connect was called (the socket is reopened after transfer errors)
+    mutable int sock      = -1;     // socket file descriptor (-1: not connected or connection lost)
+
+    std::vector<std::vector<Frame>> prepared_frames;  // frames of prepared transfers
+
+    mutable uint16_t              transaction_id = 0;  // transaction identifier of the next request
+    mutable std::vector<iovec>    iov;                 // scratch buffer for the gathered send
+    mutable std::vector<uint8_t>  bit_buffer;          // scratch buffer for packed bits of a response
+    mutable std::vector<uint16_t> register_buffer;     // scratch buffer for big endian registers of a response
+
+    bool         timestamping       = false;  // measure the latency with kernel timestamps
+    mutable bool timestamps_enabled = false;  // SO_TIMESTAMPING is enabled on the socket
+    mutable std::array<timespec, 3> receive_timestamp {};  // kernel timestamps of the last response (scm_timestamping)
+    mutable Latency                 latency;               // latency statistics
+
+public:
+    /**
+     * @brief Construct raw Modbus TCP client
+     * @param host hostname or address (IPv4 or IPv6)
+     * @param service service or port
+     * @param pipelining send all requests of a prepared transfer before the first response is read.
+     *      Disable for devices that can not handle more than one outstanding request.
+     * @param response_timeout timeout for sending a request and receiving the response
+     *      (Socket_Options::response_timeout, used for each send and receive call)
+     */
+    Modbus_Raw_TCP(std::string               host,
+                   std::string               service,
+                   bool                      pipelining       = true,
+                   std::chrono::milliseconds response_timeout = std::chrono::milliseconds(500));
+
+    ~Modbus_Raw_TCP() override;
+
+    void connect() override;
+    void disconnect() override;
+
+    [[nodiscard]] std::vector<std::vector<uint16_t>>
+            read_ai(const std::vector<std::pair<std::uint16_t, std::size_t>> &registers) const override;
+    [[nodiscard]] std::vector<std::vector<uint16_t>>
+            read_ao(const std::vector<std::pair<std::uint16_t, std::size_t>> &registers) const override;
+
+    void write_ao(uint16_t addr, uint16_t value) override;
+
+    void read_di(uint8_t *result, uint16_t addr, std::size_t size) override;
+    void read_do(uint8_t *result, uint16_t addr, std::size_t size) override;
+    void read_ai(uint16_t *result, uint16_t addr, std::size_t size) override;
+    void read_ao(uint16_t *result, uint16_t addr, std::size_t size) override;
+    void write_do(const uint8_t *data, uint16_t addr, std::size_t size) override;
+    void write_ao(const uint16_t *data, uint16_t addr, std::size_t size) override;
+
+    std::size_t prepare(const std::vector<Request> &requests) override;
+    void        execute(std::size_t handle) override;
+    void        clear_prepared() override;
+
+    [[nodiscard]] const Latency *get_latency() const noexcept override;
+
+    [[nodiscard]] inline int get_socket() const noexcept override { return sock; }
+
+    /**
+     * @brief measure the latency of the transfers with kernel socket timestamps
+     * @details
+     *      must be called before connect.
+     *      If the socket does not support timestamps, the latency is not measured (see get_latency).
+     *      Transfers whose timestamps are not available are counted as missing.
+     * @param enable enable timestamping
+     *
+     * @exception std::logic_error already connected to modbus client
+     */
+    void set_timestamping(bool enable);
+
+private:
+    /**
+     * @brief create request frame
+     * @details the transaction identifier and the payload of write requests are set by transfer
+     *
+     * @exception std::out_of_range resulting address out of range
+     * @exception std::out_of_range too many values in one request
+     */
+    static Frame make_frame(const Request &request);
+
+    /**
+     * @brief create the socket and connect to the modbus client
+     *
+     * @exception std::runtime_error failed to connect to modbus client
+     * @exception std::system_error failed to apply socket options
+     */
+    void open_socket() const;
+
+    /**
+     * @brief close the socket and connect again (discards unread responses)
+     * @details if the connection fails, it is retried by the next transfer
+     */
+    void reconnect() const noexcept;
+
+    /**
+     * @brief send frames and receive responses
+     * @details
+     *      reopens the socket if the connection was lost.
+     *      On errors, the connection is reestablished (see reconnect) before the exception is thrown.
+     *
+     * @exception std::logic_error not connected to modbus client
+     * @exception std::runtime_error failed to read from / write to modbus client
+     */
+    void transfer(Frame *frames, std::size_t count) const;
+
+    /**
+     * @brief send requests that are not prepared and receive the responses (pipelined if enabled)
+     *
+     * @exception std::logic_error not connected to modbus client
+     * @exception std::runtime_error failed to read from / write to modbus client
+     * @exception std::out_of_range resulting address out of range
+     * @exception std::out_of_range too many values in one request
+     */
+    void transfer(const std::vector<Request> &requests) const;
+
+    /**
+     * @brief send frames with one system call
+     *
+     * @exception std::runtime_error failed to write to modbus client
+     */
+    void send_frames(Frame *frames, std::size_t count) const;
+
+    /**
+     * @brief receive response of a frame and store the values
+     *
+     * @exception std::runtime_error failed to read from modbus client
+     * @exception std::runtime_error invalid response
+     * @exception std::runtime_error modbus exception
+     */
+    void receive_response(const Frame &frame) const;
+
+    /**
+     * @brief receive exactly size bytes
+     * @param data destination
+     * @param size number of bytes
+     * @param timestamp store the kernel receive timestamp in receive_timestamp (if timestamps are enabled)
+     *
+     * @exception std::runtime_error failed to read from modbus client
+     */
+    void receive(uint8_t *data, std::size_t size, bool timestamp = false) const;
+
+    /**
+     * @brief enable kernel timestamps on the socket
+     * @return false if the socket does not support timestamps
+     */
+    bool enable_timestamps() const noexcept;
+
+    /**
+     * @brief add a transfer to the latency statistics
+     * @details reads the kernel send timestamp from the error queue of the socket
+     * @param start time at which the transfer was started
+     */
+    void record_latency(std::chrono::steady_clock::time_point start) const noexcept;
+};
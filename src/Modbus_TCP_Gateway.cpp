@@ -0,0 +1,291 @@
+/*
+ * Copyright (C) 2023 Nikolas Koesling <nikolas@koesling.info>.
+ * This program is free software. You can redistribute it and/or modify it under the terms of the MIT License.
+ */
+
+#include "Modbus_TCP_Gateway.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdexcept>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <system_error>
+#include <unistd.h>
+
+static constexpr int         LISTEN_BACKLOG      = 16;    // pending connections of the listening socket
+static constexpr std::size_t MAX_EVENTS          = 16;    // events per epoll_wait call
+static constexpr std::size_t RECEIVE_BUFFER_SIZE = 4096;  // bytes received per recv call
+static constexpr std::size_t MBAP_LENGTH_END     = 6;     // transaction id, protocol id, length (unit id + PDU)
+
+Modbus_TCP_Gateway::Modbus_TCP_Gateway(const std::string &host,
+                                       const std::string &service,
+                                       const Images      &images,
+                                       std::size_t        max_clients)
+    : max_clients(max_clients), writer_token(static_cast<uint32_t>(getpid())) {
+    set_images(images);
+
+    modbus = modbus_new_tcp_pi(host.c_str(), service.c_str());
+    if (!modbus) {
+        const std::string error_msg = modbus_strerror(errno);
+        throw std::runtime_error("failed to create modbus instance: " + error_msg);
+    }
+
+    auto cleanup = [this]() {
+        for (int fd : reply_sockets)
+            if (fd != -1) close(fd);
+        if (stop_fd != -1) close(stop_fd);
+        if (epoll_fd != -1) close(epoll_fd);
+        if (listen_socket != -1) close(listen_socket);
+        modbus_free(modbus);
+    };
+
+    listen_socket = modbus_tcp_pi_listen(modbus, LISTEN_BACKLOG);
+    if (listen_socket == -1) {
+        const std::string error_msg = modbus_strerror(errno);
+        cleanup();
+        throw std::runtime_error("failed to listen for modbus clients: " + error_msg);
+    }
+
+    epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (epoll_fd == -1) {
+        const int error = errno;
+        cleanup();
+        throw std::system_error(error, std::generic_category(), "epoll_create1");
+    }
+
+    stop_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (stop_fd == -1) {
+        const int error = errno;
+        cleanup();
+        throw std::system_error(error, std::generic_category(), "eventfd");
+    }
+
+    if (socketpair(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0, reply_sockets.data()) == -1) {
+        const int error = errno;
+        cleanup();
+        throw std::system_error(error, std::generic_category(), "socketpair");
+    }
+
+    // libmodbus sends the replies to the socket pair, they are forwarded to the clients without blocking
+    modbus_set_socket(modbus, reply_sockets[0]);
+
+    for (int fd : {listen_socket, stop_fd}) {
+        epoll_event event {};
+        event.events  = EPOLLIN;
+        event.data.fd = fd;
+        if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event) == -1) {
+            const int error = errno;
+            cleanup();
+            throw std::system_error(error, std::generic_category(), "epoll_ctl");
+        }
+    }
+
+    try {
+        thread = std::thread(&Modbus_TCP_Gateway::run, this);
+    } catch (const std::system_error &) {
+        cleanup();
+        throw;
+    }
+}
+
+Modbus_TCP_Gateway::~Modbus_TCP_Gateway() {
+    const uint64_t value = 1;
+    if (write(stop_fd, &value, sizeof(value)) != sizeof(value)) {
+        // eventfd can only fail on counter overflow: the thread is already notified
+    }
+    thread.join();
+    detach_writers();
+
+    for (const auto &client : clients)
+        close(client.sock);
+    for (int fd : reply_sockets)
+        close(fd);
+    close(stop_fd);
+    close(epoll_fd);
+    close(listen_socket);
+    modbus_free(modbus);
+}
+
+void Modbus_TCP_Gateway::set_images(const Images &images) {
+    std::lock_guard<std::mutex> lock(mapping_mutex);
+    detach_writers();
+    mapping.tab_bits            = images.coils;
+    mapping.nb_bits             = static_cast<int>(images.coils_size);
+    mapping.tab_input_bits      = images.discrete_inputs;
+    mapping.nb_input_bits       = static_cast<int>(images.discrete_inputs_size);
+    mapping.tab_registers       = images.holding_registers;
+    mapping.nb_registers        = static_cast<int>(images.holding_registers_size);
+    mapping.tab_input_registers = images.input_registers;
+    mapping.nb_input_registers  = static_cast<int>(images.input_registers_size);
+    coils_trailer               = images.coils_trailer;
+    registers_trailer           = images.holding_registers_trailer;
+    coils_writer                = attach(coils_trailer);
+    registers_writer            = attach(registers_trailer);
+}
+
+void Modbus_TCP_Gateway::run() {
+    std::array<epoll_event, MAX_EVENTS> events {};
+
+    for (;;) {
+        const int count = epoll_wait(epoll_fd, events.data(), static_cast<int>(events.size()), -1);
+        if (count == -1) {
+            if (errno == EINTR) continue;
+            break;
+        }
+
+        for (int i = 0; i < count; ++i) {
+            const auto &event = events[static_cast<std::size_t>(i)];
+            const int   fd    = event.data.fd;
+            if (fd == stop_fd) return;
+
+            if (fd == listen_socket) {
+                accept_client();
+                continue;
+            }
+
+            auto client = std::find_if(clients.begin(), clients.end(), [fd](const Client &c) { return c.sock == fd; });
+            if (client == clients.end()) continue;
+
+            bool connected = true;
+            if (event.events & (EPOLLIN | EPOLLHUP | EPOLLERR)) connected = receive_requests(*client);
+            if (connected) connected = send_output(*client);
+            if (!connected) close_client(fd);
+        }
+    }
+}
+
+void Modbus_TCP_Gateway::accept_client() {
+    const int client = accept4(listen_socket, nullptr, nullptr, SOCK_CLOEXEC | SOCK_NONBLOCK);
+    if (client == -1) return;
+
+    if (clients.size() >= max_clients) {
+        close(client);
+        return;
+    }
+
+    // replies are sent completely by one system call, no need to wait for further data
+    int flag = 1;
+    setsockopt(client, IPPROTO_TCP, TCP_NODELAY, &flag, sizeof(flag));
+
+    epoll_event event {};
+    event.events  = EPOLLIN;
+    event.data.fd = client;
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, client, &event) == -1) {
+        close(client);
+        return;
+    }
+    clients.push_back({client, {}, {}, false});
+}
+
+bool Modbus_TCP_Gateway::receive_requests(Client &client) {
+    // one recv per event: further data is reported by the next epoll_wait (level triggered)
+    std::array<uint8_t, RECEIVE_BUFFER_SIZE> buffer {};
+    const auto                               received = recv(client.sock, buffer.data(), buffer.size(), 0);
+    if (received == 0) return false;
+    if (received == -1) return errno == EAGAIN || errno == EINTR;
+    client.input.insert(client.input.end(), buffer.begin(), buffer.begin() + received);
+
+    // complete requests
+    std::size_t offset = 0;
+    while (client.input.size() - offset >= MBAP_LENGTH_END) {
+        const uint8_t    *query  = client.input.data() + offset;
+        const std::size_t length = MBAP_LENGTH_END + static_cast<std::size_t>(query[4] << 8u | query[5]);
+
+        // protocol id 0, at least unit id and function code
+        if (query[2] != 0 || query[3] != 0 || length < MBAP_LENGTH_END + 2 || length > MODBUS_TCP_MAX_ADU_LENGTH)
+            return false;
+        if (client.input.size() - offset < length) break;
+
+        if (!handle_request(client, query, length)) return false;
+        offset += length;
+    }
+    client.input.erase(client.input.begin(), client.input.begin() + static_cast<std::ptrdiff_t>(offset));
+    return true;
+}
+
+bool Modbus_TCP_Gateway::handle_request(Client &client, const uint8_t *query, std::size_t length) {
+    {
+        std::lock_guard<std::mutex> lock(mapping_mutex);
+
+        // write requests are executed as output transaction
+        Images::Trailer *trailer = nullptr;
+        Writer         **writer  = nullptr;
+        switch (query[static_cast<std::size_t>(modbus_get_header_length(modbus))]) {
+            case MODBUS_FC_WRITE_SINGLE_COIL:
+            case MODBUS_FC_WRITE_MULTIPLE_COILS:
+                trailer = coils_trailer;
+                writer  = &coils_writer;
+                break;
+            case MODBUS_FC_WRITE_SINGLE_REGISTER:
+            case MODBUS_FC_WRITE_MULTIPLE_REGISTERS:
+            case MODBUS_FC_MASK_WRITE_REGISTER:
+            case MODBUS_FC_WRITE_AND_READ_REGISTERS:
+                trailer = registers_trailer;
+                writer  = &registers_writer;
+                break;
+            default: break;
+        }
+
+        // entry released by the coupler (transaction aborted) or not available when the images were set
+        if (writer && !*writer) *writer = attach(trailer);
+
+        // the reply is sent to the socket pair, so the lock is never held while waiting for a client
+        if (writer && *writer) WAGO_Modbus::Output_Transaction::begin(**writer);
+        const int result = modbus_reply(modbus, query, static_cast<int>(length), &mapping);
+        if (writer && *writer && !WAGO_Modbus::Output_Transaction::commit(**writer)) *writer = nullptr;
+        if (result == -1) return false;
+    }
+
+    std::array<uint8_t, MODBUS_TCP_MAX_ADU_LENGTH> reply {};
+    const auto reply_length = recv(reply_sockets[1], reply.data(), reply.size(), 0);
+    if (reply_length <= 0) return true;  // request not answered by libmodbus
+
+    client.output.insert(client.output.end(), reply.begin(), reply.begin() + reply_length);
+    return true;
+}
+
+bool Modbus_TCP_Gateway::send_output(Client &client) {
+    while (!client.output.empty()) {
+        const auto sent = send(client.sock, client.output.data(), client.output.size(), MSG_NOSIGNAL);
+        if (sent == -1) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN) break;
+            return false;
+        }
+        client.output.erase(client.output.begin(), client.output.begin() + sent);
+    }
+    if (client.output.size() > MAX_PENDING_OUTPUT) return false;
+
+    // wait for EPOLLOUT only while output is pending
+    const bool wait_writable = !client.output.empty();
+    if (wait_writable != client.wait_writable) {
+        epoll_event event {};
+        event.events  = wait_writable ? EPOLLIN | EPOLLOUT : EPOLLIN;
+        event.data.fd = client.sock;
+        if (epoll_ctl(epoll_fd, EPOLL_CTL_MOD, client.sock, &event) == -1) return false;
+        client.wait_writable = wait_writable;
+    }
+    return true;
+}
+
+void Modbus_TCP_Gateway::close_client(int client) {
+    epoll_ctl(epoll_fd, EPOLL_CTL_DEL, client, nullptr);
+    close(client);
+    clients.erase(std::find_if(clients.begin(), clients.end(), [client](const Client &c) { return c.sock == client; }));
+}
+
+Modbus_TCP_Gateway::Writer *Modbus_TCP_Gateway::attach(Images::Trailer *trailer) const noexcept {
+    return trailer ? WAGO_Modbus::Output_Transaction::attach(*trailer, writer_token) : nullptr;
+}
+
+void Modbus_TCP_Gateway::detach_writers() noexcept {
+    for (auto *writer : {&coils_writer, &registers_writer}) {
+        if (*writer) WAGO_Modbus::Output_Transaction::detach(**writer, writer_token);
+        *writer = nullptr;
+    }
+}
@@ -0,0 +1,170 @@
+/*
+ * Copyright (C) 2023 Nikolas Koesling <nikolas@koesling.info>.
+ * This program is free software. You can redistribute it and/or modify it under the terms of the MIT License.
+ */
+
+#pragma once
+
+#include "Output_Transaction.hpp"
+
+#include <array>
+#include <cstdint>
+#include <modbus/modbus.h>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief Modbus TCP server that serves the process data images to other Modbus clients
+ * @details
+ *      The server runs in its own thread and handles all clients with one epoll loop.
+ *      The client sockets are non-blocking: requests are assembled in a buffer per client and replies that can not be
+ *      sent immediately are kept in an output buffer per client, so a slow or stalled client never blocks the others.
+ *      Clients whose pending replies exceed MAX_PENDING_OUTPUT are disconnected.
+ *      Read requests are answered from the images. Write requests (coils, holding registers) are stored in the
+ *      output images and written to the coupler by the next cycle.
+ *      The images are used directly (one uint8_t per bit, registers in host byte order). All images start at address 0.
+ *      Write requests are executed as output transaction if the image has a trailer (see Output_Transaction),
+ *      so multi register writes are never sent partially. If all writer entries of a trailer are used, write requests
+ *      are executed without transaction.
+ */
+class Modbus_TCP_Gateway final {
+public:
+    /**
+     * @brief process data images served by the gateway
+     */
+    struct Images {
+        using Trailer = WAGO_Modbus::Output_Transaction::Trailer;
+
+        uint8_t    *coils                     = nullptr;  //*< digital outputs (read / write)
+        std::size_t coils_size                = 0;        //*< number of digital outputs
+        Trailer    *coils_trailer             = nullptr;  //*< transaction trailer of the coils (optional)
+        uint8_t    *discrete_inputs           = nullptr;  //*< digital inputs (read only)
+        std::size_t discrete_inputs_size      = 0;        //*< number of digital inputs
+        uint16_t   *holding_registers         = nullptr;  //*< analog outputs (read / write)
+        std::size_t holding_registers_size    = 0;        //*< number of analog outputs
+        Trailer    *holding_registers_trailer = nullptr;  //*< transaction trailer of the holding registers (optional)
+        uint16_t   *input_registers           = nullptr;  //*< analog inputs (read only)
+        std::size_t input_registers_size      = 0;        //*< number of analog inputs
+    };
+
+    static constexpr std::size_t MAX_PENDING_OUTPUT = 16 * MODBUS_TCP_MAX_ADU_LENGTH;  //*< unsent replies per client
+
+private:
+    using Writer = WAGO_Modbus::Output_Transaction::Writer;
+
+    /**
+     * @brief connection of a client
+     */
+    struct Client {
+        int                  sock;                   // socket of the connection (non-blocking)
+        std::vector<uint8_t> input;                  // received bytes of an incomplete request
+        std::vector<uint8_t> output;                 // reply bytes that could not be sent yet
+        bool                 wait_writable = false;  // EPOLLOUT is requested
+    };
+
+    modbus_t           *modbus            = nullptr;  // libmodbus context (server side)
+    int                 listen_socket     = -1;       // listening socket
+    int                 epoll_fd          = -1;       // epoll instance of all sockets
+    int                 stop_fd           = -1;       // eventfd that terminates the server thread
+    std::array<int, 2>  reply_sockets {-1, -1};       // datagram socket pair that captures the replies of libmodbus
+    std::size_t         max_clients;                  // maximum number of connected clients
+    std::vector<Client> clients;                      // connected clients (server thread only)
+    std::mutex          mapping_mutex;                // protects mapping and trailers
+    modbus_mapping_t    mapping {};                   // images as libmodbus mapping
+    Images::Trailer    *coils_trailer     = nullptr;  // transaction trailer of the coils
+    Images::Trailer    *registers_trailer = nullptr;  // transaction trailer of the holding registers
+    Writer             *coils_writer      = nullptr;  // transaction state of the gateway in the coils trailer
+    Writer             *registers_writer  = nullptr;  // transaction state of the gateway in the registers trailer
+    uint32_t            writer_token;                 // id of the gateway in the transaction trailers
+    std::thread         thread;                       // server thread
+
+public:
+    /**
+     * @brief create gateway and start the server thread
+     * @param host listen address
+     * @param service listen port or service
+     * @param images images to serve
+     * @param max_clients maximum number of connected clients (further connections are closed immediately)
+     *
+     * @exception std::runtime_error failed to create modbus instance
+     * @exception std::runtime_error failed to listen for modbus clients
+     * @exception std::system_error failed to create epoll instance / eventfd / socket pair
+     * @exception std::system_error failed to create server thread
+     */
+    Modbus_TCP_Gateway(const std::string &host,
+                       const std::string &service,
+                       const Images      &images,
+                       std::size_t        max_clients = 16);
+
+    /**
+     * @brief stop the server thread and close all connections
+     */
+    ~Modbus_TCP_Gateway();
+
+    Modbus_TCP_Gateway(const Modbus_TCP_Gateway &other)            = delete;
+    Modbus_TCP_Gateway(Modbus_TCP_Gateway &&other)                 = delete;
+    Modbus_TCP_Gateway &operator=(const Modbus_TCP_Gateway &other) = delete;
+    Modbus_TCP_Gateway &operator=(Modbus_TCP_Gateway &&other)      = delete;
+
+    /**
+     * @brief replace the served images
+     * @details
+     *      Waits until the reply of the current request is built. The old images are not accessed after this call
+     *      returns.
+     *      Use empty images while the images are recreated (requests are answered with an exception).
+     * @param images new images
+     */
+    void set_images(const Images &images);
+
+private:
+    /**
+     * @brief epoll loop of the server thread
+     */
+    void run();
+
+    /**
+     * @brief accept a new client connection
+     */
+    void accept_client();
+
+    /**
+     * @brief receive the available data of a client and handle the complete requests
+     * @return false if the connection was closed or the client sent an invalid request
+     */
+    bool receive_requests(Client &client);
+
+    /**
+     * @brief build the reply of one request and append it to the output buffer of the client
+     * @details only the reply is built while mapping_mutex is locked, it is sent afterwards (see send_output)
+     * @param client client of the request
+     * @param query request (MBAP header and PDU)
+     * @param length length of the request
+     * @return false if libmodbus failed to build the reply
+     */
+    bool handle_request(Client &client, const uint8_t *query, std::size_t length);
+
+    /**
+     * @brief send the output buffer of a client as far as possible without blocking
+     * @details waits for EPOLLOUT while data is pending
+     * @return false if the connection failed or the pending output exceeds MAX_PENDING_OUTPUT
+     */
+    bool send_output(Client &client);
+
+    /**
+     * @brief close a client connection
+     */
+    void close_client(int client);
+
+    /**
+     * @brief attach the gateway to a transaction trailer
+     * @return transaction state of the gateway (nullptr: no trailer or all writer entries used)
+     */
+    [[nodiscard]] Writer *attach(Images::Trailer *trailer) const noexcept;
+
+    /**
+     * @brief detach the gateway from both transaction trailers (mapping_mutex must be locked)
+     */
+    void detach_writers() noexcept;
+};
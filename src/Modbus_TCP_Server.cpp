@@ -5,6 +5,7 @@
 #include "Modbus_TCP_Server.hpp"
 
 #include <stdexcept>
+#include <system_error>
 
 Modbus_TCP_Server::Modbus_TCP_Server(const std::string &host, const std::string &service, bool debug) {
     ctx = modbus_new_tcp_pi(host.c_str(), service.c_str());
@@ -25,6 +26,13 @@ void Modbus_TCP_Server::connect() {
     if (ctx == nullptr) throw std::runtime_error("no valid modbus context");
     if (connected) throw std::logic_error("already connected to modbus client");
 
+    auto set_timeout = [this](int (*function)(modbus_t *, uint32_t, uint32_t), std::chrono::milliseconds timeout) {
+        const auto usec = std::chrono::duration_cast<std::chrono::microseconds>(timeout).count();
+        function(ctx, static_cast<uint32_t>(usec / 1000000), static_cast<uint32_t>(usec % 1000000));
+    };
+    set_timeout(modbus_set_response_timeout, socket_options.response_timeout);
+    set_timeout(modbus_set_byte_timeout, socket_options.byte_timeout);
+
     auto tmp = modbus_connect(ctx);
     if (tmp == -1) {
         const std::string error_msg = modbus_strerror(errno);
@@ -32,6 +40,17 @@ void Modbus_TCP_Server::connect() {
     }
 
     connected = true;
+
+    try {
+        apply_socket_options();
+    } catch (const std::system_error &) {
+        disconnect();
+        throw;
+    }
+}
+
+int Modbus_TCP_Server::get_socket() const noexcept {
+    return connected ? modbus_get_socket(ctx) : -1;
 }
 
 void Modbus_TCP_Server::disconnect() {
@@ -173,18 +192,16 @@ std::vector<std::vector<uint16_t>>
 
     check_read_regs(registers);
 
-    std::vector<std::vector<uint16_t>> result;
-    for (const auto &reg : registers) {
-        auto &data = result.emplace_back(reg.second);
-
-        int tmp = modbus_read_input_registers(ctx, reg.first, static_cast<int>(reg.second), data.data());
-        if (tmp == -1) {
-            const std::string error_msg = modbus_strerror(errno);
-            throw std::runtime_error("failed to read from modbus client: " + error_msg);
+    return read_ranges(registers, Function::READ_INPUT_REGISTERS, [this](const std::vector<Request> &requests) {
+        for (const auto &request : requests) {
+            int tmp = modbus_read_input_registers(
+                    ctx, request.addr, static_cast<int>(request.size), static_cast<uint16_t *>(request.data));
+            if (tmp == -1) {
+                const std::string error_msg = modbus_strerror(errno);
+                throw std::runtime_error("failed to read from modbus client: " + error_msg);
+            }
         }
-    }
-
-    return result;
+    });
 }
 
 std::vector<std::vector<uint16_t>>
@@ -193,18 +210,16 @@ std::vector<std::vector<uint16_t>>
 
     check_read_regs(registers);
 
-    std::vector<std::vector<uint16_t>> result;
-    for (auto &reg : registers) {
-        auto &data = result.emplace_back(reg.second);
-
-        int tmp = modbus_read_registers(ctx, reg.first, static_cast<int>(reg.second), data.data());
-        if (tmp == -1) {
-            const std::string error_msg = modbus_strerror(errno);
-            throw std::runtime_error("failed to read from modbus client: " + error_msg);
+    return read_ranges(registers, Function::READ_HOLDING_REGISTERS, [this](const std::vector<Request> &requests) {
+        for (const auto &request : requests) {
+            int tmp = modbus_read_registers(
+                    ctx, request.addr, static_cast<int>(request.size), static_cast<uint16_t *>(request.data));
+            if (tmp == -1) {
+                const std::string error_msg = modbus_strerror(errno);
+                throw std::runtime_error("failed to read from modbus client: " + error_msg);
+            }
         }
-    }
-
-    return result;
+    });
 }
 
 void Modbus_TCP_Server::write_do(uint16_t addr, uint8_t value) {
@@ -326,6 +341,8 @@ void Modbus_TCP_Server::read_di(uint8_t *result, uint16_t addr, std::size_t size
         const std::string error_msg = modbus_strerror(errno);
         throw std::runtime_error("failed to read from modbus client: " + error_msg);
     }
+
+    rearm_quick_ack();
 }
 
 void Modbus_TCP_Server::read_do(uint8_t *result, uint16_t addr, std::size_t size) {
@@ -337,6 +354,8 @@ void Modbus_TCP_Server::read_do(uint8_t *result, uint16_t addr, std::size_t size
         const std::string error_msg = modbus_strerror(errno);
         throw std::runtime_error("failed to read from modbus client: " + error_msg);
     }
+
+    rearm_quick_ack();
 }
 
 void Modbus_TCP_Server::read_ai(uint16_t *result, uint16_t addr, std::size_t size) {
@@ -348,6 +367,8 @@ void Modbus_TCP_Server::read_ai(uint16_t *result, uint16_t addr, std::size_t siz
         const std::string error_msg = modbus_strerror(errno);
         throw std::runtime_error("failed to read from modbus client: " + error_msg);
     }
+
+    rearm_quick_ack();
 }
 
 void Modbus_TCP_Server::read_ao(uint16_t *result, uint16_t addr, std::size_t size) {
@@ -359,6 +380,8 @@ void Modbus_TCP_Server::read_ao(uint16_t *result, uint16_t addr, std::size_t siz
         const std::string error_msg = modbus_strerror(errno);
         throw std::runtime_error("failed to read from modbus client: " + error_msg);
     }
+
+    rearm_quick_ack();
 }
 
 void Modbus_TCP_Server::write_do(const uint8_t *data, uint16_t addr, std::size_t size) {
@@ -370,6 +393,8 @@ void Modbus_TCP_Server::write_do(const uint8_t *data, uint16_t addr, std::size_t
         const std::string error_msg = modbus_strerror(errno);
         throw std::runtime_error("failed to write to modbus client: " + error_msg);
     }
+
+    rearm_quick_ack();
 }
 
 void Modbus_TCP_Server::write_ao(const uint16_t *data, uint16_t addr, std::size_t size) {
@@ -381,4 +406,6 @@ void Modbus_TCP_Server::write_ao(const uint16_t *data, uint16_t addr, std::size_
         const std::string error_msg = modbus_strerror(errno);
         throw std::runtime_error("failed to write to modbus client: " + error_msg);
     }
+
+    rearm_quick_ack();
 }
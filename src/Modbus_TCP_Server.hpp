@@ -4,6 +4,8 @@
 
 #pragma once
 
+#include "Modbus_Transport.hpp"
+
 #include <cstdint>
 #include <modbus/modbus.h>
 #include <string>
@@ -12,8 +14,9 @@
 
 /**
  * @brief Modbus TCP Server
+ * @details libmodbus based implementation of Modbus_Transport
  */
-class Modbus_TCP_Server final {
+class Modbus_TCP_Server final : public Modbus_Transport {
 private:
     modbus_t *ctx;                // modbus context
     bool      connected = false;  // connection indicator
@@ -32,23 +35,27 @@ public:
     /**
      * @brief Destroy Modbus TCP Server object
      */
-    ~Modbus_TCP_Server();
+    ~Modbus_TCP_Server() override;
 
     /**
      * @brief connect to Modbus TCP client
+     * @details applies the socket options and the timeouts (see set_socket_options)
      *
      * @exception std::logic_error already connected to modbus client
      * @exception std::runtime_error failed to connect to modbus client
      * @exception std::runtime_error no valid modbus context (should never happen --> fatal error)
+     * @exception std::system_error failed to set a socket option
      */
-    void connect();
+    void connect() override;
 
     /**
      * @brief disconnect from Modbus TCP client
      *
      * @exception std::logic_error not connected to modbus client
      */
-    void disconnect();
+    void disconnect() override;
+
+    [[nodiscard]] int get_socket() const noexcept override;
 
     /**
      * @brief read one digital input
@@ -124,7 +131,7 @@ public:
      * @exception std::out_of_range resulting address out of range
      */
     [[nodiscard]] std::vector<std::vector<uint16_t>>
-            read_ai(const std::vector<std::pair<std::uint16_t, std::size_t>> &registers) const;
+            read_ai(const std::vector<std::pair<std::uint16_t, std::size_t>> &registers) const override;
 
     /**
      * @brief read multiple analog outputs
@@ -136,7 +143,7 @@ public:
      * @exception std::out_of_range resulting address out of range
      */
     [[nodiscard]] std::vector<std::vector<uint16_t>>
-            read_ao(const std::vector<std::pair<std::uint16_t, std::size_t>> &registers) const;
+            read_ao(const std::vector<std::pair<std::uint16_t, std::size_t>> &registers) const override;
 
     /**
      * @brief write one digital output
@@ -156,7 +163,7 @@ public:
      * @exception std::logic_error not connected to modbus client
      * @exception std::runtime_error failed to write to modbus client
      */
-    void write_ao(uint16_t addr, uint16_t value);
+    void write_ao(uint16_t addr, uint16_t value) override;
 
     /**
      * @brief write digital outputs
@@ -199,7 +206,7 @@ public:
      * @exception std::runtime_error failed to read from modbus client
      * @exception std::out_of_range resulting address out of range
      */
-    void read_di(uint8_t [[gcc::nonnull]] * result, uint16_t addr, std::size_t size);
+    void read_di(uint8_t [[gcc::nonnull]] * result, uint16_t addr, std::size_t size) override;
 
     /**
      * @brief read digital outputs
@@ -212,7 +219,7 @@ public:
      * @exception std::runtime_error failed to read from modbus client
      * @exception std::out_of_range resulting address out of range
      */
-    void read_do(uint8_t [[gcc::nonnull]] * result, uint16_t addr, std::size_t size);
+    void read_do(uint8_t [[gcc::nonnull]] * result, uint16_t addr, std::size_t size) override;
 
     /**
      * @brief read analog inputs
@@ -225,7 +232,7 @@ public:
      * @exception std::runtime_error failed to read from modbus client
      * @exception std::out_of_range resulting address out of range
      */
-    void read_ai(uint16_t [[gcc::nonnull]] * result, uint16_t addr, std::size_t size);
+    void read_ai(uint16_t [[gcc::nonnull]] * result, uint16_t addr, std::size_t size) override;
 
     /**
      * @brief read analog outputs
@@ -238,7 +245,7 @@ public:
      * @exception std::runtime_error failed to read from modbus client
      * @exception std::out_of_range resulting address out of range
      */
-    void read_ao(uint16_t [[gcc::nonnull]] * result, uint16_t addr, std::size_t size);
+    void read_ao(uint16_t [[gcc::nonnull]] * result, uint16_t addr, std::size_t size) override;
 
     /**
      * @brief write digital outputs
@@ -250,7 +257,7 @@ public:
      * @exception std::runtime_error failed to write to modbus client
      * @exception std::out_of_range resulting address out of range
      */
-    void write_do(const uint8_t [[gcc::nonnull]] * data, uint16_t addr, std::size_t size);
+    void write_do(const uint8_t [[gcc::nonnull]] * data, uint16_t addr, std::size_t size) override;
 
     /**
      * @brief write analog outputs
@@ -262,7 +269,7 @@ public:
      * @exception std::runtime_error failed to write to modbus client
      * @exception std::out_of_range resulting address out of range
      */
-    void write_ao(const uint16_t [[gcc::nonnull]] * data, uint16_t addr, std::size_t size);
+    void write_ao(const uint16_t [[gcc::nonnull]] * data, uint16_t addr, std::size_t size) override;
 
     /**
      * @brief write and read analog outputs
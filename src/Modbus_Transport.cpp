@@ -0,0 +1,153 @@
+/*
+ * Copyright (C) 2023 Nikolas Koesling <nikolas@koesling.info>.
+ * This program is free software. You can redistribute it and/or modify it under the terms of the MIT License.
+ */
+
+#include "Modbus_Transport.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <numeric>
+#include <stdexcept>
+#include <sys/socket.h>
+#include <system_error>
+
+std::size_t Modbus_Transport::prepare(const std::vector<Request> &requests) {
+    for (const auto &request : requests) {
+        if (request.addr + request.size > UINT16_MAX) throw std::out_of_range("resulting address out of range");
+    }
+
+    prepared.emplace_back(requests);
+    return prepared.size() - 1;
+}
+
+void Modbus_Transport::execute(std::size_t handle) {
+    for (const auto &request : prepared.at(handle)) {
+        switch (request.function) {
+            case Function::READ_COILS:
+                read_do(static_cast<uint8_t *>(request.data), request.addr, request.size);
+                break;
+            case Function::READ_DISCRETE_INPUTS:
+                read_di(static_cast<uint8_t *>(request.data), request.addr, request.size);
+                break;
+            case Function::READ_HOLDING_REGISTERS:
+                read_ao(static_cast<uint16_t *>(request.data), request.addr, request.size);
+                break;
+            case Function::READ_INPUT_REGISTERS:
+                read_ai(static_cast<uint16_t *>(request.data), request.addr, request.size);
+                break;
+            case Function::WRITE_MULTIPLE_COILS:
+                write_do(static_cast<const uint8_t *>(request.data), request.addr, request.size);
+                break;
+            case Function::WRITE_MULTIPLE_REGISTERS:
+                write_ao(static_cast<const uint16_t *>(request.data), request.addr, request.size);
+                break;
+            default: throw std::invalid_argument("unsupported modbus function");
+        }
+    }
+}
+
+void Modbus_Transport::clear_prepared() {
+    prepared.clear();
+}
+
+void Modbus_Transport::set_socket_options(const Socket_Options &options) {
+    socket_options = options;
+    if (get_socket() != -1) apply_socket_options();
+}
+
+void Modbus_Transport::apply_socket_options() const {
+    const int sock = get_socket();
+
+    auto set = [sock](int level, int name, int value, const char *what) {
+        if (setsockopt(sock, level, name, &value, sizeof(value)) == -1)
+            throw std::system_error(errno, std::generic_category(), what);
+    };
+
+    set(IPPROTO_TCP, TCP_NODELAY, 1, "setsockopt TCP_NODELAY");
+    if (socket_options.quick_ack) set(IPPROTO_TCP, TCP_QUICKACK, 1, "setsockopt TCP_QUICKACK");
+    if (socket_options.busy_poll > 0)
+        set(SOL_SOCKET, SO_BUSY_POLL, socket_options.busy_poll, "setsockopt SO_BUSY_POLL");
+
+    if (socket_options.tos >= 0) {
+        sockaddr_storage address {};
+        socklen_t        length = sizeof(address);
+        if (getsockname(sock, reinterpret_cast<sockaddr *>(&address), &length) == -1)
+            throw std::system_error(errno, std::generic_category(), "getsockname");
+
+        if (address.ss_family == AF_INET6) set(IPPROTO_IPV6, IPV6_TCLASS, socket_options.tos, "setsockopt IPV6_TCLASS");
+        else set(IPPROTO_IP, IP_TOS, socket_options.tos, "setsockopt IP_TOS");
+    }
+
+    // after IP_TOS, which also sets the priority
+    if (socket_options.priority >= 0) set(SOL_SOCKET, SO_PRIORITY, socket_options.priority, "setsockopt SO_PRIORITY");
+}
+
+void Modbus_Transport::rearm_quick_ack() const noexcept {
+    if (!socket_options.quick_ack) return;
+    const int flag = 1;
+    setsockopt(get_socket(), IPPROTO_TCP, TCP_QUICKACK, &flag, sizeof(flag));
+}
+
+std::vector<std::vector<uint16_t>>
+        Modbus_Transport::read_ranges(const std::vector<std::pair<std::uint16_t, std::size_t>> &registers,
+                                      Function                                                  function,
+                                      const std::function<void(const std::vector<Request> &)>  &execute_requests) {
+    for (const auto &reg : registers) {
+        if (reg.first + reg.second > UINT16_MAX) throw std::out_of_range("resulting address out of range");
+    }
+
+    // merge overlapping and adjacent ranges (in address order)
+    struct Span {
+        std::size_t begin;   // first address
+        std::size_t end;     // last address + 1
+        std::size_t offset;  // index of the first value in the buffer
+    };
+
+    std::vector<std::size_t> order(registers.size());
+    std::iota(order.begin(), order.end(), static_cast<std::size_t>(0));
+    std::sort(order.begin(), order.end(), [&registers](std::size_t a, std::size_t b) {
+        return registers[a].first < registers[b].first;
+    });
+
+    std::vector<Span>        spans;
+    std::vector<std::size_t> span_index(registers.size());
+    for (auto i : order) {
+        const std::size_t begin = registers[i].first;
+        const std::size_t end   = begin + registers[i].second;
+        if (spans.empty() || begin > spans.back().end) spans.push_back({begin, end, 0});
+        else spans.back().end = std::max(spans.back().end, end);
+        span_index[i] = spans.size() - 1;
+    }
+
+    std::size_t buffer_size = 0;
+    for (auto &span : spans) {
+        span.offset = buffer_size;
+        buffer_size += span.end - span.begin;
+    }
+    std::vector<uint16_t> buffer(buffer_size);
+
+    // split at the PDU limit
+    const std::size_t    limit = max_request_size(function);
+    std::vector<Request> requests;
+    for (const auto &span : spans) {
+        for (std::size_t addr = span.begin; addr < span.end; addr += limit) {
+            requests.push_back({function,
+                                static_cast<uint16_t>(addr),
+                                std::min(limit, span.end - addr),
+                                buffer.data() + span.offset + (addr - span.begin)});
+        }
+    }
+    if (!requests.empty()) execute_requests(requests);
+
+    std::vector<std::vector<uint16_t>> result;
+    result.reserve(registers.size());
+    for (std::size_t i = 0; i < registers.size(); ++i) {
+        const auto &span  = spans[span_index[i]];
+        const auto  first = buffer.begin() + static_cast<std::ptrdiff_t>(span.offset + registers[i].first - span.begin);
+        result.emplace_back(first, first + static_cast<std::ptrdiff_t>(registers[i].second));
+    }
+    return result;
+}
@@ -0,0 +1,324 @@
+/*
+ * Copyright (C) 2023 Nikolas Koesling <nikolas@koesling.info>.
+ * This program is free software. You can redistribute it and/or modify it under the terms of the MIT License.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief interface for the transfer of process data between TCP_Coupler_SHM and a Modbus device
+ */
+class Modbus_Transport {
+public:
+    /**
+     * @brief Modbus function codes used for the process data transfer
+     */
+    enum class Function : uint8_t {
+        READ_COILS               = 0x01,
+        READ_DISCRETE_INPUTS     = 0x02,
+        READ_HOLDING_REGISTERS   = 0x03,
+        READ_INPUT_REGISTERS     = 0x04,
+        WRITE_MULTIPLE_COILS     = 0x0F,
+        WRITE_MULTIPLE_REGISTERS = 0x10,
+    };
+
+    /**
+     * @brief one request of a prepared transfer
+     * @details
+     *      data points to the memory the values are read to (read functions) or written from (write functions).
+     *      Bits are stored as one uint8_t per bit, registers as uint16_t in host byte order.
+     *      The memory must stay valid as long as the transfer is prepared.
+     */
+    struct Request {
+        Function    function;  //*< modbus function code
+        uint16_t    addr;      //*< start address
+        std::size_t size;      //*< number of bits or registers
+        void       *data;      //*< source or destination of the values
+    };
+
+    /**
+     * @brief latency statistics of the transfers (see get_latency)
+     * @details
+     *      The wire time of a transfer is the time between the kernel timestamps of sending the requests and
+     *      receiving the last response, i.e. the time spent in the network and the device.
+     *      The overhead is the remaining time of the transfer (system calls, encoding and decoding).
+     *      Averages are exponentially weighted (1/8).
+     */
+    struct Latency {
+        uint64_t                 samples = 0;  //*< number of transfers with kernel timestamps
+        uint64_t                 missing = 0;  //*< number of transfers without kernel timestamps
+        std::chrono::nanoseconds wire {};      //*< average wire time
+        std::chrono::nanoseconds wire_max {};  //*< maximum wire time
+        std::chrono::nanoseconds overhead {};  //*< average overhead
+    };
+
+    /**
+     * @brief tuning of the socket of the modbus connection (see set_socket_options)
+     * @details TCP_NODELAY is always set: each request is sent completely.
+     */
+    struct Socket_Options {
+        bool                      quick_ack = false;  //*< re-arm TCP_QUICKACK after each response (no delayed ACKs)
+        int                       busy_poll = 0;      //*< SO_BUSY_POLL in µs (0: not set)
+        int                       priority  = -1;     //*< SO_PRIORITY (-1: not set)
+        int                       tos       = -1;     //*< IP_TOS / IPV6_TCLASS, e.g. DSCP << 2 (-1: not set)
+        std::chrono::milliseconds response_timeout {500};  //*< timeout of a response
+        std::chrono::milliseconds byte_timeout {500};      //*< timeout between the bytes of a response (libmodbus)
+    };
+
+    static constexpr std::size_t MAX_READ_BITS       = 2000;  //*< maximum number of bits in one read request
+    static constexpr std::size_t MAX_WRITE_BITS      = 1968;  //*< maximum number of bits in one write request
+    static constexpr std::size_t MAX_READ_REGISTERS  = 125;   //*< maximum number of registers in one read request
+    static constexpr std::size_t MAX_WRITE_REGISTERS = 123;   //*< maximum number of registers in one write request
+
+    /**
+     * @brief maximum number of values in one request (limited by the size of a modbus PDU)
+     * @param function modbus function code
+     */
+    static constexpr std::size_t max_request_size(Function function) noexcept {
+        switch (function) {
+            case Function::READ_COILS:
+            case Function::READ_DISCRETE_INPUTS: return MAX_READ_BITS;
+            case Function::READ_HOLDING_REGISTERS:
+            case Function::READ_INPUT_REGISTERS: return MAX_READ_REGISTERS;
+            case Function::WRITE_MULTIPLE_COILS: return MAX_WRITE_BITS;
+            case Function::WRITE_MULTIPLE_REGISTERS: return MAX_WRITE_REGISTERS;
+            default: return 0;
+        }
+    }
+
+private:
+    std::vector<std::vector<Request>> prepared;  // prepared transfers (default implementation)
+
+protected:
+    Socket_Options socket_options;  //*< socket options (applied by connect, see apply_socket_options)
+
+public:
+    Modbus_Transport()                                         = default;
+    virtual ~Modbus_Transport()                                = default;
+    Modbus_Transport(const Modbus_Transport &other)            = delete;
+    Modbus_Transport(Modbus_Transport &&other)                 = delete;
+    Modbus_Transport &operator=(const Modbus_Transport &other) = delete;
+    Modbus_Transport &operator=(Modbus_Transport &&other)      = delete;
+
+    /**
+     * @brief connect to Modbus device
+     *
+     * @exception std::logic_error already connected to modbus client
+     * @exception std::runtime_error failed to connect to modbus client
+     */
+    virtual void connect() = 0;
+
+    /**
+     * @brief disconnect from Modbus device
+     *
+     * @exception std::logic_error not connected to modbus client
+     */
+    virtual void disconnect() = 0;
+
+    /**
+     * @brief read multiple analog inputs
+     * @details overlapping and adjacent ranges are read by one request (see read_ranges)
+     * @param registers vector of pairs. Each pair represents an address range {start_address, size}
+     * @return two dimensional vector that contains the requested values
+     *
+     * @exception std::logic_error not connected to modbus client
+     * @exception std::runtime_error failed to read from modbus client
+     * @exception std::out_of_range resulting address out of range
+     */
+    [[nodiscard]] virtual std::vector<std::vector<uint16_t>>
+            read_ai(const std::vector<std::pair<std::uint16_t, std::size_t>> &registers) const = 0;
+
+    /**
+     * @brief read multiple analog outputs
+     * @details overlapping and adjacent ranges are read by one request (see read_ranges)
+     * @param registers vector of pairs. Each pair represents an address range {start_address, size}
+     * @return two dimensional vector that contains the requested values
+     *
+     * @exception std::logic_error not connected to modbus client
+     * @exception std::runtime_error failed to read from modbus client
+     * @exception std::out_of_range resulting address out of range
+     */
+    [[nodiscard]] virtual std::vector<std::vector<uint16_t>>
+            read_ao(const std::vector<std::pair<std::uint16_t, std::size_t>> &registers) const = 0;
+
+    /**
+     * @brief write one analog output
+     * @param addr address of output
+     * @param value value to write
+     *
+     * @exception std::logic_error not connected to modbus client
+     * @exception std::runtime_error failed to write to modbus client
+     */
+    virtual void write_ao(uint16_t addr, uint16_t value) = 0;
+
+    /**
+     * @brief read digital inputs
+     * @param result array where the read values are stored (not nullptr!)
+     * @param addr start address of inputs
+     * @param size number of registers to read
+     *
+     * @exception std::logic_error not connected to modbus client
+     * @exception std::runtime_error failed to read from modbus client
+     * @exception std::out_of_range resulting address out of range
+     */
+    virtual void read_di(uint8_t *result, uint16_t addr, std::size_t size) = 0;
+
+    /**
+     * @brief read digital outputs
+     * @param result array where the read values are stored (not nullptr!)
+     * @param addr start address of outputs
+     * @param size number of registers to read
+     *
+     * @exception std::logic_error not connected to modbus client
+     * @exception std::runtime_error failed to read from modbus client
+     * @exception std::out_of_range resulting address out of range
+     */
+    virtual void read_do(uint8_t *result, uint16_t addr, std::size_t size) = 0;
+
+    /**
+     * @brief read analog inputs
+     * @param result array where the read values are stored (not nullptr!)
+     * @param addr start address of inputs
+     * @param size number of registers to read
+     *
+     * @exception std::logic_error not connected to modbus client
+     * @exception std::runtime_error failed to read from modbus client
+     * @exception std::out_of_range resulting address out of range
+     */
+    virtual void read_ai(uint16_t *result, uint16_t addr, std::size_t size) = 0;
+
+    /**
+     * @brief read analog outputs
+     * @param result array where the read values are stored (not nullptr!)
+     * @param addr start address of outputs
+     * @param size number of registers to read
+     *
+     * @exception std::logic_error not connected to modbus client
+     * @exception std::runtime_error failed to read from modbus client
+     * @exception std::out_of_range resulting address out of range
+     */
+    virtual void read_ao(uint16_t *result, uint16_t addr, std::size_t size) = 0;
+
+    /**
+     * @brief write digital outputs
+     * @param data pointer to array of values to write (must contain at least <size> values) (not nullptr!)
+     * @param addr address of output
+     * @param size number of registers to write
+     *
+     * @exception std::logic_error not connected to modbus client
+     * @exception std::runtime_error failed to write to modbus client
+     * @exception std::out_of_range resulting address out of range
+     */
+    virtual void write_do(const uint8_t *data, uint16_t addr, std::size_t size) = 0;
+
+    /**
+     * @brief write analog outputs
+     * @param data pointer to array of values to write (must contain at least <size> values) (not nullptr!)
+     * @param addr address of output
+     * @param size number of registers to write
+     *
+     * @exception std::logic_error not connected to modbus client
+     * @exception std::runtime_error failed to write to modbus client
+     * @exception std::out_of_range resulting address out of range
+     */
+    virtual void write_ao(const uint16_t *data, uint16_t addr, std::size_t size) = 0;
+
+    /**
+     * @brief prepare a transfer that is executed repeatedly
+     * @details
+     *      The default implementation stores the requests and executes them one by one.
+     *      Implementations may precompute everything that does not change between executions.
+     * @param requests list of requests. Executed in the given order.
+     * @return handle of the prepared transfer (argument of execute)
+     *
+     * @exception std::out_of_range resulting address out of range
+     * @exception std::out_of_range too many values in one request
+     */
+    virtual std::size_t prepare(const std::vector<Request> &requests);
+
+    /**
+     * @brief execute a prepared transfer
+     * @param handle handle of the prepared transfer (return value of prepare)
+     *
+     * @exception std::out_of_range invalid handle
+     * @exception std::invalid_argument unsupported function in the transfer
+     * @exception std::logic_error not connected to modbus client
+     * @exception std::runtime_error failed to read from / write to modbus client
+     */
+    virtual void execute(std::size_t handle);
+
+    /**
+     * @brief discard all prepared transfers
+     * @details all previously returned handles become invalid
+     */
+    virtual void clear_prepared();
+
+    /**
+     * @brief get the latency statistics of the transfers
+     * @details The default implementation does not measure the latency.
+     * @return latency statistics or nullptr if the latency is not measured
+     */
+    [[nodiscard]] virtual const Latency *get_latency() const noexcept { return nullptr; }
+
+    /**
+     * @brief get the socket of the modbus connection
+     * @details The default implementation does not use a socket.
+     * @return socket or -1 if not connected or not socket based
+     */
+    [[nodiscard]] virtual int get_socket() const noexcept { return -1; }
+
+    /**
+     * @brief set the tuning of the modbus socket
+     * @details
+     *      The options are applied by connect. If already connected, all options except the timeouts are applied
+     *      immediately. Transports without socket ignore the options.
+     * @param options socket options
+     *
+     * @exception std::system_error failed to set a socket option (e.g. SO_BUSY_POLL without CAP_NET_ADMIN)
+     */
+    void set_socket_options(const Socket_Options &options);
+
+    /**
+     * @brief get the tuning of the modbus socket
+     */
+    [[nodiscard]] inline const Socket_Options &get_socket_options() const noexcept { return socket_options; }
+
+protected:
+    /**
+     * @brief apply the socket options to the socket of the connection (see get_socket)
+     * @details called by connect. The timeouts are applied by the implementations.
+     *
+     * @exception std::system_error failed to set a socket option
+     */
+    void apply_socket_options() const;
+
+    /**
+     * @brief re-arm TCP_QUICKACK (if enabled)
+     * @details The kernel leaves the quick ACK mode on its own, so it is re-armed after each response.
+     */
+    void rearm_quick_ack() const noexcept;
+
+    /**
+     * @brief read multiple register ranges with the minimum number of requests
+     * @details
+     *      Overlapping and adjacent ranges are merged. The merged ranges are split at the PDU limit of the function.
+     *      All resulting requests are passed to execute_requests at once, so they can be pipelined.
+     *      Only registers that are part of the requested ranges are read.
+     * @param registers vector of pairs. Each pair represents an address range {start_address, size}
+     * @param function READ_INPUT_REGISTERS or READ_HOLDING_REGISTERS
+     * @param execute_requests executes the given requests (in any order)
+     * @return two dimensional vector that contains the requested values
+     *
+     * @exception std::out_of_range resulting address out of range
+     */
+    static std::vector<std::vector<uint16_t>>
+            read_ranges(const std::vector<std::pair<std::uint16_t, std::size_t>> &registers,
+                        Function                                                  function,
+                        const std::function<void(const std::vector<Request> &)>  &execute_requests);
+};
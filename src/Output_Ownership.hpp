@@ -0,0 +1,173 @@
+/*
+ * Copyright (C) 2023 Nikolas Koesling <nikolas@koesling.info>.
+ * This program is free software. You can redistribute it and/or modify it under the terms of the MIT License.
+ */
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+namespace WAGO_Modbus {
+
+/**
+ * @brief layout of the output ownership shared memory (<prefix>OWNERS)
+ * @details
+ *      Coordinates multiple processes that write outputs. A writer claims the modules it writes and stages their
+ *      output values in this shared memory instead of writing the DO / AO images directly.
+ *      send_image copies the staged values of each owned module into the images, so writers of different modules
+ *      never interfere and multi register values are never torn.
+ *
+ *      The shared memory consists of a Header, Header::clamp_count Slot structures (index: module position,
+ *      0: first module after the coupler), the staged AO values (uint16_t, Header::ao_size) and the staged DO values
+ *      (uint8_t, Header::do_size). The staged values have the same layout as the images (see Slot offsets).
+ *      All values are stored in host byte order.
+ *
+ *      A slot is owned by the writer whose id (e.g. process id) is stored in Slot::owner (0: not owned).
+ *      The staged values of a slot are protected by a sequence lock (Slot::sequence is odd while they are written).
+ *      Outputs of modules that are not owned can still be written directly to the images.
+ *      Claims and writes that are rejected because the module is owned by another writer are counted in
+ *      Header::conflicts (published as Coupler_Status::Status::output_conflicts).
+ *
+ *      Ownership is a lease: claim, write and renew increment Slot::heartbeat. The coupler checks the heartbeats once
+ *      per diagnostics interval and releases modules whose heartbeat did not change for LEASE_INTERVALS checks, so
+ *      modules of terminated writers are released without relying on process ids (PID namespaces, recycled PIDs).
+ *      Writers that do not write at least once per diagnostics interval call renew.
+ *      The shared memory is recreated if the layout changes (see Coupler_Status::Status::layout_generation).
+ *
+ *      Use claim, write and release to access the shared memory.
+ */
+namespace Output_Ownership {
+static constexpr std::array<char, 8> MAGIC   = {'W', 'A', 'G', 'O', 'O', 'W', 'N', '\0'};
+static constexpr uint32_t            VERSION = 2;
+
+static constexpr std::size_t LEASE_INTERVALS = 3;  //*< diagnostics intervals without heartbeat until release
+
+struct Header {
+    std::array<char, 8>   magic;        //*< MAGIC
+    uint32_t              version;      //*< VERSION
+    uint32_t              clamp_count;  //*< number of slots
+    uint64_t              ao_size;      //*< number of staged AO values
+    uint64_t              do_size;      //*< number of staged DO values
+    std::atomic<uint64_t> conflicts;    //*< number of rejected claims and writes
+};
+
+struct Slot {
+    std::atomic<uint32_t> owner;      //*< id of the owning writer (0: not owned)
+    std::atomic<uint32_t> sequence;   //*< sequence lock of the staged values (odd: write in progress)
+    uint16_t              ao_offset;  //*< index of the first AO value of the module
+    uint16_t              ao_size;    //*< number of AO values of the module
+    uint16_t              do_offset;  //*< index of the first DO value of the module
+    uint16_t              do_size;    //*< number of DO values of the module
+    std::atomic<uint32_t> heartbeat;  //*< incremented by claim, write and renew of the owner
+    uint32_t              reserved;   //*< reserved (0)
+};
+
+static_assert(std::is_standard_layout_v<Header>);
+static_assert(std::is_standard_layout_v<Slot>);
+static_assert(sizeof(Header) == 40, "unexpected output ownership header size");
+static_assert(sizeof(Slot) == 24, "unexpected output ownership slot size");
+static_assert(std::atomic<uint32_t>::is_always_lock_free && std::atomic<uint64_t>::is_always_lock_free,
+              "output ownership requires lock free atomics");
+
+/**
+ * @brief size of the output ownership shared memory
+ * @param clamp_count number of modules
+ * @param ao_size number of AO values
+ * @param do_size number of DO values
+ */
+constexpr std::size_t size(std::size_t clamp_count, std::size_t ao_size, std::size_t do_size) {
+    return sizeof(Header) + clamp_count * sizeof(Slot) + ao_size * sizeof(uint16_t) + do_size * sizeof(uint8_t);
+}
+
+inline Slot *slots(Header &header) noexcept {
+    return reinterpret_cast<Slot *>(reinterpret_cast<uint8_t *>(&header) + sizeof(Header));
+}
+
+inline uint16_t *staged_ao(Header &header) noexcept {
+    return reinterpret_cast<uint16_t *>(slots(header) + header.clamp_count);
+}
+
+inline uint8_t *staged_do(Header &header) noexcept {
+    return reinterpret_cast<uint8_t *>(staged_ao(header) + header.ao_size);
+}
+
+/**
+ * @brief claim the outputs of a module
+ * @param header output ownership shared memory
+ * @param clamp module index
+ * @param id id of the writer (e.g. process id, must not be 0)
+ * @return true if the module is owned by the writer
+ */
+inline bool claim(Header &header, std::size_t clamp, uint32_t id) noexcept {
+    uint32_t expected = 0;
+    auto    &slot     = slots(header)[clamp];
+    if (slot.owner.compare_exchange_strong(expected, id, std::memory_order_acq_rel) || expected == id) {
+        slot.heartbeat.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+    header.conflicts.fetch_add(1, std::memory_order_relaxed);
+    return false;
+}
+
+/**
+ * @brief renew the ownership of a module (see LEASE_INTERVALS)
+ * @param header output ownership shared memory
+ * @param clamp module index
+ * @param id id of the writer
+ * @return false if the module is not owned by the writer (e.g. released because the lease expired)
+ */
+inline bool renew(Header &header, std::size_t clamp, uint32_t id) noexcept {
+    auto &slot = slots(header)[clamp];
+    if (slot.owner.load(std::memory_order_acquire) != id) return false;
+    slot.heartbeat.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
+
+/**
+ * @brief release the outputs of a module
+ * @details the outputs keep their values
+ * @param header output ownership shared memory
+ * @param clamp module index
+ * @param id id of the writer
+ */
+inline void release(Header &header, std::size_t clamp, uint32_t id) noexcept {
+    uint32_t expected = id;
+    slots(header)[clamp].owner.compare_exchange_strong(expected, 0, std::memory_order_acq_rel);
+}
+
+/**
+ * @brief stage the output values of an owned module
+ * @details
+ *      function is called with pointers to the staged AO and DO values of the module (Slot::ao_size and
+ *      Slot::do_size values) and must set all of them. The values are sent with the next send_image call.
+ * @param header output ownership shared memory
+ * @param clamp module index
+ * @param id id of the writer
+ * @param function function that writes the staged values
+ * @return false if the module is not owned by the writer
+ */
+template <typename Function>
+inline bool write(Header &header, std::size_t clamp, uint32_t id, Function &&function) {
+    auto &slot = slots(header)[clamp];
+    if (slot.owner.load(std::memory_order_acquire) != id) {
+        header.conflicts.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    slot.sequence.store(slot.sequence.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    function(staged_ao(header) + slot.ao_offset, staged_do(header) + slot.do_offset);
+
+    slot.sequence.store(slot.sequence.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    slot.heartbeat.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
+
+}  // namespace Output_Ownership
+
+}  // namespace WAGO_Modbus
@@ -0,0 +1,177 @@
+/*
+ * Copyright (C) 2023 Nikolas Koesling <nikolas@koesling.info>.
+ * This program is free software. You can redistribute it and/or modify it under the terms of the MIT License.
+ */
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+namespace WAGO_Modbus {
+
+/**
+ * @brief transactions of the output images (<prefix>DO, <prefix>AO)
+ * @details
+ *      The output shared memories end with a Trailer that is located behind the image values (see offset).
+ *      A writer that updates several values that belong together (e.g. a 32 bit setpoint in two AO registers)
+ *      encloses the update in begin / commit (or uses transaction). send_image only sends states of the image in which
+ *      no transaction was in progress. If a transaction is in progress, the previous state is sent again.
+ *      Neither writers nor send_image wait for each other.
+ *
+ *      Each writer uses its own entry of the trailer (see attach), so the transactions of multiple writers are tracked
+ *      separately. If no committed state could be sent for TIMEOUT_CYCLES cycles (a writer terminated between begin
+ *      and commit or the transactions of multiple writers overlap continuously), the coupler aborts the transactions
+ *      in progress and releases their entries. Aborted transactions are counted in
+ *      Coupler_Status::Status::transaction_aborts.
+ *
+ *      Writes without a transaction are sent as before, but may be sent partially.
+ */
+namespace Output_Transaction {
+
+static constexpr std::size_t MAX_WRITERS    = 16;   //*< number of writers that can attach to a trailer
+static constexpr std::size_t TIMEOUT_CYCLES = 100;  //*< cycles without committed state until transactions are aborted
+
+/**
+ * @brief transaction state of one writer
+ */
+struct Writer {
+    std::atomic<uint32_t> token;     //*< id of the attached writer (0: entry not used)
+    std::atomic<uint32_t> sequence;  //*< incremented by begin and commit (odd: transaction in progress)
+};
+
+struct Trailer {
+    std::array<Writer, MAX_WRITERS> writers;  //*< transaction state per writer
+};
+
+static_assert(std::is_standard_layout_v<Trailer>);
+static_assert(sizeof(Trailer) == 8 * MAX_WRITERS, "unexpected output transaction trailer size");
+static_assert(std::atomic<uint32_t>::is_always_lock_free, "output transactions require lock free atomics");
+
+/**
+ * @brief offset of the trailer in an output shared memory
+ * @param image_bytes size of the image values in bytes
+ */
+constexpr std::size_t offset(std::size_t image_bytes) {
+    return (image_bytes + alignof(Trailer) - 1) / alignof(Trailer) * alignof(Trailer);
+}
+
+/**
+ * @brief size of an output shared memory
+ * @param image_bytes size of the image values in bytes
+ */
+constexpr std::size_t size(std::size_t image_bytes) {
+    return offset(image_bytes) + sizeof(Trailer);
+}
+
+/**
+ * @brief get the trailer of an output shared memory
+ * @param image start of the shared memory
+ * @param image_bytes size of the image values in bytes
+ */
+inline Trailer *trailer(void *image, std::size_t image_bytes) noexcept {
+    return reinterpret_cast<Trailer *>(static_cast<uint8_t *>(image) + offset(image_bytes));
+}
+
+/**
+ * @brief attach a writer to a trailer
+ * @param trailer trailer of the output shared memory
+ * @param token id of the writer (e.g. process id, must not be 0)
+ * @return transaction state of the writer (nullptr: all entries are used)
+ */
+inline Writer *attach(Trailer &trailer, uint32_t token) noexcept {
+    for (auto &writer : trailer.writers) {
+        uint32_t expected = 0;
+        if (writer.token.compare_exchange_strong(expected, token, std::memory_order_acq_rel)) return &writer;
+    }
+    return nullptr;
+}
+
+/**
+ * @brief detach a writer from a trailer
+ * @details no transaction of the writer may be in progress
+ * @param writer transaction state of the writer (return value of attach)
+ * @param token id of the writer
+ */
+inline void detach(Writer &writer, uint32_t token) noexcept {
+    uint32_t expected = token;
+    writer.token.compare_exchange_strong(expected, 0, std::memory_order_acq_rel);
+}
+
+/**
+ * @brief start a transaction
+ * @param writer transaction state of the writer
+ */
+inline void begin(Writer &writer) noexcept {
+    writer.sequence.store(writer.sequence.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+}
+
+/**
+ * @brief finish a transaction: the values written since begin can be sent
+ * @param writer transaction state of the writer
+ * @return false if the transaction was aborted by the coupler (see TIMEOUT_CYCLES). The values may have been sent
+ *         partially and the entry of the writer was released: attach again before the next transaction.
+ */
+inline bool commit(Writer &writer) noexcept {
+    auto sequence = writer.sequence.load(std::memory_order_relaxed);
+    return (sequence & 1u) &&
+           writer.sequence.compare_exchange_strong(
+                   sequence, sequence + 1, std::memory_order_release, std::memory_order_relaxed);
+}
+
+/**
+ * @brief write the image values in a transaction
+ * @param writer transaction state of the writer
+ * @param function function that writes the image values
+ * @return false if the transaction was aborted by the coupler (see commit)
+ */
+template <typename Function>
+inline bool transaction(Writer &writer, Function &&function) {
+    begin(writer);
+    function();
+    return commit(writer);
+}
+
+/**
+ * @brief copy a committed state of the image values (used by send_image)
+ * @param trailer trailer of the output shared memory
+ * @param function function that copies the image values
+ * @return false if a transaction was in progress (the copy must not be used)
+ */
+template <typename Function>
+inline bool read_committed(const Trailer &trailer, Function &&function) {
+    std::array<uint32_t, MAX_WRITERS> sequences {};
+    for (std::size_t i = 0; i < MAX_WRITERS; ++i) {
+        sequences[i] = trailer.writers[i].sequence.load(std::memory_order_acquire);
+        if (sequences[i] & 1u) return false;
+    }
+
+    function();
+
+    std::atomic_thread_fence(std::memory_order_acquire);
+    for (std::size_t i = 0; i < MAX_WRITERS; ++i) {
+        if (trailer.writers[i].sequence.load(std::memory_order_relaxed) != sequences[i]) return false;
+    }
+    return true;
+}
+
+/**
+ * @brief abort a transaction that is in progress for too long (used by the coupler, see TIMEOUT_CYCLES)
+ * @details the entry of the writer is released
+ * @param writer transaction state of the writer
+ * @param sequence sequence of the transaction (odd)
+ * @return false if the transaction was finished in the meantime
+ */
+inline bool abort(Writer &writer, uint32_t sequence) noexcept {
+    if (!writer.sequence.compare_exchange_strong(sequence, sequence + 1, std::memory_order_acq_rel)) return false;
+    writer.token.store(0, std::memory_order_release);
+    return true;
+}
+
+}  // namespace Output_Transaction
+
+}  // namespace WAGO_Modbus
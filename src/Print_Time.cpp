@@ -5,14 +5,68 @@
 
 #include "Print_Time.hpp"
 
+#include <array>
 #include <ctime>
+#include <stdexcept>
 
 Print_Time Print_Time::iso("%F_%T");
+Print_Time Print_Time::iso_ms("%F_%T", 3);
+
+namespace {
+/**
+ * @brief formatted second of the last printed time (per thread)
+ */
+struct Second_Cache {
+    const Print_Time    *format = nullptr;  // format of the cached text
+    std::time_t          second = 0;        // cached second
+    std::size_t          length = 0;        // length of the cached text
+    std::array<char, 64> text {};           // formatted second
+};
+
+thread_local Second_Cache cache;
+}  // namespace
+
+Print_Time::Print_Time(std::string format, unsigned precision) : format(std::move(format)), precision(precision) {
+    if (precision > MAX_PRECISION) throw std::out_of_range("time precision out of range");
+}
+
+std::ostream &operator<<(std::ostream &o, const Print_Time::At &a) {
+    const auto  since_epoch = a.time.time_since_epoch();
+    const auto  seconds     = std::chrono::floor<std::chrono::seconds>(since_epoch);
+    const auto  second      = std::chrono::system_clock::to_time_t(std::chrono::system_clock::time_point(seconds));
+    const auto &p           = a.format;
+
+    // gmtime_r: the time is also printed by the thread of the Async_Logger
+    if (cache.format != &p || cache.second != second || cache.length == 0) {
+        std::tm tm {};
+        gmtime_r(&second, &tm);
+        cache.format = &p;
+        cache.second = second;
+        cache.length = strftime(cache.text.data(), cache.text.size(), p.format.c_str(), &tm);
+    }
+    o.write(cache.text.data(), static_cast<std::streamsize>(cache.length));
+
+    if (p.precision) {
+        auto nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(since_epoch - seconds).count();
+        for (auto i = p.precision; i < Print_Time::MAX_PRECISION; ++i)
+            nanoseconds /= 10;
+
+        std::array<char, Print_Time::MAX_PRECISION + 1> fraction {};
+        fraction[0] = '.';
+        for (auto i = p.precision; i > 0; --i) {
+            fraction[i] = static_cast<char>('0' + nanoseconds % 10);
+            nanoseconds /= 10;
+        }
+        o.write(fraction.data(), static_cast<std::streamsize>(p.precision + 1));
+    }
 
-std::ostream &operator<<(std::ostream &o, const Print_Time &p) {
-    auto now = time(nullptr);
-    char buf[sizeof "1234-25-78T90:12:34Z"];
-    strftime(buf, sizeof buf, p.format.c_str(), gmtime(&now));
-    o << buf;
     return o;
 }
+
+std::ostream &operator<<(std::ostream &o, const Print_Time &p) {
+    timespec now {};
+    clock_gettime(CLOCK_REALTIME, &now);
+    const auto since_epoch = std::chrono::seconds(now.tv_sec) + std::chrono::nanoseconds(now.tv_nsec);
+    return o << p.at(std::chrono::system_clock::time_point(
+                   std::chrono::duration_cast<std::chrono::system_clock::duration>(since_epoch)));
+}
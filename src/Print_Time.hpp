@@ -5,18 +5,53 @@
 
 #pragma once
 
+#include <chrono>
 #include <ostream>
 #include <string>
 
+/**
+ * @brief print the current time (UTC)
+ * @details
+ *      The time is formatted with strftime only once per second and thread. Within the second the cached text is
+ *      reused and only the fractional digits are appended, so log bursts do not format the same time repeatedly.
+ *      The current time is read from CLOCK_REALTIME.
+ */
 class Print_Time {
 public:
-    static Print_Time iso;
+    static Print_Time iso;     //*< ISO 8601 date and time (seconds)
+    static Print_Time iso_ms;  //*< ISO 8601 date and time (milliseconds)
+
+    static constexpr unsigned MAX_PRECISION = 9;  //*< maximum number of fractional digits (ns)
+
+    /**
+     * @brief print a given time instead of the current time (see at)
+     */
+    struct At {
+        const Print_Time                     &format;  //*< format of the time
+        std::chrono::system_clock::time_point time;    //*< time to print
+
+        friend std::ostream &operator<<(std::ostream &o, const At &a);
+    };
 
 private:
     std::string format;
+    unsigned    precision;
 
 public:
-    explicit Print_Time(std::string format) : format(std::move(format)) {}
+    /**
+     * @brief create time format
+     * @param format strftime format
+     * @param precision number of fractional digits of the seconds that are appended (0: none)
+     *
+     * @exception std::out_of_range precision greater than MAX_PRECISION
+     */
+    explicit Print_Time(std::string format, unsigned precision = 0);
+
+    /**
+     * @brief print the given time with this format (e.g. the time at which a log message was created)
+     */
+    [[nodiscard]] inline At at(std::chrono::system_clock::time_point time) const noexcept { return {*this, time}; }
 
     friend std::ostream &operator<<(std::ostream &o, const Print_Time &p);
+    friend std::ostream &operator<<(std::ostream &o, const At &a);
 };
@@ -0,0 +1,113 @@
+/*
+ * Copyright (C) 2023 Nikolas Koesling <nikolas@koesling.info>.
+ * This program is free software. You can redistribute it and/or modify it under the terms of the MIT License.
+ */
+
+#include "Session_Recording.hpp"
+
+#include <cstring>
+#include <stdexcept>
+
+template <typename T>
+static void write_value(std::ofstream &file, const T &value) {
+    file.write(reinterpret_cast<const char *>(&value), sizeof(T));
+}
+
+template <typename T>
+static bool read_value(std::ifstream &file, T &value) {
+    file.read(reinterpret_cast<char *>(&value), sizeof(T));
+    return file.gcount() == sizeof(T);
+}
+
+WAGO_Modbus::Session_Recorder::Session_Recorder(const std::string           &path,
+                                                const std::vector<uint16_t> &clamp_config,
+                                                std::size_t                  di_size,
+                                                std::size_t                  ai_size)
+    : file(path, std::ios::binary | std::ios::trunc), di_size(di_size), ai_size(ai_size) {
+    if (!file.is_open()) {
+        const std::string error_msg = strerror(errno);
+        throw std::runtime_error("failed to create recording file '" + path + "': " + error_msg);
+    }
+
+    file.write(Session_Recording::MAGIC.data(), Session_Recording::MAGIC.size());
+    write_value(file, Session_Recording::VERSION);
+    write_value(file, static_cast<uint32_t>(clamp_config.size()));
+    write_value<uint64_t>(file, di_size);
+    write_value<uint64_t>(file, ai_size);
+    file.write(reinterpret_cast<const char *>(clamp_config.data()),
+               static_cast<std::streamsize>(clamp_config.size() * sizeof(uint16_t)));
+
+    if (!file) throw std::runtime_error("failed to write to recording file");
+
+    start_time = std::chrono::steady_clock::now();
+}
+
+void WAGO_Modbus::Session_Recorder::record(const uint8_t *di, const uint16_t *ai) {
+    const auto timestamp = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() -
+                                                                                 start_time);
+
+    write_value(file, static_cast<uint64_t>(timestamp.count()));
+    file.write(reinterpret_cast<const char *>(di), static_cast<std::streamsize>(di_size * sizeof(uint8_t)));
+    file.write(reinterpret_cast<const char *>(ai), static_cast<std::streamsize>(ai_size * sizeof(uint16_t)));
+
+    if (!file) throw std::runtime_error("failed to write to recording file");
+}
+
+WAGO_Modbus::Session_Player::Session_Player(const std::string &path) : file(path, std::ios::binary) {
+    if (!file.is_open()) {
+        const std::string error_msg = strerror(errno);
+        throw std::runtime_error("failed to open recording file '" + path + "': " + error_msg);
+    }
+
+    std::array<char, Session_Recording::MAGIC.size()> magic {};
+    uint32_t                                          version          = 0;
+    uint32_t                                          clamp_config_len = 0;
+    uint64_t                                          di               = 0;
+    uint64_t                                          ai               = 0;
+
+    file.read(magic.data(), magic.size());
+    if (file.gcount() != static_cast<std::streamsize>(magic.size()) || magic != Session_Recording::MAGIC)
+        throw std::runtime_error("invalid recording file: unknown file format");
+
+    if (!read_value(file, version) || !read_value(file, clamp_config_len) || !read_value(file, di) ||
+        !read_value(file, ai))
+        throw std::runtime_error("invalid recording file: header truncated");
+
+    if (version != Session_Recording::VERSION)
+        throw std::runtime_error("invalid recording file: unsupported version " + std::to_string(version));
+
+    clamp_config.resize(clamp_config_len);
+    const auto clamp_config_bytes = static_cast<std::streamsize>(clamp_config.size() * sizeof(uint16_t));
+    file.read(reinterpret_cast<char *>(clamp_config.data()), clamp_config_bytes);
+    if (file.gcount() != clamp_config_bytes) throw std::runtime_error("invalid recording file: header truncated");
+
+    di_size     = di;
+    ai_size     = ai;
+    first_frame = file.tellg();
+}
+
+bool WAGO_Modbus::Session_Player::next_frame(std::chrono::nanoseconds &timestamp) {
+    uint64_t time_ns = 0;
+    if (!read_value(file, time_ns)) {
+        if (file.gcount() != 0) throw std::runtime_error("recording file truncated");
+        return false;
+    }
+
+    timestamp = std::chrono::nanoseconds(static_cast<std::chrono::nanoseconds::rep>(time_ns));
+    return true;
+}
+
+void WAGO_Modbus::Session_Player::read_frame(uint8_t *di, uint16_t *ai) {
+    const auto di_bytes = static_cast<std::streamsize>(di_size * sizeof(uint8_t));
+    const auto ai_bytes = static_cast<std::streamsize>(ai_size * sizeof(uint16_t));
+
+    file.read(reinterpret_cast<char *>(di), di_bytes);
+    if (file.gcount() != di_bytes) throw std::runtime_error("recording file truncated");
+    file.read(reinterpret_cast<char *>(ai), ai_bytes);
+    if (file.gcount() != ai_bytes) throw std::runtime_error("recording file truncated");
+}
+
+void WAGO_Modbus::Session_Player::rewind() {
+    file.clear();
+    file.seekg(first_frame);
+}
@@ -0,0 +1,127 @@
+/*
+ * Copyright (C) 2023 Nikolas Koesling <nikolas@koesling.info>.
+ * This program is free software. You can redistribute it and/or modify it under the terms of the MIT License.
+ */
+
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace WAGO_Modbus {
+
+/**
+ * @brief binary format of a recorded session
+ * @details
+ *      A recording consists of a header followed by an arbitrary number of frames.
+ *      All values are stored in host byte order.
+ *
+ *      header:
+ *          - magic (8 bytes: "WAGOREC\0")
+ *          - format version (uint32_t)
+ *          - number of clamp configuration words (uint32_t)
+ *          - number of digital inputs (uint64_t)
+ *          - number of analog inputs (uint64_t)
+ *          - clamp configuration words (uint16_t[])
+ *
+ *      frame:
+ *          - time since start of recording in nanoseconds (uint64_t)
+ *          - digital input image (uint8_t[])
+ *          - analog input image (uint16_t[])
+ */
+namespace Session_Recording {
+static constexpr std::array<char, 8> MAGIC   = {'W', 'A', 'G', 'O', 'R', 'E', 'C', '\0'};
+static constexpr uint32_t            VERSION = 1;
+}  // namespace Session_Recording
+
+/**
+ * @brief write input images of a running session to a file
+ */
+class Session_Recorder final {
+private:
+    std::ofstream                         file;        //*< recording file
+    std::size_t                           di_size;     //*< number of digital inputs per frame
+    std::size_t                           ai_size;     //*< number of analog inputs per frame
+    std::chrono::steady_clock::time_point start_time;  //*< time of the first frame
+
+public:
+    /**
+     * @brief create recording file and write header
+     * @param path path of the recording file (an existing file is overwritten)
+     * @param clamp_config clamp configuration words as read from the coupler
+     * @param di_size number of digital inputs
+     * @param ai_size number of analog inputs
+     *
+     * @exception std::runtime_error failed to create recording file
+     * @exception std::runtime_error failed to write to recording file
+     */
+    Session_Recorder(const std::string           &path,
+                     const std::vector<uint16_t> &clamp_config,
+                     std::size_t                  di_size,
+                     std::size_t                  ai_size);
+
+    /**
+     * @brief append a frame
+     * @param di digital input image (must contain at least di_size values)
+     * @param ai analog input image (must contain at least ai_size values)
+     *
+     * @exception std::runtime_error failed to write to recording file
+     */
+    void record(const uint8_t *di, const uint16_t *ai);
+};
+
+/**
+ * @brief read input images of a recorded session
+ */
+class Session_Player final {
+private:
+    std::ifstream         file;          //*< recording file
+    std::vector<uint16_t> clamp_config;  //*< clamp configuration words of the recorded coupler
+    std::size_t           di_size = 0;   //*< number of digital inputs per frame
+    std::size_t           ai_size = 0;   //*< number of analog inputs per frame
+    std::streampos        first_frame;   //*< file position of the first frame
+
+public:
+    /**
+     * @brief open recording file and read header
+     * @param path path of the recording file
+     *
+     * @exception std::runtime_error failed to open recording file
+     * @exception std::runtime_error invalid recording file
+     */
+    explicit Session_Player(const std::string &path);
+
+    [[nodiscard]] inline const std::vector<uint16_t> &get_clamp_config() const noexcept { return clamp_config; }
+    [[nodiscard]] inline std::size_t                  get_di_size() const noexcept { return di_size; }
+    [[nodiscard]] inline std::size_t                  get_ai_size() const noexcept { return ai_size; }
+
+    /**
+     * @brief advance to the next frame
+     * @details the images of the frame are read by read_frame
+     * @param timestamp time of the frame relative to the start of the recording
+     * @return false if the end of the recording is reached
+     *
+     * @exception std::runtime_error recording file truncated
+     */
+    bool next_frame(std::chrono::nanoseconds &timestamp);
+
+    /**
+     * @brief read images of the current frame
+     * @param di digital input image (must provide space for at least di_size values)
+     * @param ai analog input image (must provide space for at least ai_size values)
+     *
+     * @exception std::runtime_error recording file truncated
+     */
+    void read_frame(uint8_t *di, uint16_t *ai);
+
+    /**
+     * @brief restart at the first frame
+     */
+    void rewind();
+};
+
+}  // namespace WAGO_Modbus
@@ -0,0 +1,56 @@
+/*
+ * Copyright (C) 2023 Nikolas Koesling <nikolas@koesling.info>.
+ * This program is free software. You can redistribute it and/or modify it under the terms of the MIT License.
+ */
+
+#include "Unix_Socket_Server.hpp"
+
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <system_error>
+#include <unistd.h>
+#include <utility>
+
+static constexpr int LISTEN_BACKLOG = 16;  // pending connections of the listening socket
+
+Unix_Socket_Server::Unix_Socket_Server(std::string path, bool force) : path(std::move(path)) {
+    sockaddr_un addr {};
+    addr.sun_family = AF_UNIX;
+    if (this->path.size() >= sizeof(addr.sun_path)) throw std::runtime_error("socket path too long");
+    std::memcpy(addr.sun_path, this->path.c_str(), this->path.size() + 1);
+
+    sock = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (sock == -1) throw std::system_error(errno, std::generic_category(), "socket");
+
+    auto do_bind = [&addr, this]() { return bind(sock, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)); };
+
+    int tmp = do_bind();
+    if (tmp == -1 && errno == EADDRINUSE && force) {
+        unlink(this->path.c_str());
+        tmp = do_bind();
+    }
+    if (tmp == -1) {
+        const int error = errno;
+        close(sock);
+        throw std::system_error(error, std::generic_category(), "bind " + this->path);
+    }
+
+    if (listen(sock, LISTEN_BACKLOG) == -1) {
+        const int error = errno;
+        close(sock);
+        unlink(this->path.c_str());
+        throw std::system_error(error, std::generic_category(), "listen");
+    }
+}
+
+Unix_Socket_Server::~Unix_Socket_Server() {
+    close(sock);
+    unlink(path.c_str());
+}
+
+int Unix_Socket_Server::accept() const noexcept {
+    return accept4(sock, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+}
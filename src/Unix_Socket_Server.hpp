@@ -0,0 +1,52 @@
+/*
+ * Copyright (C) 2023 Nikolas Koesling <nikolas@koesling.info>.
+ * This program is free software. You can redistribute it and/or modify it under the terms of the MIT License.
+ */
+
+#pragma once
+
+#include <string>
+
+/**
+ * @brief non-blocking listening Unix domain stream socket
+ * @details the socket file is removed when the object is destroyed
+ */
+class Unix_Socket_Server final {
+private:
+    std::string path;       // path of the socket file
+    int         sock = -1;  // listening socket
+
+public:
+    /**
+     * @brief create listening socket
+     * @param path path of the socket file
+     * @param force remove an existing socket file (e.g. of an improperly terminated instance)
+     *
+     * @exception std::runtime_error socket path too long
+     * @exception std::system_error thrown if one of the system calls socket, bind or listen failed
+     */
+    Unix_Socket_Server(std::string path, bool force);
+
+    ~Unix_Socket_Server();
+
+    Unix_Socket_Server(const Unix_Socket_Server &other)            = delete;
+    Unix_Socket_Server(Unix_Socket_Server &&other)                 = delete;
+    Unix_Socket_Server &operator=(const Unix_Socket_Server &other) = delete;
+    Unix_Socket_Server &operator=(Unix_Socket_Server &&other)      = delete;
+
+    /**
+     * @brief accept a pending connection
+     * @return socket of the connection (non-blocking) or -1 if there is no pending connection
+     */
+    [[nodiscard]] int accept() const noexcept;
+
+    /**
+     * @brief get the listening socket (e.g. for poll / epoll)
+     */
+    [[nodiscard]] inline int get_fd() const noexcept { return sock; }
+
+    /**
+     * @brief get the path of the socket file
+     */
+    [[nodiscard]] inline const std::string &get_path() const noexcept { return path; }
+};
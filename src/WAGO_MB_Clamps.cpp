@@ -8,43 +8,80 @@
 #include <sstream>
 #include <stdexcept>
 
-WAGO_Modbus::Clamp_A *WAGO_Modbus::Clamp_A::alloc_clamp_a_by_id(uint16_t clampconfig) {
-    switch (clampconfig) {
-        case 453: return new Clamp_AI(4, clampconfig);
-        case 553: return new Clamp_AO(4, clampconfig);
-    }
+void WAGO_Modbus::Clamp_Table::clear() noexcept {
+    types.clear();
+    configs.clear();
+    channels.clear();
+    for (auto &s : sizes)
+        s.clear();
+    for (auto &o : offsets)
+        o.clear();
+    status_bytes.clear();
+    control_bytes.clear();
+    data_types.clear();
+    names.clear();
+    image_size.fill(0);
+}
 
-    // TODO check external config
+void WAGO_Modbus::Clamp_Table::add_digital(uint16_t clampconfig) {
+    const std::size_t channel_count = (clampconfig >> 0x08u) & 0x7Fu;
 
-    std::ostringstream sstr;
-    sstr << "Unknown product ID for analog clamp: " << clampconfig;
-    throw std::runtime_error(sstr.str());
+    if ((clampconfig & 0x03) == 0x01) {  // DI clamp
+        add(Clamp_Type::DIGITAL_INPUT, clampconfig, channel_count, {channel_count, 0, 0, 0}, nullptr);
+    } else if ((clampconfig & 0x03) == 0x2) {  // DO clamp
+        add(Clamp_Type::DIGITAL_OUTPUT, clampconfig, channel_count, {0, channel_count, 0, 0}, nullptr);
+    } else {
+        throw std::runtime_error("unknown digital module type");
+    }
 }
 
-std::string WAGO_Modbus::Clamp_DI::get_clamp_info() {
-    std::ostringstream sstr;
-    sstr << "Digital Input  with " << std::hex << std::setfill(' ') << std::right << std::setw(2) << channels
-         << " channels: 0x" << std::hex << std::setw(4) << std::setfill('0') << std::right << clampconfig;
-    return sstr.str();
+void WAGO_Modbus::Clamp_Table::add_analog(const Clamp_Descriptor &descriptor) {
+    add(Clamp_Type::ANALOG,
+        descriptor.product_id,
+        descriptor.channels,
+        {0, 0, descriptor.input_words, descriptor.output_words},
+        &descriptor);
 }
 
-std::string WAGO_Modbus::Clamp_DO::get_clamp_info() {
-    std::ostringstream sstr;
-    sstr << "Digital Output with " << std::hex << std::setfill(' ') << std::right << std::setw(2) << channels
-         << " channels: 0x" << std::hex << std::setw(4) << std::setfill('0') << std::right << clampconfig;
-    return sstr.str();
-}
+void WAGO_Modbus::Clamp_Table::add(Clamp_Type                                       type,
+                                   uint16_t                                         config,
+                                   std::size_t                                      channel_count,
+                                   const std::array<std::size_t, _REG_TYPES_SIZE_> &image_values,
+                                   const Clamp_Descriptor                          *descriptor) {
+    types.push_back(type);
+    configs.push_back(config);
+    channels.push_back(static_cast<uint8_t>(channel_count));
 
-std::string WAGO_Modbus::Clamp_AI::get_clamp_info() {
-    std::ostringstream sstr;
-    sstr << "Analog  Input  with " << std::hex << std::setfill(' ') << std::right << std::setw(2) << channels
-         << " channels: 0x" << std::hex << std::setw(4) << std::setfill('0') << std::right << clampconfig;
-    return sstr.str();
+    for (std::size_t t = 0; t < _REG_TYPES_SIZE_; ++t) {
+        sizes[t].push_back(static_cast<uint16_t>(image_values[t]));
+        offsets[t].push_back(static_cast<uint16_t>(image_size[t]));
+        image_size[t] += image_values[t];
+    }
+
+    status_bytes.push_back(descriptor ? descriptor->status_bytes : 0);
+    control_bytes.push_back(descriptor ? descriptor->control_bytes : 0);
+    data_types.push_back(descriptor ? descriptor->type : Clamp_Data_Type::UINT16);
+    names.push_back(descriptor ? descriptor->name : std::string_view());
 }
 
-std::string WAGO_Modbus::Clamp_AO::get_clamp_info() {
+std::string WAGO_Modbus::Clamp_Table::get_clamp_info(std::size_t i) const {
+    const char *type = "";
+    switch (types[i]) {
+        case Clamp_Type::DIGITAL_INPUT: type = "Digital Input  with "; break;
+        case Clamp_Type::DIGITAL_OUTPUT: type = "Digital Output with "; break;
+        case Clamp_Type::ANALOG:
+            if (sizes[AI][i] == 0) type = "Analog  Output with ";
+            else if (sizes[AO][i] != 0)
+                type = "Complex Module with ";
+            else
+                type = "Analog  Input  with ";
+            break;
+        default: break;
+    }
+
     std::ostringstream sstr;
-    sstr << "Analog  Output with " << std::hex << std::setfill(' ') << std::right << std::setw(2) << channels
-         << " channels: 0x" << std::hex << std::setw(4) << std::setfill('0') << std::right << clampconfig;
+    sstr << type << std::hex << std::setfill(' ') << std::right << std::setw(2) << static_cast<unsigned>(channels[i])
+         << " channels: 0x" << std::hex << std::setw(4) << std::setfill('0') << std::right << configs[i];
+    if (!names[i].empty()) sstr << " (" << names[i] << ')';
     return sstr.str();
 }
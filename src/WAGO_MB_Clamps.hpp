@@ -4,113 +4,141 @@
 
 #pragma once
 
+#include "Clamp_Registry.hpp"
+
+#include <array>
 #include <cstdint>
 #include <string>
+#include <string_view>
+#include <vector>
 
 namespace WAGO_Modbus {
 
-class Clamp {
-protected:
-    std::size_t channels = 0;
-    uint16_t    clampconfig;
-
-    explicit Clamp(std::size_t channels, uint16_t clampconfig) : channels(channels), clampconfig(clampconfig) {}
-
-public:
-    virtual ~Clamp()                     = default;
-    Clamp(const Clamp &other)            = delete;
-    Clamp(Clamp &&other)                 = delete;
-    Clamp &operator=(const Clamp &other) = delete;
-    Clamp &operator=(Clamp &&other)      = delete;
-
-    [[nodiscard]] inline std::size_t get_channels() const noexcept { return channels; }
-
-    [[nodiscard]] virtual std::size_t get_d_channels() const noexcept = 0;
-    [[nodiscard]] virtual std::size_t get_a_channels() const noexcept = 0;
-
-    [[nodiscard]] virtual std::size_t get_di_channels() const noexcept = 0;
-    [[nodiscard]] virtual std::size_t get_do_channels() const noexcept = 0;
-    [[nodiscard]] virtual std::size_t get_ai_channels() const noexcept = 0;
-    [[nodiscard]] virtual std::size_t get_ao_channels() const noexcept = 0;
-
-    virtual std::string get_clamp_info() = 0;
-
-protected:
-    inline void set_channels(std::size_t _channels) noexcept { this->channels = _channels; }
-};
-
-class Clamp_D : public Clamp {
-protected:
-    explicit Clamp_D(std::size_t channels, uint16_t clampconfig) : Clamp(channels, clampconfig) {}
-
-public:
-    ~Clamp_D() override = default;
-
-    [[nodiscard]] std::size_t get_d_channels() const noexcept override { return channels; }
-    [[nodiscard]] std::size_t get_a_channels() const noexcept override { return 0; }
-    [[nodiscard]] std::size_t get_ai_channels() const noexcept override { return 0; }
-    [[nodiscard]] std::size_t get_ao_channels() const noexcept override { return 0; }
-};
-
-class Clamp_A : public Clamp {
-protected:
-    explicit Clamp_A(std::size_t channels, uint16_t clampconfig) : Clamp(channels, clampconfig) {}
-
-public:
-    ~Clamp_A() override = default;
-
-    [[nodiscard]] std::size_t get_a_channels() const noexcept override { return channels; }
-    [[nodiscard]] std::size_t get_d_channels() const noexcept override { return 0; }
-    [[nodiscard]] std::size_t get_di_channels() const noexcept override { return 0; }
-    [[nodiscard]] std::size_t get_do_channels() const noexcept override { return 0; }
-
-    static Clamp_A *alloc_clamp_a_by_id(uint16_t clampconfig);
-};
-
-class Clamp_DI final : public Clamp_D {
-public:
-    explicit Clamp_DI(std::size_t channels, uint16_t clampconfig) : Clamp_D(channels, clampconfig) {}
-    ~Clamp_DI() override = default;
-
-    [[nodiscard]] std::size_t get_di_channels() const noexcept override { return channels; }
-    [[nodiscard]] std::size_t get_do_channels() const noexcept override { return 0; }
-
-    std::string get_clamp_info() override;
-};
-
-class Clamp_DO final : public Clamp_D {
-public:
-    explicit Clamp_DO(std::size_t channels, uint16_t clampconfig) : Clamp_D(channels, clampconfig) {}
-    ~Clamp_DO() override = default;
-
-    [[nodiscard]] std::size_t get_di_channels() const noexcept override { return 0; }
-    [[nodiscard]] std::size_t get_do_channels() const noexcept override { return channels; }
+/**
+ * \brief process image register types
+ */
+enum reg_types_t { DI = 0, DO = 1, AI = 2, AO = 3, _REG_TYPES_SIZE_ };  // NOLINT
 
-    std::string get_clamp_info() override;
+/**
+ * @brief module types
+ */
+enum class Clamp_Type : uint8_t {
+    DIGITAL_INPUT,
+    DIGITAL_OUTPUT,
+    ANALOG,  //*< analog or complex module (layout defined by a Clamp_Descriptor)
 };
 
-class Clamp_AI final : public Clamp_A {
-public:
-    explicit Clamp_AI(std::size_t channels, uint16_t clampconfig) : Clamp_A(channels, clampconfig) {}
+/**
+ * @brief list of connected modules
+ * @details
+ *      The modules are stored as struct of arrays (one array per property, index: module position - 1).
+ *      Sizes and offsets of all modules in one process image are stored contiguously,
+ *      so that per module processing in the cycle does not need any indirection.
+ */
+class Clamp_Table final {
+private:
+    std::vector<Clamp_Type> types;     //*< module type
+    std::vector<uint16_t>   configs;   //*< configuration word (digital) or product id (analog)
+    std::vector<uint8_t>    channels;  //*< number of channels
 
-    ~Clamp_AI() override = default;
+    std::array<std::vector<uint16_t>, _REG_TYPES_SIZE_> sizes;    //*< number of values in each image
+    std::array<std::vector<uint16_t>, _REG_TYPES_SIZE_> offsets;  //*< offset of the first value in each image
 
-    [[nodiscard]] std::size_t get_ai_channels() const noexcept override { return channels; }
-    [[nodiscard]] std::size_t get_ao_channels() const noexcept override { return 0; }
+    std::vector<uint8_t>          status_bytes;   //*< status bytes at the start of the input data
+    std::vector<uint8_t>          control_bytes;  //*< control bytes at the start of the output data
+    std::vector<Clamp_Data_Type>  data_types;     //*< data type of the channel values
+    std::vector<std::string_view> names;          //*< description (empty for digital modules)
 
-    std::string get_clamp_info() override;
-};
+    std::array<std::size_t, _REG_TYPES_SIZE_> image_size {};  //*< total number of values in each image
 
-class Clamp_AO final : public Clamp_A {
 public:
-    explicit Clamp_AO(std::size_t channels, uint16_t clampconfig) : Clamp_A(channels, clampconfig) {}
-
-    ~Clamp_AO() override = default;
-
-    [[nodiscard]] std::size_t get_ai_channels() const noexcept override { return channels; }
-    [[nodiscard]] std::size_t get_ao_channels() const noexcept override { return 0; }
-
-    std::string get_clamp_info() override;
+    /**
+     * @brief remove all modules
+     */
+    void clear() noexcept;
+
+    /**
+     * @brief append digital module
+     * @param clampconfig configuration word as reported by the coupler (bit 15 set)
+     *
+     * @exception std::runtime_error unknown digital module type
+     */
+    void add_digital(uint16_t clampconfig);
+
+    /**
+     * @brief append analog or complex module
+     * @param descriptor descriptor of the module. The name must stay valid as long as the module is in the table.
+     */
+    void add_analog(const Clamp_Descriptor &descriptor);
+
+    [[nodiscard]] inline std::size_t size() const noexcept { return types.size(); }
+    [[nodiscard]] inline bool        empty() const noexcept { return types.empty(); }
+
+    [[nodiscard]] inline Clamp_Type  get_type(std::size_t i) const noexcept { return types[i]; }
+    [[nodiscard]] inline uint16_t    get_clampconfig(std::size_t i) const noexcept { return configs[i]; }
+    [[nodiscard]] inline std::size_t get_channels(std::size_t i) const noexcept { return channels[i]; }
+
+    /**
+     * @brief number of values of a module in a process image
+     */
+    [[nodiscard]] inline std::size_t get_size(std::size_t i, reg_types_t type) const noexcept {
+        return sizes[type][i];
+    }
+
+    /**
+     * @brief offset of the first value of a module in a process image
+     */
+    [[nodiscard]] inline std::size_t get_offset(std::size_t i, reg_types_t type) const noexcept {
+        return offsets[type][i];
+    }
+
+    /**
+     * @brief number of values of all modules in a process image (one entry per module)
+     */
+    [[nodiscard]] inline const std::vector<uint16_t> &get_sizes(reg_types_t type) const noexcept {
+        return sizes[type];
+    }
+
+    /**
+     * @brief offsets of all modules in a process image (one entry per module)
+     */
+    [[nodiscard]] inline const std::vector<uint16_t> &get_offsets(reg_types_t type) const noexcept {
+        return offsets[type];
+    }
+
+    [[nodiscard]] inline std::size_t      get_status_bytes(std::size_t i) const noexcept { return status_bytes[i]; }
+    [[nodiscard]] inline std::size_t      get_control_bytes(std::size_t i) const noexcept { return control_bytes[i]; }
+    [[nodiscard]] inline Clamp_Data_Type  get_data_type(std::size_t i) const noexcept { return data_types[i]; }
+    [[nodiscard]] inline std::string_view get_name(std::size_t i) const noexcept { return names[i]; }
+
+    /**
+     * @brief total number of values in a process image
+     */
+    [[nodiscard]] inline std::size_t get_image_size(reg_types_t type) const noexcept { return image_size[type]; }
+
+    /**
+     * @brief total number of values in all process images
+     */
+    [[nodiscard]] inline const std::array<std::size_t, _REG_TYPES_SIZE_> &get_image_sizes() const noexcept {
+        return image_size;
+    }
+
+    /**
+     * @brief get information string of a module
+     * @param i module index
+     */
+    [[nodiscard]] std::string get_clamp_info(std::size_t i) const;
+
+private:
+    /**
+     * @brief append module
+     * @param image_values number of values in each image
+     */
+    void add(Clamp_Type                                       type,
+             uint16_t                                         config,
+             std::size_t                                      channel_count,
+             const std::array<std::size_t, _REG_TYPES_SIZE_> &image_values,
+             const Clamp_Descriptor                          *descriptor);
 };
 
 }  // namespace WAGO_Modbus
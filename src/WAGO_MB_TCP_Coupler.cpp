@@ -4,91 +4,417 @@
 
 #include "WAGO_MB_TCP_Coupler.hpp"
 
+#include "Channel_Map.hpp"
+#include "Image_Handover.hpp"
+#include "Output_Ownership.hpp"
+#include "Modbus_TCP_Server.hpp"
 #include "endian.hpp"
 
+#include <algorithm>
 #include <cassert>
+#include <cstring>
 #include <iomanip>
+#include <new>
 #include <sstream>
 #include <stdexcept>
+#include <sys/socket.h>
+#include <unistd.h>
 
 
 WAGO_Modbus::TCP_Coupler_SHM::TCP_Coupler_SHM(const std::string &host, const std::string &service, bool debug)
-    : modbus(host, service, debug) {}
+    : modbus(std::make_unique<Modbus_TCP_Server>(host, service, debug)) {}
+
+WAGO_Modbus::TCP_Coupler_SHM::TCP_Coupler_SHM(std::unique_ptr<Modbus_Transport> transport)
+    : modbus(std::move(transport)) {
+    if (!modbus) throw std::invalid_argument("transport is nullptr");
+}
+
+WAGO_Modbus::TCP_Coupler_SHM::TCP_Coupler_SHM() = default;
 
 WAGO_Modbus::TCP_Coupler_SHM::~TCP_Coupler_SHM() {
     if (initialized) disconnect();
 }
 
 void WAGO_Modbus::TCP_Coupler_SHM::init(const std::string &shm_prefix, bool exclusive) {
-    modbus.connect();
+    if (!modbus) throw std::logic_error("no coupler connection");
+    this->shm_prefix  = shm_prefix;
+    shm_exclusive     = exclusive;
+    layout_generation = 0;
+
+    modbus->connect();
     check_constants();
+
+    // requests are sent with the same TOS as the responses of the coupler
+    if (match_coupler_tos) {
+        auto options = modbus->get_socket_options();
+        options.tos  = modbus->read_ai({ADDR_MODBUS_TOS})[0][0] & 0xFF;
+        modbus->set_socket_options(options);
+    }
     read_clamp_config();
-    create_shm(shm_prefix, exclusive);
+    create_shm();
+    create_status_shm();
+    if (!handover_path.empty()) handover = std::make_unique<Unix_Socket_Server>(handover_path, handover_force);
+    prepare_transfers();
+    if (watchdog_timeout.count() > 0) configure_watchdog();
+
+    // initial diagnostics (also measures the duration of a diagnostics step)
+    if (diagnostics_interval.count() > 0) {
+        for (std::size_t i = 0; i < DIAGNOSTICS_RANGES.size(); ++i)
+            diagnostics_step_read();
+    }
+
     initialized = true;
 }
 
-void WAGO_Modbus::TCP_Coupler_SHM::disconnect() {
+void WAGO_Modbus::TCP_Coupler_SHM::init_replay(Session_Player &player, const std::string &shm_prefix, bool exclusive) {
+    if (initialized) throw std::logic_error("already initialized");
+
+    clamp_config = player.get_clamp_config();
+    parse_clamp_config();
+
+    if (player.get_di_size() != image_size[DI] || player.get_ai_size() != image_size[AI])
+        throw std::runtime_error("image size of recording does not match clamp configuration");
+
+    this->shm_prefix = shm_prefix;
+    shm_exclusive    = exclusive;
+    create_shm();
+    create_status_shm();
+    if (!handover_path.empty()) handover = std::make_unique<Unix_Socket_Server>(handover_path, handover_force);
+    initialized = true;
+}
+
+void WAGO_Modbus::TCP_Coupler_SHM::set_watchdog(std::chrono::milliseconds timeout) {
+    if (initialized) throw std::logic_error("already initialized");
+    if (timeout.count() < 0 || (timeout.count() + 99) / 100 > UINT16_MAX)
+        throw std::out_of_range("watchdog timeout out of range");
+    watchdog_timeout = timeout;
+}
+
+void WAGO_Modbus::TCP_Coupler_SHM::set_match_coupler_tos(bool enable) {
+    if (initialized) throw std::logic_error("already initialized");
+    match_coupler_tos = enable;
+}
+
+void WAGO_Modbus::TCP_Coupler_SHM::set_diagnostics_interval(std::chrono::milliseconds interval) {
+    if (initialized) throw std::logic_error("already initialized");
+    if (interval.count() < 0) throw std::out_of_range("diagnostics interval out of range");
+    diagnostics_interval = interval;
+}
+
+void WAGO_Modbus::TCP_Coupler_SHM::set_memfd_handover(const std::string &path, bool force) {
+    if (initialized) throw std::logic_error("already initialized");
+    handover_path  = path;
+    handover_force = force;
+}
+
+bool WAGO_Modbus::TCP_Coupler_SHM::poll_diagnostics(std::chrono::steady_clock::time_point deadline) {
     if (!initialized) throw std::logic_error("not initialized");
-    clamps.clear();
+    if (!modbus || diagnostics_interval.count() == 0) return false;
 
-    for (auto &i : image)
-        i.reset();
+    const auto now = std::chrono::steady_clock::now();
+    if (diagnostics_step == 0 && now < diagnostics_due) return false;
+    if (deadline - now < diagnostics_duration) return false;
 
-    modbus.disconnect();
+    diagnostics_step_read();
+    return true;
 }
 
-void WAGO_Modbus::TCP_Coupler_SHM::fetch_image(bool include_outputs) {
-    // DI
-    if (image_size[DI]) {
-        for (const auto &area : memory_areas[DI]) {
-            // read size (area[1]) from modbus address (area[0]) to image[..] + offset (area[2])
-            modbus.read_di(image[DI]->get_addr<uint8_t *>() + std::get<2>(area), std::get<0>(area), std::get<1>(area));
-        }
+void WAGO_Modbus::TCP_Coupler_SHM::diagnostics_step_read() {
+    const auto start = std::chrono::steady_clock::now();
+    if (diagnostics_step == 0) diagnostics_due = start + diagnostics_interval;
+
+    const auto              &range = DIAGNOSTICS_RANGES[diagnostics_step];
+    std::array<uint16_t, 4> values {};
+    assert(range.second <= values.size());
+
+    bool failed = false;
+    try {
+        modbus->read_ai(values.data(), range.first, range.second);
+    } catch (const std::runtime_error &) {
+        // the connection is checked by the image transfers
+        failed = true;
     }
 
-    // AI
-    if (image_size[AI]) {
-        for (const auto &area : memory_areas[AI]) {
-            // read size (area[1]) from modbus address (area[0]) to image[..] + offset (area[2])
-            modbus.read_ai(image[AI]->get_addr<uint16_t *>() + std::get<2>(area), std::get<0>(area), std::get<1>(area));
+    // expected duration: decaying maximum of the measured durations
+    const auto duration  = std::chrono::steady_clock::now() - start;
+    diagnostics_duration =
+            std::max<std::chrono::nanoseconds>(duration, diagnostics_duration - diagnostics_duration / 16);
+
+    bool layout_changed = false;
+
+    begin_status_update();
+    if (failed) {
+        ++status->diagnostics_errors;
+        diagnostics_step = 0;
+    } else {
+        switch (diagnostics_step) {
+            case 0: status->io_module_diagnosis = values[0]; break;
+            case 1:
+                status->led_error_code     = values[0];
+                status->led_error_argument = values[1];
+                break;
+            case 2: status->coupler_diagnostics = values[0]; break;
+            case 3:
+                layout_changed = !std::equal(process_image_bits.begin(), process_image_bits.end(), values.begin());
+                status->diagnostics_time = static_cast<uint64_t>(
+                        std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                std::chrono::system_clock::now().time_since_epoch())
+                                .count());
+                ++status->diagnostics_count;
+                break;
+            default: assert(false);
         }
+        diagnostics_step = (diagnostics_step + 1) % DIAGNOSTICS_RANGES.size();
     }
+    end_status_update();
 
-    if (include_outputs) {
-        // DO
-        if (image_size[DO]) {
-            for (const auto &area : memory_areas[DO]) {
-                // read size (area[1]) from modbus address (area[0]) to image[..] + offset (area[2])
-                modbus.read_do(
-                        image[DO]->get_addr<uint8_t *>() + std::get<2>(area), std::get<0>(area), std::get<1>(area));
-            }
-        }
+    // modules added, removed or failed
+    if (layout_changed) relayout();
+}
+
+void WAGO_Modbus::TCP_Coupler_SHM::relayout() {
+    // the image sizes of the recording are no longer valid
+    recorder.reset();
+
+    // the gateway must not access the images while they are recreated
+    if (gateway) gateway->set_images({});
+
+    read_clamp_config();
+    create_shm();
+    prepare_transfers();
+    seed_outputs();
+    if (gateway) gateway->set_images(get_gateway_images());
+
+    // the coding mask depends on the available images
+    if (watchdog_active) configure_watchdog();
+
+    begin_status_update();
+    status->layout_generation  = ++layout_generation;
+    status->process_image_bits = process_image_bits;
+    end_status_update();
+
+    // subscribers receive a snapshot of the new layout
+    if (stream) stream->set_layout(clamps, layout_generation);
+}
+
+void WAGO_Modbus::TCP_Coupler_SHM::publish_cycle_time(std::chrono::nanoseconds period,
+                                                       std::chrono::nanoseconds duration) {
+    if (!initialized) throw std::logic_error("not initialized");
+
+    const auto *latency = modbus ? modbus->get_latency() : nullptr;
 
-        // AO
-        if (image_size[AO]) {
-            for (const auto &area : memory_areas[AO]) {
-                // read size (area[1]) from modbus address (area[0]) to image[..] + offset (area[2])
-                modbus.read_ao(
-                        image[AO]->get_addr<uint16_t *>() + std::get<2>(area), std::get<0>(area), std::get<1>(area));
+    begin_status_update();
+    status->cycle_period   = static_cast<uint64_t>(period.count());
+    status->cycle_duration = static_cast<uint64_t>(duration.count());
+    if (latency) {
+        status->latency_samples   = latency->samples;
+        status->wire_latency      = static_cast<uint64_t>(latency->wire.count());
+        status->wire_latency_max  = static_cast<uint64_t>(latency->wire_max.count());
+        status->transfer_overhead = static_cast<uint64_t>(latency->overhead.count());
+    }
+    end_status_update();
+}
+
+void WAGO_Modbus::TCP_Coupler_SHM::begin_status_update() noexcept {
+    status->sequence.store(status->sequence.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+}
+
+void WAGO_Modbus::TCP_Coupler_SHM::end_status_update() noexcept {
+    status->sequence.store(status->sequence.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+void WAGO_Modbus::TCP_Coupler_SHM::load_clamp_config(const std::string &path) {
+    if (initialized) throw std::logic_error("already initialized");
+    registry.load_config(path);
+}
+
+void WAGO_Modbus::TCP_Coupler_SHM::load_scaling_config(const std::string &path) {
+    if (initialized) throw std::logic_error("already initialized");
+    scaling.load_config(path);
+}
+
+void WAGO_Modbus::TCP_Coupler_SHM::start_recording(const std::string &path) {
+    if (!initialized) throw std::logic_error("not initialized");
+    recorder = std::make_unique<Session_Recorder>(path, clamp_config, image_size[DI], image_size[AI]);
+}
+
+void WAGO_Modbus::TCP_Coupler_SHM::start_gateway(const std::string &host,
+                                                 const std::string &service,
+                                                 std::size_t        max_clients) {
+    if (!initialized) throw std::logic_error("not initialized");
+    if (gateway) throw std::logic_error("gateway already started");
+    gateway = std::make_unique<Modbus_TCP_Gateway>(host, service, get_gateway_images(), max_clients);
+}
+
+void WAGO_Modbus::TCP_Coupler_SHM::start_change_stream(const std::string &path, bool force, std::size_t queue_limit) {
+    if (!initialized) throw std::logic_error("not initialized");
+    if (stream) throw std::logic_error("change stream already started");
+    stream = std::make_unique<Change_Stream>(path, force, queue_limit);
+    stream->set_layout(clamps, layout_generation);
+}
+
+Modbus_TCP_Gateway::Images WAGO_Modbus::TCP_Coupler_SHM::get_gateway_images() const {
+    Modbus_TCP_Gateway::Images images;
+    images.coils                     = image[DO]->get_addr<uint8_t *>();
+    images.coils_size                = image_size[DO];
+    images.coils_trailer             = get_output_trailer(DO);
+    images.discrete_inputs           = image[DI]->get_addr<uint8_t *>();
+    images.discrete_inputs_size      = image_size[DI];
+    images.holding_registers         = image[AO]->get_addr<uint16_t *>();
+    images.holding_registers_size    = image_size[AO];
+    images.holding_registers_trailer = get_output_trailer(AO);
+    images.input_registers           = image[AI]->get_addr<uint16_t *>();
+    images.input_registers_size      = image_size[AI];
+    return images;
+}
+
+void WAGO_Modbus::TCP_Coupler_SHM::serve_consumers() {
+    if (stream) {
+        stream->publish({image[DI]->get_addr<const void *>(),
+                         image[DO]->get_addr<const void *>(),
+                         image[AI]->get_addr<const void *>(),
+                         image[AO]->get_addr<const void *>()});
+    }
+
+    if (handover) handover_images();
+}
+
+void WAGO_Modbus::TCP_Coupler_SHM::handover_images() {
+    using Header                        = Image_Handover::Header;
+    using Entry                         = Image_Handover::Entry;
+    static constexpr std::size_t IMAGES = Image_Handover::IMAGES;
+    static_assert(static_cast<std::size_t>(Image_Handover::DI) == DI &&
+                  static_cast<std::size_t>(Image_Handover::DO) == DO &&
+                  static_cast<std::size_t>(Image_Handover::AI) == AI &&
+                  static_cast<std::size_t>(Image_Handover::AO) == AO);
+
+    int client = handover->accept();
+    if (client == -1) return;
+
+    const std::array<const Image_Memory *, IMAGES> memories = {image[DI].get(),
+                                                               image[DO].get(),
+                                                               image[AI].get(),
+                                                               image[AO].get(),
+                                                               image_eu.get(),
+                                                               image_cnt.get(),
+                                                               channel_map.get(),
+                                                               status_shm.get(),
+                                                               owners.get()};
+
+    std::array<uint8_t, sizeof(Header) + IMAGES * sizeof(Entry)> data {};
+
+    Header header {};
+    header.magic             = Image_Handover::MAGIC;
+    header.version           = Image_Handover::VERSION;
+    header.count             = IMAGES;
+    header.layout_generation = layout_generation;
+    std::memcpy(data.data(), &header, sizeof(header));
+
+    alignas(cmsghdr) std::array<char, CMSG_SPACE(sizeof(int) * IMAGES)> control {};
+    std::array<int, IMAGES>                                            fds {};
+
+    for (std::size_t i = 0; i < IMAGES; ++i) {
+        Entry entry {};
+        entry.image         = static_cast<uint32_t>(i);
+        const bool writable = i == Image_Handover::DO || i == Image_Handover::AO || i == Image_Handover::OWNERS;
+        entry.flags         = writable ? Image_Handover::WRITABLE : 0U;
+        entry.size          = memories[i]->get_size();
+        std::memcpy(data.data() + sizeof(Header) + i * sizeof(Entry), &entry, sizeof(entry));
+        fds[i] = memories[i]->get_fd();
+    }
+
+    iovec iov {};
+    iov.iov_base = data.data();
+    iov.iov_len  = data.size();
+
+    msghdr msg {};
+    msg.msg_iov        = &iov;
+    msg.msg_iovlen     = 1;
+    msg.msg_control    = control.data();
+    msg.msg_controllen = control.size();
+
+    cmsghdr *cmsg    = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type  = SCM_RIGHTS;
+    cmsg->cmsg_len   = CMSG_LEN(sizeof(int) * IMAGES);
+    std::memcpy(CMSG_DATA(cmsg), fds.data(), sizeof(int) * IMAGES);
+
+    // the message fits into the socket buffer of a new connection: a consumer that is not ready misses the message.
+    // send errors are ignored on purpose: the consumer closed the connection and has to connect again
+    for (; client != -1; client = handover->accept()) {
+        sendmsg(client, &msg, MSG_DONTWAIT | MSG_NOSIGNAL);
+        close(client);
+    }
+}
+
+void WAGO_Modbus::TCP_Coupler_SHM::disconnect() {
+    if (!initialized) throw std::logic_error("not initialized");
+    gateway.reset();
+    stream.reset();
+    handover.reset();
+    recorder.reset();
+    clamps.clear();
+
+    for (auto &i : image)
+        i.reset();
+    image_eu.reset();
+    image_cnt.reset();
+    channel_map.reset();
+    owners.reset();
+    status = nullptr;
+    status_shm.reset();
+
+    if (modbus) {
+        if (watchdog_active) {
+            watchdog_active = false;
+            try {
+                stop_watchdog();
+            } catch (const std::runtime_error &) {
+                // connection lost: the watchdog expires and the coupler sets the outputs to the safe state
             }
         }
+        modbus->disconnect();
     }
+    initialized = false;
+}
+
+void WAGO_Modbus::TCP_Coupler_SHM::replay_image(Session_Player &player) {
+    if (!initialized) throw std::logic_error("not initialized");
+    player.read_frame(image[DI]->get_addr<uint8_t *>(), image[AI]->get_addr<uint16_t *>());
+    scaling.apply(image[AI]->get_addr<const uint16_t *>(), image_eu->get_addr<float *>());
+    counters.decode(image[AI]->get_addr<const uint16_t *>(), image_cnt->get_addr<uint32_t *>());
+    serve_consumers();
+}
+
+void WAGO_Modbus::TCP_Coupler_SHM::fetch_image(bool include_outputs) {
+    if (!modbus) throw std::logic_error("no coupler connection");
+
+    modbus->execute(transfers[READ_INPUTS]);
+    if (include_outputs) modbus->execute(transfers[READ_OUTPUTS]);
+
+    scaling.apply(image[AI]->get_addr<const uint16_t *>(), image_eu->get_addr<float *>());
+    counters.decode(image[AI]->get_addr<const uint16_t *>(), image_cnt->get_addr<uint32_t *>());
+
+    if (recorder) recorder->record(image[DI]->get_addr<const uint8_t *>(), image[AI]->get_addr<const uint16_t *>());
+    serve_consumers();
 }
 
 void WAGO_Modbus::TCP_Coupler_SHM::send_image() {
-    if (image_size[DO]) {
-        for (const auto &area : memory_areas[DO]) {
-            // read size (area[1]) from image[..] + offset (area[2]) to modbus address (area[0])
-            modbus.write_do(image[DO]->get_addr<uint8_t *>() + std::get<2>(area), std::get<0>(area), std::get<1>(area));
+    if (!modbus) throw std::logic_error("no coupler connection");
+
+    // leases of the output ownership (independent of the time left for the diagnostics reads)
+    if (diagnostics_interval.count() > 0) {
+        const auto now = std::chrono::steady_clock::now();
+        if (now >= lease_check_due) {
+            lease_check_due = now + diagnostics_interval;
+            release_stale_owners();
         }
     }
 
-    if (image_size[AO]) {
-        for (const auto &area : memory_areas[AO]) {
-            // read size (area[1]) from image[..] + offset (area[2]) to modbus address (area[0])
-            modbus.write_do(image[AO]->get_addr<uint8_t *>() + std::get<2>(area), std::get<0>(area), std::get<1>(area));
-        }
-    }
+    collect_outputs();
+    copy_committed_outputs();
+    modbus->execute(transfers[WRITE_OUTPUTS]);
 }
 
 bool WAGO_Modbus::TCP_Coupler_SHM::read_di(std::size_t index) {
@@ -124,7 +450,7 @@ void WAGO_Modbus::TCP_Coupler_SHM::write_do(std::size_t index, bool value) {
 void WAGO_Modbus::TCP_Coupler_SHM::write_ao(std::size_t index, uint16_t value) {
     if (!initialized) throw std::logic_error("not initialized");
     if (index >= image_size[AO]) throw std::out_of_range("index out of range");
-    image[AO]->at<uint8_t>(index) = value;
+    image[AO]->at<uint16_t>(index) = value;
 }
 
 std::vector<std::string> WAGO_Modbus::TCP_Coupler_SHM::get_clamp_info() const {
@@ -132,13 +458,14 @@ std::vector<std::string> WAGO_Modbus::TCP_Coupler_SHM::get_clamp_info() const {
 
     std::vector<std::string> result;
     result.reserve(clamps.size());
-    for (const auto &clamp : clamps)
-        result.emplace_back(clamp->get_clamp_info());
+    for (std::size_t i = 0; i < clamps.size(); ++i)
+        result.emplace_back(clamps.get_clamp_info(i));
     return result;
 }
 
 std::vector<std::string> WAGO_Modbus::TCP_Coupler_SHM::get_coupler_info() const {
     if (!initialized) throw std::logic_error("not initialized");
+    if (!modbus) throw std::logic_error("no coupler connection");
     std::vector<std::string> result;
 
     static const std::vector<std::pair<uint16_t, std::size_t>> address_ranges = {
@@ -175,7 +502,7 @@ std::vector<std::string> WAGO_Modbus::TCP_Coupler_SHM::get_coupler_info() const
             "Firmware compile date",
     };
     assert(text.size() == address_ranges.size());
-    const auto values = modbus.read_ai(address_ranges);
+    const auto values = modbus->read_ai(address_ranges);
 
     for (std::size_t i = 0; i < text.size(); ++i) {
         std::ostringstream sstr;
@@ -193,117 +520,372 @@ std::vector<std::string> WAGO_Modbus::TCP_Coupler_SHM::get_coupler_info() const
 }
 
 void WAGO_Modbus::TCP_Coupler_SHM::read_clamp_config() {
+    // process image sizes (compared by the diagnostics to detect module changes)
+    modbus->read_ai(process_image_bits.data(), ADDR_PROCESS_IMAGE_BITS.first, ADDR_PROCESS_IMAGE_BITS.second);
+
     // read clamp config memory
-    const auto clamp_config = modbus.read_ao({{CLAMPCONFIG_ADDR, CLAMP_PACKET_LEN}});
+    clamp_config = modbus->read_ao({{CLAMPCONFIG_ADDR, CLAMP_PACKET_LEN}})[0];
+    endian::little_to_host_n(clamp_config.data(), clamp_config.data(), clamp_config.size());
+    parse_clamp_config();
+}
+
+void WAGO_Modbus::TCP_Coupler_SHM::parse_clamp_config() {
+    clamps.clear();
 
     // start at 1, as 0 is the coupler itself
-    for (std::size_t i = 1; i < clamp_config[0].size(); ++i) {
-        const auto cfg_value = endian::little_to_host(clamp_config[0][i]);
+    for (std::size_t i = 1; i < clamp_config.size(); ++i) {
+        const auto cfg_value = clamp_config[i];
 
         if (cfg_value == 0x0) break;
 
         if (cfg_value & 0x8000) {  // digital clamp
-            auto channels = (cfg_value >> 0x08u) & 0x7Fu;
-            if ((cfg_value & 0x03) == 0x01) {  // DI clamp
-                clamps.emplace_back(std::make_unique<Clamp_DI>(channels, cfg_value));
-            } else if ((cfg_value & 0x03) == 0x2) {  // DO clamp
-                clamps.emplace_back(std::make_unique<Clamp_DO>(channels, cfg_value));
-            } else {
-                throw std::runtime_error("unknown digital module type");
-            }
+            clamps.add_digital(cfg_value);
         } else {  // analog clamp
-            clamps.emplace_back(Clamp_A::alloc_clamp_a_by_id(cfg_value));
+            clamps.add_analog(registry.get(cfg_value));
         }
     }
 
     if (clamps.empty()) throw std::runtime_error("no modules detected");
 
     // allocate image memory
-    image_size.fill(0);
-
-    for (const auto &clamp : clamps) {
-        image_size[DI] += clamp->get_di_channels();
-        image_size[DO] += clamp->get_do_channels();
-        image_size[AI] += clamp->get_ai_channels();
-        image_size[AO] += clamp->get_ao_channels();
+    image_size = clamps.get_image_sizes();
+    for (std::size_t t = 0; t < _REG_TYPES_SIZE_; ++t) {
+        if (image_size[t] > REGISTER_MAPS[t].capacity()) throw std::runtime_error("process data image too large");
     }
 
-    // calculate memory areas
-    // DI
-    if (image_size[DI]) {
-        memory_areas[DI].emplace_back(std::make_tuple(
-                ADDR_DATA_DI_1.first, std::min(ADDR_DATA_DI_1.second, image_size[DI]), static_cast<std::size_t>(0)));
+    scaling.build(clamps);
+    counters.build(clamps);
+}
 
-        if (image_size[DI] > ADDR_DATA_DI_1.second) {
-            memory_areas[DI].emplace_back(std::make_tuple(
-                    ADDR_DATA_DI_2.second, image_size[DI] - ADDR_DATA_DI_1.second, ADDR_DATA_DI_1.second));
+void WAGO_Modbus::TCP_Coupler_SHM::check_constants() {
+    auto result = modbus->read_ai({ADDR_CONSTANTS});
+    assert(result[0].size() == CONSTANTS.size());
+    endian::little_to_host_n(result[0].data(), result[0].data(), result[0].size());
+
+    for (std::size_t i = 0; i < std::min(CONSTANTS.size(), result[0].size()); ++i) {
+        if (result[0][i] != CONSTANTS[i]) {
+            std::ostringstream sstr;
+            sstr << std::hex << std::setfill('0') << std::right
+                 << "Modbus client is not a WAGO Modbus TCP Field Bus Coupler: Constant @0x" << std::setw(4)
+                 << (ADDR_CONSTANTS.first + i) << " does not match. Expected 0x" << std::setw(4) << CONSTANTS[i]
+                 << " but got 0x" << std::setw(4) << result[0][i];
+            throw std::runtime_error(sstr.str());
         }
     }
+}
+
+void WAGO_Modbus::TCP_Coupler_SHM::create_shm() {
+    using Access = Image_Memory::Access;
+
+    // remove the shared memories of a previous layout (consumers keep their mapping until they remap)
+    for (auto &i : image)
+        i.reset();
+    image_eu.reset();
+    image_cnt.reset();
+    channel_map.reset();
+    owners.reset();
 
     // DO
-    if (image_size[DO]) {
-        memory_areas[DO].emplace_back(std::make_tuple(
-                ADDR_DATA_DO_1.first, std::min(ADDR_DATA_DO_1.second, image_size[DO]), static_cast<std::size_t>(0)));
+    image[DO] = make_image_memory(
+            "DO", Output_Transaction::size(image_size[DO] * sizeof(uint8_t)), Access::READ_WRITE);
+    new (get_output_trailer(DO)) Output_Transaction::Trailer();
 
-        if (image_size[DO] > ADDR_DATA_DO_1.second) {
-            memory_areas[DO].emplace_back(std::make_tuple(
-                    ADDR_DATA_DO_2.second, image_size[DO] - ADDR_DATA_DO_1.second, ADDR_DATA_DO_1.second));
-        }
-    }
+    // DI
+    image[DI] = make_image_memory("DI", image_size[DI] * sizeof(uint8_t), Access::READ_ONLY);
+
+    // AO
+    image[AO] = make_image_memory(
+            "AO", Output_Transaction::size(image_size[AO] * sizeof(uint16_t)), Access::READ_WRITE);
+    new (get_output_trailer(AO)) Output_Transaction::Trailer();
 
     // AI
-    if (image_size[AI]) {
-        memory_areas[AI].emplace_back(std::make_tuple(
-                ADDR_DATA_AI_1.first, std::min(ADDR_DATA_AI_1.second, image_size[AI]), static_cast<std::size_t>(0)));
+    image[AI] = make_image_memory("AI", image_size[AI] * sizeof(uint16_t), Access::READ_ONLY);
 
-        if (image_size[AI] > ADDR_DATA_AI_1.second) {
-            memory_areas[AI].emplace_back(std::make_tuple(
-                    ADDR_DATA_AI_2.second, image_size[AI] - ADDR_DATA_AI_1.second, ADDR_DATA_AI_1.second));
-        }
+    // AI (engineering units)
+    image_eu = make_image_memory("AI_EU", image_size[AI] * sizeof(float), Access::READ_ONLY);
+
+    // 32 bit values of complex modules
+    image_cnt = make_image_memory("CNT", counters.size() * sizeof(uint32_t), Access::READ_ONLY);
+
+    // channel map
+    channel_map = make_image_memory("MAP", Channel_Map::size(clamps.size()), Access::READ_ONLY);
+    write_channel_map();
+
+    // committed state of the outputs (used by the prepared transfers)
+    committed_do.assign(image_size[DO], 0);
+    committed_ao.assign(image_size[AO], 0);
+    output_copy_do.assign(image_size[DO], 0);
+    output_copy_ao.assign(image_size[AO], 0);
+    uncommitted_cycles.fill(0);
+
+    // output ownership
+    owners = make_image_memory(
+            "OWNERS", Output_Ownership::size(clamps.size(), image_size[AO], image_size[DO]), Access::READ_WRITE);
+    write_output_ownership();
+}
+
+void WAGO_Modbus::TCP_Coupler_SHM::create_status_shm() {
+    status_shm = make_image_memory("STATUS", sizeof(Coupler_Status::Status), Image_Memory::Access::READ_ONLY);
+
+    status                     = new (status_shm->get_addr<void *>()) Coupler_Status::Status();
+    status->magic              = Coupler_Status::MAGIC;
+    status->version            = Coupler_Status::VERSION;
+    status->size               = sizeof(Coupler_Status::Status);
+    status->process_image_bits = process_image_bits;
+}
+
+std::unique_ptr<Image_Memory> WAGO_Modbus::TCP_Coupler_SHM::make_image_memory(const std::string   &name,
+                                                                                std::size_t          size,
+                                                                                Image_Memory::Access access) const {
+    if (handover_path.empty()) return std::make_unique<Image_Memory>(shm_prefix + name, size, shm_exclusive);
+    return std::make_unique<Image_Memory>(shm_prefix + name, size, access);
+}
+
+void WAGO_Modbus::TCP_Coupler_SHM::configure_watchdog() {
+    using Function = Modbus_Transport::Function;
+
+    // watchdog coding mask: bit n - 1 --> function code n triggers the watchdog
+    auto fc_bit = [](Function function) {
+        return static_cast<uint16_t>(1u << (static_cast<unsigned>(function) - 1u));
+    };
+
+    // use the requests of the cyclic transfers as trigger
+    uint16_t coding_mask = 0;
+    if (image_size[DO] || image_size[AO]) {
+        if (image_size[DO]) coding_mask |= fc_bit(Function::WRITE_MULTIPLE_COILS);
+        if (image_size[AO]) coding_mask |= fc_bit(Function::WRITE_MULTIPLE_REGISTERS);
+    } else {
+        if (image_size[DI]) coding_mask |= fc_bit(Function::READ_DISCRETE_INPUTS);
+        if (image_size[AI]) coding_mask |= fc_bit(Function::READ_INPUT_REGISTERS);
     }
 
-    // AO
-    if (image_size[AO]) {
-        memory_areas[AO].emplace_back(std::make_tuple(
-                ADDR_DATA_AO_1.first, std::min(ADDR_DATA_AO_1.second, image_size[AO]), static_cast<std::size_t>(0)));
+    // the watchdog time can only be changed while the watchdog is stopped
+    stop_watchdog();
 
-        if (image_size[AO] > ADDR_DATA_AO_1.second) {
-            memory_areas[AO].emplace_back(std::make_tuple(
-                    ADDR_DATA_AO_2.second, image_size[AO] - ADDR_DATA_AO_1.second, ADDR_DATA_AO_1.second));
+    const auto time = static_cast<uint16_t>((watchdog_timeout.count() + 99) / 100);  // unit: 100ms
+    modbus->write_ao(ADDR_WATCHDOG_TIME_RW.first, time);
+
+    // coding mask: first register FC 1 - 16, second register FC 17 - 32
+    modbus->write_ao(ADDR_WATCHDOG_CODING_MASK.first, coding_mask);
+    modbus->write_ao(static_cast<uint16_t>(ADDR_WATCHDOG_CODING_MASK.first + 1), static_cast<uint16_t>(0));
+
+    // start watchdog
+    modbus->write_ao(ADDR_WATCHDOG_TRIGGER.first, static_cast<uint16_t>(1));
+    watchdog_active = true;
+}
+
+void WAGO_Modbus::TCP_Coupler_SHM::stop_watchdog() {
+    // stop sequence
+    modbus->write_ao(ADDR_WATCHDOG_STOP.first, static_cast<uint16_t>(0xAAAA));
+    modbus->write_ao(ADDR_WATCHDOG_STOP.first, static_cast<uint16_t>(0x5555));
+}
+
+void WAGO_Modbus::TCP_Coupler_SHM::write_channel_map() {
+    static_assert(static_cast<std::size_t>(Channel_Map::DI) == DI && static_cast<std::size_t>(Channel_Map::DO) == DO &&
+                  static_cast<std::size_t>(Channel_Map::AI) == AI && static_cast<std::size_t>(Channel_Map::AO) == AO &&
+                  static_cast<std::size_t>(Channel_Map::IMAGES) == _REG_TYPES_SIZE_);
+
+    auto *data = channel_map->get_addr<uint8_t *>();
+
+    Channel_Map::Header header {};
+    header.magic       = Channel_Map::MAGIC;
+    header.version     = Channel_Map::VERSION;
+    header.clamp_count = static_cast<uint32_t>(clamps.size());
+    for (std::size_t t = 0; t < _REG_TYPES_SIZE_; ++t)
+        header.image_size[t] = image_size[t];
+    std::memcpy(data, &header, sizeof(header));
+    data += sizeof(header);
+
+    for (std::size_t i = 0; i < clamps.size(); ++i) {
+        Channel_Map::Entry entry {};
+        entry.index      = static_cast<uint16_t>(i);
+        entry.product_id = clamps.get_clampconfig(i);
+        switch (clamps.get_type(i)) {
+            case Clamp_Type::DIGITAL_INPUT: entry.type = Channel_Map::DIGITAL_INPUT; break;
+            case Clamp_Type::DIGITAL_OUTPUT: entry.type = Channel_Map::DIGITAL_OUTPUT; break;
+            case Clamp_Type::ANALOG: entry.type = Channel_Map::ANALOG; break;
+            default: throw std::logic_error("unknown module type");
         }
+        entry.data_type      = static_cast<uint8_t>(clamps.get_data_type(i));
+        entry.status_bytes   = static_cast<uint8_t>(clamps.get_status_bytes(i));
+        entry.control_bytes  = static_cast<uint8_t>(clamps.get_control_bytes(i));
+        entry.channels       = static_cast<uint16_t>(clamps.get_channels(i));
+        entry.counter_offset = static_cast<uint16_t>(counters.get_offset(i));
+        for (std::size_t t = 0; t < _REG_TYPES_SIZE_; ++t) {
+            const auto type = static_cast<reg_types_t>(t);
+            entry.size[t]   = static_cast<uint16_t>(clamps.get_size(i, type));
+            entry.offset[t] = static_cast<uint16_t>(clamps.get_offset(i, type));
+        }
+        std::memcpy(data, &entry, sizeof(entry));
+        data += sizeof(entry);
     }
 }
 
-void WAGO_Modbus::TCP_Coupler_SHM::check_constants() {
-    const auto result = modbus.read_ai({ADDR_CONSTANTS});
-    assert(result[0].size() == CONSTANTS.size());
+void WAGO_Modbus::TCP_Coupler_SHM::write_output_ownership() {
+    auto &header       = *new (owners->get_addr<void *>()) Output_Ownership::Header();
+    header.magic       = Output_Ownership::MAGIC;
+    header.version     = Output_Ownership::VERSION;
+    header.clamp_count = static_cast<uint32_t>(clamps.size());
+    header.ao_size     = image_size[AO];
+    header.do_size     = image_size[DO];
+
+    auto *slots = Output_Ownership::slots(header);
+    for (std::size_t i = 0; i < clamps.size(); ++i) {
+        auto &slot     = *new (slots + i) Output_Ownership::Slot();
+        slot.ao_offset = static_cast<uint16_t>(clamps.get_offset(i, AO));
+        slot.ao_size   = static_cast<uint16_t>(clamps.get_size(i, AO));
+        slot.do_offset = static_cast<uint16_t>(clamps.get_offset(i, DO));
+        slot.do_size   = static_cast<uint16_t>(clamps.get_size(i, DO));
+    }
 
-    for (std::size_t i = 0; i < std::min(CONSTANTS.size(), result[0].size()); ++i) {
-        if (endian::little_to_host(result[0][i]) != CONSTANTS[i]) {
-            std::ostringstream sstr;
-            sstr << std::hex << std::setfill('0') << std::right
-                 << "Modbus client is not a WAGO Modbus TCP Field Bus Coupler: Constant @0x" << std::setw(4)
-                 << (ADDR_CONSTANTS.first + i) << " does not match. Expected 0x" << std::setw(4) << CONSTANTS[i]
-                 << " but got 0x" << std::setw(4) << result[0][i];
-            throw std::runtime_error(sstr.str());
+    // the staged values are zero initialized by the shared memory
+    collected_sequence.assign(clamps.size(), 0);
+    owner_heartbeat.assign(clamps.size(), 0);
+    owner_silent_checks.assign(clamps.size(), 0);
+    output_conflicts = 0;
+}
+
+void WAGO_Modbus::TCP_Coupler_SHM::collect_outputs() {
+    auto       &header = *owners->get_addr<Output_Ownership::Header *>();
+    auto       *slots  = Output_Ownership::slots(header);
+    const auto *ao     = Output_Ownership::staged_ao(header);
+    const auto *do_    = Output_Ownership::staged_do(header);
+
+    for (std::size_t i = 0; i < clamps.size(); ++i) {
+        auto &slot = slots[i];
+        if (slot.owner.load(std::memory_order_acquire) == 0) continue;
+
+        // unchanged or write in progress
+        const auto sequence = slot.sequence.load(std::memory_order_acquire);
+        if (sequence == collected_sequence[i] || (sequence & 1u)) continue;
+
+        // the layout of the slot in the shared memory is not trusted: it can be modified by the writers
+        const auto ao_offset = clamps.get_offset(i, AO);
+        const auto ao_size   = clamps.get_size(i, AO);
+        const auto do_offset = clamps.get_offset(i, DO);
+        const auto do_size   = clamps.get_size(i, DO);
+        staged_ao.assign(ao + ao_offset, ao + ao_offset + ao_size);
+        staged_do.assign(do_ + do_offset, do_ + do_offset + do_size);
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot.sequence.load(std::memory_order_relaxed) != sequence) continue;
+
+        std::copy(staged_ao.begin(), staged_ao.end(), image[AO]->get_addr<uint16_t *>() + ao_offset);
+        std::copy(staged_do.begin(), staged_do.end(), image[DO]->get_addr<uint8_t *>() + do_offset);
+        collected_sequence[i] = sequence;
+    }
+
+    const auto conflicts = header.conflicts.load(std::memory_order_relaxed);
+    if (conflicts != output_conflicts) {
+        output_conflicts = conflicts;
+        begin_status_update();
+        status->output_conflicts = conflicts;
+        end_status_update();
+    }
+}
+
+void WAGO_Modbus::TCP_Coupler_SHM::release_stale_owners() {
+    auto &header = *owners->get_addr<Output_Ownership::Header *>();
+    auto *slots  = Output_Ownership::slots(header);
+
+    for (std::size_t i = 0; i < clamps.size(); ++i) {
+        auto &slot      = slots[i];
+        auto  owner     = slot.owner.load(std::memory_order_acquire);
+        auto  heartbeat = slot.heartbeat.load(std::memory_order_relaxed);
+        if (owner == 0 || heartbeat != owner_heartbeat[i]) {
+            owner_heartbeat[i]     = heartbeat;
+            owner_silent_checks[i] = 0;
+            continue;
         }
+
+        if (++owner_silent_checks[i] < Output_Ownership::LEASE_INTERVALS) continue;
+        slot.owner.compare_exchange_strong(owner, 0, std::memory_order_acq_rel);
+        owner_silent_checks[i] = 0;
     }
 }
 
-void WAGO_Modbus::TCP_Coupler_SHM::create_shm(const std::string &shm_prefix, bool exclusive) {
-    // DO
-    image[DO] = std::make_unique<cxxshm::SharedMemory>(
-            shm_prefix + "DO", image_size[DO] * sizeof(uint8_t), false, exclusive);
+WAGO_Modbus::Output_Transaction::Trailer *
+        WAGO_Modbus::TCP_Coupler_SHM::get_output_trailer(reg_types_t type) const noexcept {
+    const std::size_t value_size = type == DO ? sizeof(uint8_t) : sizeof(uint16_t);
+    return Output_Transaction::trailer(image[type]->get_addr<void *>(), image_size[type] * value_size);
+}
 
-    // DI
-    image[DI] = std::make_unique<cxxshm::SharedMemory>(
-            shm_prefix + "DI", image_size[DI] * sizeof(uint8_t), false, exclusive);
+void WAGO_Modbus::TCP_Coupler_SHM::copy_committed_outputs() {
+    if (copy_committed(DO, output_copy_do.data()))
+        std::copy(output_copy_do.begin(), output_copy_do.end(), committed_do.begin());
+    if (copy_committed(AO, output_copy_ao.data()))
+        std::copy(output_copy_ao.begin(), output_copy_ao.end(), committed_ao.begin());
+}
 
-    // AO
-    image[AO] = std::make_unique<cxxshm::SharedMemory>(
-            shm_prefix + "AO", image_size[AO] * sizeof(uint16_t), false, exclusive);
+bool WAGO_Modbus::TCP_Coupler_SHM::copy_committed(reg_types_t type, void *copy) {
+    const std::size_t value_size  = type == DO ? sizeof(uint8_t) : sizeof(uint16_t);
+    const void       *values      = image[type]->get_addr<const void *>();
+    auto             &trailer     = *get_output_trailer(type);
+    auto              copy_values = [&]() { std::memcpy(copy, values, image_size[type] * value_size); };
 
-    // AI
-    image[AI] = std::make_unique<cxxshm::SharedMemory>(
-            shm_prefix + "AI", image_size[AI] * sizeof(uint16_t), false, exclusive);
+    if (Output_Transaction::read_committed(trailer, copy_values)) {
+        uncommitted_cycles[type] = 0;
+        return true;
+    }
+    if (++uncommitted_cycles[type] < Output_Transaction::TIMEOUT_CYCLES) return false;
+
+    // writer terminated during a transaction or transactions of multiple writers overlap continuously
+    uint64_t aborts = 0;
+    for (auto &writer : trailer.writers) {
+        const auto sequence = writer.sequence.load(std::memory_order_acquire);
+        if ((sequence & 1u) && Output_Transaction::abort(writer, sequence)) ++aborts;
+    }
+    uncommitted_cycles[type] = 0;
+
+    if (aborts) {
+        transaction_aborts += aborts;
+        begin_status_update();
+        status->transaction_aborts = transaction_aborts;
+        end_status_update();
+    }
+
+    if (!Output_Transaction::read_committed(trailer, copy_values)) return false;
+    uncommitted_cycles[type] = 0;
+    return true;
+}
+
+void WAGO_Modbus::TCP_Coupler_SHM::seed_outputs() {
+    modbus->execute(transfers[READ_OUTPUTS]);
+    std::copy_n(image[DO]->get_addr<const uint8_t *>(), image_size[DO], committed_do.begin());
+    std::copy_n(image[AO]->get_addr<const uint16_t *>(), image_size[AO], committed_ao.begin());
+}
+
+void WAGO_Modbus::TCP_Coupler_SHM::prepare_transfers() {
+    using Function = Modbus_Transport::Function;
+
+    // build request list of one register type: the image is split into requests of at most one PDU per area
+    auto add_requests = [this](std::vector<Modbus_Transport::Request> &requests,
+                               reg_types_t                             type,
+                               Function                                function,
+                               uint8_t                                *data) {
+        const std::size_t value_size = (type == DI || type == DO) ? sizeof(uint8_t) : sizeof(uint16_t);
+        const std::size_t limit      = Modbus_Transport::max_request_size(function);
+        REGISTER_MAPS[type].plan(image_size[type], limit, [&](const Area_Planner::Request &request) {
+            requests.push_back({function, request.address, request.size, data + request.offset * value_size});
+        });
+    };
+
+    modbus->clear_prepared();
+
+    std::vector<Modbus_Transport::Request> read_inputs;
+    add_requests(read_inputs, DI, Function::READ_DISCRETE_INPUTS, image[DI]->get_addr<uint8_t *>());
+    add_requests(read_inputs, AI, Function::READ_INPUT_REGISTERS, image[AI]->get_addr<uint8_t *>());
+    transfers[READ_INPUTS] = modbus->prepare(read_inputs);
+
+    std::vector<Modbus_Transport::Request> read_outputs;
+    add_requests(read_outputs, DO, Function::READ_COILS, image[DO]->get_addr<uint8_t *>());
+    add_requests(read_outputs, AO, Function::READ_HOLDING_REGISTERS, image[AO]->get_addr<uint8_t *>());
+    transfers[READ_OUTPUTS] = modbus->prepare(read_outputs);
+
+    std::vector<Modbus_Transport::Request> write_outputs;
+    // the committed state is sent (see copy_committed_outputs)
+    add_requests(write_outputs, DO, Function::WRITE_MULTIPLE_COILS, committed_do.data());
+    add_requests(
+            write_outputs, AO, Function::WRITE_MULTIPLE_REGISTERS, reinterpret_cast<uint8_t *>(committed_ao.data()));
+    transfers[WRITE_OUTPUTS] = modbus->prepare(write_outputs);
 }
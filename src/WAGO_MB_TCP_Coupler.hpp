@@ -4,14 +4,25 @@
 
 #pragma once
 
-#include "Modbus_TCP_Server.hpp"
+#include "Analog_Scaling.hpp"
+#include "Area_Planner.hpp"
+#include "Change_Stream.hpp"
+#include "Counter_Decoder.hpp"
+#include "Coupler_Status.hpp"
+#include "Image_Memory.hpp"
+#include "Modbus_TCP_Gateway.hpp"
+#include "Modbus_Transport.hpp"
+#include "Output_Transaction.hpp"
+#include "Session_Recording.hpp"
+#include "Unix_Socket_Server.hpp"
 #include "WAGO_MB_Clamps.hpp"
-#include "cxxshm.hpp"
 
 #include <array>
+#include <chrono>
 #include <cstdint>
 #include <memory>
 #include <utility>
+#include <vector>
 
 namespace WAGO_Modbus {
 
@@ -20,11 +31,11 @@ private:
     static constexpr uint16_t    CLAMPCONFIG_ADDR = 0x2030;
     static constexpr std::size_t CLAMP_PACKET_LEN = 0x41;
 
-    [[maybe_unused]] static constexpr std::pair<uint16_t, std::size_t> ADDR_WATCHDOG_TIME_RW       = {0x1000, 1};
-    [[maybe_unused]] static constexpr std::pair<uint16_t, std::size_t> ADDR_WATCHDOG_CODING_MASK   = {0x1001, 2};
-    [[maybe_unused]] static constexpr std::pair<uint16_t, std::size_t> ADDR_WATCHDOG_TRIGGER       = {0x1003, 1};
+    static constexpr std::pair<uint16_t, std::size_t>                  ADDR_WATCHDOG_TIME_RW       = {0x1000, 1};
+    static constexpr std::pair<uint16_t, std::size_t>                  ADDR_WATCHDOG_CODING_MASK   = {0x1001, 2};
+    static constexpr std::pair<uint16_t, std::size_t>                  ADDR_WATCHDOG_TRIGGER       = {0x1003, 1};
     [[maybe_unused]] static constexpr std::pair<uint16_t, std::size_t> ADDR_WATCHDOG_TRIGGER_TIME  = {0x1004, 1};
-    [[maybe_unused]] static constexpr std::pair<uint16_t, std::size_t> ADDR_WATCHDOG_STOP          = {0x1005, 1};
+    static constexpr std::pair<uint16_t, std::size_t>                  ADDR_WATCHDOG_STOP          = {0x1005, 1};
     [[maybe_unused]] static constexpr std::pair<uint16_t, std::size_t> ADDR_WATCHDOG_STATUS        = {0x1006, 1};
     [[maybe_unused]] static constexpr std::pair<uint16_t, std::size_t> ADDR_RESTART_WATCHDOG       = {0x1007, 1};
     [[maybe_unused]] static constexpr std::pair<uint16_t, std::size_t> ADDR_STOP_WATCHDOG          = {0x1008, 1};
@@ -73,40 +84,196 @@ private:
     static constexpr std::pair<uint16_t, std::size_t> ADDR_DATA_DO_1 = {0x0200, 512};
     static constexpr std::pair<uint16_t, std::size_t> ADDR_DATA_DO_2 = {0x9000, 1527};
 
+    /**
+     * @brief address areas of the process data images (index: reg_types_t)
+     */
+    static constexpr std::array<Area_Planner::Register_Map<2>, _REG_TYPES_SIZE_> REGISTER_MAPS = {
+            Area_Planner::Register_Map<2>({ADDR_DATA_DI_1, ADDR_DATA_DI_2}),
+            Area_Planner::Register_Map<2>({ADDR_DATA_DO_1, ADDR_DATA_DO_2}),
+            Area_Planner::Register_Map<2>({ADDR_DATA_AI_1, ADDR_DATA_AI_2}),
+            Area_Planner::Register_Map<2>({ADDR_DATA_AO_1, ADDR_DATA_AO_2}),
+    };
+
+    // the second area continues the image at its own start address
+    static_assert(REGISTER_MAPS[DI].plan<2>(ADDR_DATA_DI_1.second + 1, Modbus_Transport::MAX_READ_BITS)[1].address ==
+                  ADDR_DATA_DI_2.first);
+    static_assert(
+            REGISTER_MAPS[AO].plan<4>(ADDR_DATA_AO_1.second + 1, Modbus_Transport::MAX_WRITE_REGISTERS)[3].offset ==
+            ADDR_DATA_AO_1.second);
+
+    // requests are split at the PDU limit and never span two areas
+    static_assert(REGISTER_MAPS[AI].plan<3>(ADDR_DATA_AI_1.second, Modbus_Transport::MAX_READ_REGISTERS)[2].size ==
+                  ADDR_DATA_AI_1.second - 2 * Modbus_Transport::MAX_READ_REGISTERS);
+    static_assert(REGISTER_MAPS[DO].plan<2>(ADDR_DATA_DO_1.second + 1, Modbus_Transport::MAX_WRITE_BITS)[0].size ==
+                  ADDR_DATA_DO_1.second);
+
+    // minimum number of requests: one per started PDU in each area
+    static_assert(REGISTER_MAPS[DI].request_count(0, Modbus_Transport::MAX_READ_BITS) == 0);
+    static_assert(REGISTER_MAPS[DI].request_count(ADDR_DATA_DI_1.second, Modbus_Transport::MAX_READ_BITS) == 1);
+    static_assert(REGISTER_MAPS[DI].request_count(REGISTER_MAPS[DI].capacity(), Modbus_Transport::MAX_READ_BITS) == 2);
+    static_assert(REGISTER_MAPS[AI].request_count(REGISTER_MAPS[AI].capacity(), Modbus_Transport::MAX_READ_REGISTERS) ==
+                  3 + 7);
+    static_assert(
+            REGISTER_MAPS[AO].request_count(REGISTER_MAPS[AO].capacity(), Modbus_Transport::MAX_WRITE_REGISTERS) ==
+            3 + 7);
+
+    /**
+     * @brief process image sizes in bits (AO, AI, DO, DI)
+     * @details used to detect added or removed modules
+     */
+    static constexpr std::pair<uint16_t, std::size_t> ADDR_PROCESS_IMAGE_BITS = {
+            ADDR_NUM_ANALOG_OUTPUT_IN_PROCESS_IMAGE.first,
+            ADDR_NUM_ANALOG_OUTPUT_IN_PROCESS_IMAGE.second + ADDR_NUM_ANALOG_INPUT_IN_PROCESS_IMAGE.second +
+                    ADDR_NUM_DIGITAL_OUTPUT_IN_PROCESS_IMAGE.second + ADDR_NUM_DIGITAL_INPUT_IN_PROCESS_IMAGE.second};
+    static_assert(ADDR_NUM_DIGITAL_INPUT_IN_PROCESS_IMAGE.first ==
+                  ADDR_PROCESS_IMAGE_BITS.first + ADDR_PROCESS_IMAGE_BITS.second - 1);
+
+    /**
+     * @brief diagnostics registers (one read per diagnostics step)
+     * @details the last step checks the process image sizes
+     */
+    static constexpr std::array<std::pair<uint16_t, std::size_t>, 4> DIAGNOSTICS_RANGES = {{
+            ADDR_DIAGNOSIS_IO_MODULES,
+            {ADDR_LED_ERROR_CODE.first, ADDR_LED_ERROR_CODE.second + ADDR_LED_ERROR_ARGUMENT.second},
+            ADDR_FIELDBUS_COUPLER_DIAGNOSTICS,
+            ADDR_PROCESS_IMAGE_BITS,
+    }};
+
     static constexpr std::pair<uint16_t, std::size_t> ADDR_CONSTANTS = {0x2000, 9};
     static constexpr std::array<uint16_t, 9>          CONSTANTS      = {
             0x0000, 0xFFFF, 0x1234, 0xAAAA, 0x5555, 0x7FFF, 0x8000, 0x3FFF, 0x4000};
 
     /**
-     * \brief process image register types
+     * @brief clamp configuration words as read from the coupler
+     */
+    std::vector<uint16_t> clamp_config {};
+
+    /**
+     * @brief process image sizes in bits as read together with clamp_config (see ADDR_PROCESS_IMAGE_BITS)
+     */
+    std::array<uint16_t, ADDR_PROCESS_IMAGE_BITS.second> process_image_bits {};
+
+    /**
+     * @brief known analog and complex modules
      */
-    enum reg_types_t { DI = 0, DO = 1, AI = 2, AO = 3, _REG_TYPES_SIZE_ };  // NOLINT
+    Clamp_Registry registry;
 
     /**
      * @brief list of connected modules
      */
-    std::vector<std::unique_ptr<WAGO_Modbus::Clamp>> clamps {};
+    Clamp_Table clamps;
 
     /**
      * @brief process data images
      */
-    std::array<std::unique_ptr<cxxshm::SharedMemory>, _REG_TYPES_SIZE_> image {};
+    std::array<std::unique_ptr<Image_Memory>, _REG_TYPES_SIZE_> image {};
+
+    /**
+     * @brief analog input image in engineering units (see Analog_Scaling)
+     */
+    std::unique_ptr<Image_Memory> image_eu {};
+
+    /**
+     * @brief decoded 32 bit values of complex modules (see Counter_Decoder)
+     */
+    std::unique_ptr<Image_Memory> image_cnt {};
+
+    /**
+     * @brief decoder of the 32 bit values of complex modules
+     */
+    Counter_Decoder counters;
+
+    /**
+     * @brief status shared memory (see Coupler_Status)
+     */
+    std::unique_ptr<Image_Memory> status_shm {};
+
+    /**
+     * @brief status in the status shared memory
+     */
+    Coupler_Status::Status *status = nullptr;
+
+    /**
+     * @brief location of the values of each module in the images (see Channel_Map)
+     */
+    std::unique_ptr<Image_Memory> channel_map {};
+
+    /**
+     * @brief output ownership of multiple writers (see Output_Ownership)
+     */
+    std::unique_ptr<Image_Memory> owners {};
+
+    /**
+     * @brief sequence of the staged output values of each module that was copied to the images by send_image
+     */
+    std::vector<uint32_t> collected_sequence;
+
+    std::vector<uint32_t>    owner_heartbeat;      //*< heartbeat of each module at the last lease check
+    std::vector<std::size_t> owner_silent_checks;  //*< lease checks without heartbeat of the owner of each module
+
+    std::vector<uint16_t> staged_ao;  //*< consistent copy of the staged AO values of one module
+    std::vector<uint8_t>  staged_do;  //*< consistent copy of the staged DO values of one module
+
+    uint64_t output_conflicts = 0;  //*< number of output ownership conflicts published in the status
+
+    std::vector<uint8_t>  committed_do;    //*< committed state of the DO image (sent to the coupler)
+    std::vector<uint16_t> committed_ao;    //*< committed state of the AO image (sent to the coupler)
+    std::vector<uint8_t>  output_copy_do;  //*< copy of the DO image that is checked by copy_committed_outputs
+    std::vector<uint16_t> output_copy_ao;  //*< copy of the AO image that is checked by copy_committed_outputs
+
+    /**
+     * @brief number of cycles since the last copy of a committed state (per output image, see Output_Transaction)
+     */
+    std::array<std::size_t, _REG_TYPES_SIZE_> uncommitted_cycles {};
+
+    uint64_t transaction_aborts = 0;  //*< number of aborted output transactions published in the status
+
+    /**
+     * @brief conversion of the analog input image to engineering units
+     */
+    Analog_Scaling scaling;
 
     /**
-     * @brief image sizes (registers)
+     * @brief image sizes (registers) (copy of clamps.get_image_sizes())
      */
     std::array<std::size_t, _REG_TYPES_SIZE_> image_size {};
 
     /**
-     * @brief list of modbus areas for each register type
-     * @details list contains tuples of:
-     *      - modbus address
-     *      - number of signals
-     *      - offset in process data image
+     * @brief prepared modbus transfers
+     */
+    enum transfer_t { READ_INPUTS = 0, READ_OUTPUTS = 1, WRITE_OUTPUTS = 2, _TRANSFER_SIZE_ };  // NOLINT
+
+    /**
+     * @brief handles of the prepared modbus transfers (see Modbus_Transport::prepare)
      */
-    std::array<std::vector<std::tuple<uint16_t, std::size_t, std::size_t>>, _REG_TYPES_SIZE_> memory_areas;
+    std::array<std::size_t, _TRANSFER_SIZE_> transfers {};
+
+    std::unique_ptr<Modbus_Transport> modbus;  //*< modbus transport instance (nullptr in replay mode)
+
+    std::unique_ptr<Session_Recorder> recorder;  //*< session recorder (nullptr if not recording)
+
+    std::unique_ptr<Modbus_TCP_Gateway> gateway;  //*< modbus server for other clients (nullptr if not used)
 
-    Modbus_TCP_Server modbus;  //*< modbus server instance
+    std::unique_ptr<Change_Stream> stream;  //*< change stream for socket subscribers (nullptr if not used)
+
+    std::string                         handover_path;           //*< memfd handover socket (empty: named shm)
+    bool                                handover_force = false;  //*< replace an existing handover socket file
+    std::unique_ptr<Unix_Socket_Server> handover;                //*< memfd handover socket (nullptr if not used)
+
+    std::chrono::milliseconds watchdog_timeout {0};     //*< fieldbus watchdog timeout (0: watchdog not used)
+    bool                      watchdog_active = false;  //*< watchdog was configured by init
+
+    bool match_coupler_tos = false;  //*< use the Modbus TOS of the coupler for the requests
+
+    std::chrono::milliseconds             diagnostics_interval {1000};  //*< interval of the diagnostics reads (0: off)
+    std::chrono::steady_clock::time_point diagnostics_due {};           //*< start time of the next diagnostics read
+    std::size_t                           diagnostics_step = 0;         //*< next entry of DIAGNOSTICS_RANGES
+    std::chrono::nanoseconds              diagnostics_duration {};      //*< expected duration of a diagnostics step
+    std::chrono::steady_clock::time_point lease_check_due {};           //*< time of the next output ownership check
+
+    std::string shm_prefix;              //*< name prefix of the shared memories (required to recreate them)
+    bool        shm_exclusive     = true;  //*< create shared memories exclusively
+    uint64_t    layout_generation = 0;     //*< number of layout changes (see relayout)
 
     bool initialized = false;  //*< initialized flag
 
@@ -121,24 +288,49 @@ public:
      */
     explicit TCP_Coupler_SHM(const std::string &host, const std::string &service = "502", bool debug = false);
 
+    /**
+     * @brief Construct new WAGO_Modbus::TCP_Coupler object that uses the given transport
+     * @details allows to run the cycle engine with any Modbus_Transport implementation (e.g. Modbus_Memory_Transport)
+     * @param transport modbus transport instance (not connected)
+     *
+     * @exception std::invalid_argument transport is nullptr
+     */
+    explicit TCP_Coupler_SHM(std::unique_ptr<Modbus_Transport> transport);
+
+    /**
+     * @brief Construct new WAGO_Modbus::TCP_Coupler object without connection to a coupler
+     * @details the process data images can only be driven by a recorded session (see init_replay)
+     */
+    TCP_Coupler_SHM();
+
     ~TCP_Coupler_SHM();
 
     /**
      * @brief initialize connection to coupler
      * @param shm_prefix name prefix of the shared memory objects
-     *      creates four shared memories:
-     *          - <shm_prefix>do
-     *          - <shm_prefix>di
-     *          - <shm_prefix>ao
-     *          - <shm_prefix>ai
+     *      creates nine shared memories:
+     *          - <shm_prefix>DO
+     *          - <shm_prefix>DI
+     *          - <shm_prefix>AO
+     *          - <shm_prefix>AI
+     *          - <shm_prefix>AI_EU (analog inputs in engineering units, float)
+     *          - <shm_prefix>CNT (32 bit values of counters and other complex modules, uint32_t)
+     *          - <shm_prefix>MAP (location of the values of each module, see Channel_Map)
+     *          - <shm_prefix>STATUS (diagnostics and state of the coupler, see Coupler_Status)
+     *          - <shm_prefix>OWNERS (output ownership of multiple writers, see Output_Ownership)
      * @param exclusive fail if a shared memory with the same name already exists
      *
      * @exception system_error thrown if one of the system calls shm_open, fstat, ftruncate or mmap failed
+     * @exception std::system_error failed to create the memfd handover socket (see set_memfd_handover)
+     * @exception std::runtime_error memfd handover socket path too long
+     * @exception std::system_error failed to set a socket option (see Modbus_Transport::set_socket_options)
      * @exception std::logic_error already connected to modbus client
      * @exception std::runtime_error failed to connect to modbus client
      * @exception std::runtime_error failed to read from modbus client
      * @exception std::runtime_error unknown digital clamp type
+     * @exception std::runtime_error Unknown product ID for analog clamp
      * @exception std::runtime_error no clamps detected
+     * @exception std::runtime_error scaling configured for a module that is not an analog input module
      * @exception std::runtime_error Modbus client is not a WAGO Modbus TCP Field Bus Coupler: ...
      * @exception std::runtime_error no valid modbus context (should never happen --> fatal error)
      * @exception std::logic_error not connected to modbus client (should not happen)
@@ -146,6 +338,199 @@ public:
      */
     void init(const std::string &shm_prefix = "wago_", bool exclusive = true);
 
+    /**
+     * @brief initialize images from a recorded session instead of a coupler
+     * @details creates the same shared memories as init, using the clamp configuration of the recording
+     * @param player recorded session
+     * @param shm_prefix name prefix of the shared memory objects
+     * @param exclusive fail if a shared memory with the same name already exists
+     *
+     * @exception system_error thrown if one of the system calls shm_open, fstat, ftruncate or mmap failed
+     * @exception std::system_error failed to create the memfd handover socket (see set_memfd_handover)
+     * @exception std::runtime_error memfd handover socket path too long
+     * @exception std::logic_error already initialized
+     * @exception std::runtime_error unknown digital clamp type
+     * @exception std::runtime_error Unknown product ID for analog clamp
+     * @exception std::runtime_error no clamps detected
+     * @exception std::runtime_error image size of recording does not match clamp configuration
+     * @exception std::runtime_error scaling configured for a module that is not an analog input module
+     */
+    void init_replay(Session_Player &player, const std::string &shm_prefix = "wago_", bool exclusive = true);
+
+    /**
+     * @brief use the fieldbus watchdog of the coupler
+     * @details
+     *      must be called before init.
+     *      init configures the watchdog. Its coding mask contains the function codes of the cyclic transfers
+     *      (writes if there are outputs, reads otherwise), so every fetch_image / send_image triggers the watchdog
+     *      without an additional request. If no cyclic transfer is received within the timeout,
+     *      the coupler sets the outputs to the safe state. The watchdog is stopped by disconnect.
+     * @param timeout watchdog timeout (rounded up to 100ms; 0: watchdog not used)
+     *
+     * @exception std::logic_error already initialized
+     * @exception std::out_of_range watchdog timeout out of range
+     */
+    void set_watchdog(std::chrono::milliseconds timeout);
+
+    /**
+     * @brief use the Modbus TOS configured on the coupler (register 0x1038) for the requests
+     * @details
+     *      must be called before init. init reads the TOS of the coupler and sets it as IP TOS / traffic class of the
+     *      modbus socket (see Modbus_Transport::Socket_Options), so requests and responses are prioritized alike.
+     * @param enable match the TOS of the coupler
+     *
+     * @exception std::logic_error already initialized
+     */
+    void set_match_coupler_tos(bool enable);
+
+    /**
+     * @brief set interval of the diagnostics reads
+     * @details must be called before init
+     * @param interval interval of the diagnostics reads (0: disabled)
+     *
+     * @exception std::logic_error already initialized
+     * @exception std::out_of_range interval out of range
+     */
+    void set_diagnostics_interval(std::chrono::milliseconds interval);
+
+    /**
+     * @brief create the shared memories as sealed memfds and hand them to consumers on a Unix domain socket
+     * @details
+     *      must be called before init.
+     *      The memfds have no name in the file system, so they can not become orphans and the exclusive parameter of
+     *      init does not apply to them. Each consumer that connects to the socket receives the file descriptors of
+     *      all shared memories with one message (see Image_Handover). The size of the memfds is sealed.
+     *      Input images, the channel map and the status can not be mapped writable by consumers.
+     *      Waiting consumers are served after each fetch_image / replay_image call.
+     * @param path path of the socket file
+     * @param force remove an existing socket file
+     *
+     * @exception std::logic_error already initialized
+     */
+    void set_memfd_handover(const std::string &path, bool force);
+
+    /**
+     * @brief read coupler diagnostics if due and if there is enough time left
+     * @details
+     *      The diagnostics registers are read in steps of one request.
+     *      A step is only executed if it is expected to be finished before the deadline,
+     *      so the diagnostics can be done in the idle time of the cycle without delaying the next image transfer.
+     *      The values are published in the status shared memory. Failed reads are counted.
+     *
+     *      The last step compares the process image sizes with the sizes read at init. If they differ
+     *      (module added, removed or failed), the process data images are recreated with the new layout
+     *      (see get_layout_generation). A running recording is stopped, as its image sizes are no longer valid.
+     * @param deadline time at which the next image transfer starts
+     * @return true if a diagnostics step was executed
+     *
+     * @exception std::logic_error not initialized
+     * @exception std::runtime_error failed to read from modbus client (new layout)
+     * @exception std::runtime_error unknown digital clamp type (new layout)
+     * @exception std::runtime_error Unknown product ID for analog clamp (new layout)
+     * @exception std::runtime_error no clamps detected (new layout)
+     * @exception std::runtime_error scaling configured for a module that is not an analog input module (new layout)
+     * @exception std::runtime_error failed to write to modbus client (watchdog configuration)
+     * @exception system_error thrown if one of the system calls shm_open, fstat, ftruncate or mmap failed
+     */
+    bool poll_diagnostics(
+            std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::time_point::max());
+
+    /**
+     * @brief expected duration of the diagnostics read in the idle time of the next cycle
+     * @details
+     *      0 if the diagnostics are disabled or no diagnostics step is due. Can be used as reserve of an adaptive cycle
+     *      time.
+     */
+    [[nodiscard]] inline std::chrono::nanoseconds get_diagnostics_duration() const noexcept {
+        if (diagnostics_interval.count() == 0) return std::chrono::nanoseconds(0);
+        if (diagnostics_step == 0 && std::chrono::steady_clock::now() < diagnostics_due)
+            return std::chrono::nanoseconds(0);
+        return diagnostics_duration;
+    }
+
+    /**
+     * @brief publish the cycle time and the latency of the transfers (if measured) in the status shared memory
+     * @param period effective cycle time (0: as fast as possible)
+     * @param duration average duration of the image transfers of a cycle
+     *
+     * @exception std::logic_error not initialized
+     */
+    void publish_cycle_time(std::chrono::nanoseconds period, std::chrono::nanoseconds duration);
+
+    /**
+     * @brief number of layout changes since init
+     * @details incremented each time the process data images were recreated because the modules changed
+     */
+    [[nodiscard]] inline uint64_t get_layout_generation() const noexcept { return layout_generation; }
+
+    /**
+     * @brief check whether a session is recorded
+     */
+    [[nodiscard]] inline bool is_recording() const noexcept { return static_cast<bool>(recorder); }
+
+    /**
+     * @brief load descriptors of additional analog or complex modules
+     * @details must be called before init / init_replay. See Clamp_Registry::load_config for the file format.
+     * @param path path of the configuration file
+     *
+     * @exception std::logic_error already initialized
+     * @exception std::runtime_error failed to open module configuration
+     * @exception std::runtime_error invalid module configuration
+     */
+    void load_clamp_config(const std::string &path);
+
+    /**
+     * @brief load scaling configuration of the analog input modules
+     * @details must be called before init / init_replay. See Analog_Scaling::load_config for the file format.
+     * @param path path of the configuration file
+     *
+     * @exception std::logic_error already initialized
+     * @exception std::runtime_error failed to open scaling configuration
+     * @exception std::runtime_error invalid scaling configuration
+     */
+    void load_scaling_config(const std::string &path);
+
+    /**
+     * @brief record the input images of every subsequent fetch_image call
+     * @param path path of the recording file (an existing file is overwritten)
+     *
+     * @exception std::logic_error not initialized
+     * @exception std::runtime_error failed to create recording file
+     * @exception std::runtime_error failed to write to recording file
+     */
+    void start_recording(const std::string &path);
+
+    /**
+     * @brief serve the process data images to other modbus clients (see Modbus_TCP_Gateway)
+     * @details
+     *      The coupler only sees one client, regardless of the number of gateway clients.
+     *      The served images follow layout changes. The gateway is stopped by disconnect.
+     * @param host listen address
+     * @param service listen port or service
+     * @param max_clients maximum number of connected clients
+     *
+     * @exception std::logic_error not initialized
+     * @exception std::logic_error gateway already started
+     * @exception std::runtime_error failed to create modbus instance
+     * @exception std::runtime_error failed to listen for modbus clients
+     * @exception std::system_error failed to create epoll instance / eventfd / server thread
+     */
+    void start_gateway(const std::string &host, const std::string &service, std::size_t max_clients);
+
+    /**
+     * @brief stream the changed values of every subsequent fetch_image / replay_image call (see Change_Stream)
+     * @details The stream follows layout changes. The stream is stopped by disconnect.
+     * @param path path of the socket file
+     * @param force remove an existing socket file
+     * @param queue_limit maximum number of queued bytes per subscriber
+     *
+     * @exception std::logic_error not initialized
+     * @exception std::logic_error change stream already started
+     * @exception std::runtime_error socket path too long
+     * @exception std::system_error failed to create listening socket
+     */
+    void start_change_stream(const std::string &path, bool force, std::size_t queue_limit);
+
     /**
      * @brief disconnect from Coupler
      *
@@ -164,6 +549,16 @@ public:
      */
     void fetch_image(bool include_outputs = false);
 
+    /**
+     * @brief store the current frame of a recorded session in the input images
+     * @details use Session_Player::next_frame to advance to the next frame
+     * @param player recorded session
+     *
+     * @exception std::logic_error not initialized
+     * @exception std::runtime_error recording file truncated
+     */
+    void replay_image(Session_Player &player);
+
     /**
      * @brief write output image to Coupler
      * @details image will only be written if the data was changed
@@ -251,14 +646,16 @@ public:
      * @return vector of strings. One string per value.
      *
      * @exception std::logic_error not initialized
+     * @exception std::logic_error no coupler connection (replay mode)
      */
     [[nodiscard]] std::vector<std::string> get_coupler_info() const;
 
 private:
     /**
-     * @brief read clamp config from Coupler
+     * @brief read clamp config and process image sizes from Coupler
      *
      * @exception std::runtime_error unknown digital clamp type
+     * @exception std::runtime_error Unknown product ID for analog clamp
      * @exception std::runtime_error no clamps detected.
      * @exception std::runtime_error failed to read from modbus client
      * @exception std::logic_error not connected to modbus client (should not happen)
@@ -266,6 +663,17 @@ private:
      */
     void read_clamp_config();
 
+    /**
+     * @brief create clamp list, image sizes, scaling parameters and counter decoder from clamp_config
+     *
+     * @exception std::runtime_error unknown digital clamp type
+     * @exception std::runtime_error Unknown product ID for analog clamp
+     * @exception std::runtime_error no clamps detected.
+     * @exception std::runtime_error process data image too large
+     * @exception std::runtime_error scaling configured for a module that is not an analog input module
+     */
+    void parse_clamp_config();
+
     /**
      * @brief check the Coupler constants
      * @details There are constant values in some registers of the Coupler.
@@ -281,13 +689,157 @@ private:
     void check_constants();
 
     /**
-     * @brief create shared memories for image
-     * @param shm_prefix name prefix for shared memories
-     * @param exclusive fail if a shared memory with the same name already exists
+     * @brief create shared memories for image (uses shm_prefix and shm_exclusive)
+     * @details existing image shared memories are removed before they are created again
+     *
+     * @exception std::system_error thrown if one of the system calls shm_open / memfd_create, fstat or mmap failed
+     */
+    void create_shm();
+
+    /**
+     * @brief create status shared memory (uses shm_prefix and shm_exclusive)
      *
+     * @exception std::system_error thrown if one of the system calls shm_open / memfd_create, fstat or mmap failed
+     */
+    void create_status_shm();
+
+    /**
+     * @brief read the module configuration again and recreate images and transfers with the new layout
+     * @details
+     *      The output images are initialized with the current outputs of the coupler (see seed_outputs).
+     *      Increments the layout generation in the status shared memory.
+     *
+     * @exception std::runtime_error failed to read from modbus client
+     * @exception std::runtime_error failed to write to modbus client (watchdog configuration)
+     * @exception std::runtime_error unknown digital clamp type
+     * @exception std::runtime_error Unknown product ID for analog clamp
+     * @exception std::runtime_error no clamps detected.
+     * @exception std::runtime_error scaling configured for a module that is not an analog input module
      * @exception std::system_error thrown if one of the system calls shm_open, fstat or mmap failed
      */
-    void create_shm(const std::string &shm_prefix, bool exclusive);
+    void relayout();
+
+    /**
+     * @brief configure and start the fieldbus watchdog (see set_watchdog)
+     *
+     * @exception std::runtime_error failed to write to modbus client
+     */
+    void configure_watchdog();
+
+    /**
+     * @brief stop the fieldbus watchdog
+     *
+     * @exception std::runtime_error failed to write to modbus client
+     */
+    void stop_watchdog();
+
+    /**
+     * @brief execute the next diagnostics step and publish the result in the status shared memory
+     */
+    void diagnostics_step_read();
+
+    /**
+     * @brief start modification of the status shared memory (sequence lock)
+     */
+    void begin_status_update() noexcept;
+
+    /**
+     * @brief finish modification of the status shared memory (sequence lock)
+     */
+    void end_status_update() noexcept;
+
+    /**
+     * @brief images served by the gateway
+     */
+    [[nodiscard]] Modbus_TCP_Gateway::Images get_gateway_images() const;
+
+    /**
+     * @brief send the changed values to the change stream subscribers and hand the memfds to waiting consumers
+     */
+    void serve_consumers();
+
+    /**
+     * @brief create an image shared memory (named shared memory or memfd, see set_memfd_handover)
+     * @param name name suffix
+     * @param size size in bytes
+     * @param access access of the consumers (only memfd)
+     */
+    [[nodiscard]] std::unique_ptr<Image_Memory>
+            make_image_memory(const std::string &name, std::size_t size, Image_Memory::Access access) const;
+
+    /**
+     * @brief send the memfds to all waiting consumers (see Image_Handover)
+     */
+    void handover_images();
+
+    /**
+     * @brief write the location of the values of each module to the channel map
+     * @details must be called after the shared memories are created
+     *
+     * @exception std::logic_error unknown module type
+     */
+    void write_channel_map();
+
+    /**
+     * @brief initialize the output ownership shared memory (no module is owned)
+     * @details must be called after the shared memories are created
+     */
+    void write_output_ownership();
+
+    /**
+     * @brief copy the staged output values of the owned modules to the images (see Output_Ownership)
+     * @details
+     *      Only values that were completely staged since the last call are copied.
+     *      Values that are staged during the call are copied by the next call.
+     */
+    void collect_outputs();
+
+    /**
+     * @brief release the output ownership of writers that did not renew their lease (see Output_Ownership)
+     * @details called once per diagnostics interval
+     */
+    void release_stale_owners();
+
+    /**
+     * @brief get the transaction trailer of an output image (DO or AO)
+     */
+    [[nodiscard]] Output_Transaction::Trailer *get_output_trailer(reg_types_t type) const noexcept;
+
+    /**
+     * @brief copy the output images to the committed state if no output transaction is in progress
+     * @details if a transaction is in progress, the committed state keeps the values of the previous call
+     */
+    void copy_committed_outputs();
+
+    /**
+     * @brief copy a committed state of an output image (DO or AO)
+     * @details
+     *      If no committed state could be copied for Output_Transaction::TIMEOUT_CYCLES calls, the transactions in
+     *      progress are aborted and the copy is retried.
+     * @param type image type
+     * @param copy destination of the image values
+     * @return false if a transaction was in progress (copy must not be used)
+     */
+    bool copy_committed(reg_types_t type, void *copy);
+
+    /**
+     * @brief read the current outputs of the coupler into the new output images and use them as committed state
+     * @details
+     *      Called after the images were recreated (see relayout). Without it the next send_image would send the zero
+     *      initialized images and reset all outputs of the coupler.
+     *
+     * @exception std::runtime_error failed to read from modbus client
+     */
+    void seed_outputs();
+
+    /**
+     * @brief prepare the modbus transfers of the process data images
+     * @details must be called after the shared memories are created
+     *
+     * @exception std::out_of_range resulting address out of range (should not happen)
+     * @exception std::out_of_range too many values in one request
+     */
+    void prepare_transfers();
 };
 
 }  // namespace WAGO_Modbus
@@ -19,6 +19,14 @@
 
 #include <cstddef>
 #include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+#if defined(__SSE2__) || defined(__AVX2__)
+#    include <immintrin.h>
+#elif defined(__ARM_NEON)
+#    include <arm_neon.h>
+#endif
 
 static_assert(sizeof(uint8_t) == 1);
 
@@ -46,6 +54,7 @@ public:
 
 /**
  * @brief swap endianness
+ * @details uses the byte swap builtins of the compiler for trivially copyable types with 2, 4 or 8 bytes
  * @tparam T data type
  * @param i input
  * @return swapped endianness
@@ -54,6 +63,28 @@ template <typename T>
 [[maybe_unused]] static T swap(const T &i) {
     T ret;
 
+#if defined(__GNUC__)
+    if constexpr (std::is_trivially_copyable_v<T> && (sizeof(T) == 2 || sizeof(T) == 4 || sizeof(T) == 8)) {
+        if constexpr (sizeof(T) == 2) {
+            uint16_t tmp;
+            std::memcpy(&tmp, &i, sizeof(T));
+            tmp = __builtin_bswap16(tmp);
+            std::memcpy(&ret, &tmp, sizeof(T));
+        } else if constexpr (sizeof(T) == 4) {
+            uint32_t tmp;
+            std::memcpy(&tmp, &i, sizeof(T));
+            tmp = __builtin_bswap32(tmp);
+            std::memcpy(&ret, &tmp, sizeof(T));
+        } else {
+            uint64_t tmp;
+            std::memcpy(&tmp, &i, sizeof(T));
+            tmp = __builtin_bswap64(tmp);
+            std::memcpy(&ret, &tmp, sizeof(T));
+        }
+        return ret;
+    }
+#endif
+
     auto *dst = reinterpret_cast<uint8_t *>(&ret);
     auto *src = reinterpret_cast<const uint8_t *>(&i + 1);
 
@@ -203,4 +234,164 @@ template <typename T>
     return little_to_host(l);
 }
 
+namespace detail {
+
+/**
+ * @brief swap endianness of n values with a size of N bytes
+ * @details
+ *      vectorized with AVX2, SSSE3, SSE2 or NEON if enabled at compile time (e.g. by -march=native).
+ *      The remaining values are converted by the scalar swap.
+ *      src and dst may be identical (in place conversion), but must not overlap otherwise
+ * @tparam T data type with a size of N bytes
+ * @param dst destination (space for at least n values)
+ * @param src source (at least n values)
+ * @param n number of values
+ */
+template <typename T>
+[[maybe_unused]] static void swap_n(uint8_t *dst, const uint8_t *src, std::size_t n) {
+    constexpr std::size_t N = sizeof(T);
+    std::size_t           i = 0;  // number of converted values
+
+    if constexpr (N == 1) {
+        if (dst != src) std::memcpy(dst, src, n);
+        return;
+    }
+
+#if defined(__AVX2__)
+    if constexpr (N == 2 || N == 4 || N == 8) {
+        // byte indices of the reversed values within each 128 bit lane
+        const __m256i shuffle = N == 2 ? _mm256_setr_epi8(1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14,
+                                                          1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14)
+                              : N == 4 ? _mm256_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12,
+                                                          3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12)
+                                       : _mm256_setr_epi8(7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8,
+                                                          7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8);
+        for (; (i + 32 / N) <= n; i += 32 / N) {
+            __m256i v;
+            std::memcpy(&v, src + i * N, sizeof(v));
+            v = _mm256_shuffle_epi8(v, shuffle);
+            std::memcpy(dst + i * N, &v, sizeof(v));
+        }
+    }
+#endif
+
+#if defined(__SSSE3__)
+    if constexpr (N == 2 || N == 4 || N == 8) {
+        const __m128i shuffle = N == 2   ? _mm_setr_epi8(1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14)
+                                : N == 4 ? _mm_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12)
+                                         : _mm_setr_epi8(7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8);
+        for (; (i + 16 / N) <= n; i += 16 / N) {
+            __m128i v;
+            std::memcpy(&v, src + i * N, sizeof(v));
+            v = _mm_shuffle_epi8(v, shuffle);
+            std::memcpy(dst + i * N, &v, sizeof(v));
+        }
+    }
+#elif defined(__SSE2__)
+    if constexpr (N == 2) {
+        for (; i + 8 <= n; i += 8) {
+            __m128i v;
+            std::memcpy(&v, src + i * N, sizeof(v));
+            v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+            std::memcpy(dst + i * N, &v, sizeof(v));
+        }
+    }
+#elif defined(__ARM_NEON)
+    if constexpr (N == 2 || N == 4 || N == 8) {
+        for (; (i + 16 / N) <= n; i += 16 / N) {
+            uint8x16_t v = vld1q_u8(src + i * N);
+            if constexpr (N == 2) v = vrev16q_u8(v);
+            else if constexpr (N == 4) v = vrev32q_u8(v);
+            else v = vrev64q_u8(v);
+            vst1q_u8(dst + i * N, v);
+        }
+    }
+#endif
+
+    for (; i < n; ++i) {
+        T value;
+        std::memcpy(&value, src + i * N, N);
+        value = endian::swap(value);
+        std::memcpy(dst + i * N, &value, N);
+    }
+}
+
+}  // namespace detail
+
+/**
+ * @brief swap endianness of multiple values
+ * @details
+ *      vectorized with AVX2, SSSE3, SSE2 or NEON if enabled at compile time (e.g. by -march=native)
+ *      src and dst may be identical (in place conversion), but must not overlap otherwise
+ * @tparam T data type
+ * @param dst destination (space for at least n values)
+ * @param src source (at least n values)
+ * @param n number of values
+ */
+template <typename T>
+[[maybe_unused]] static void swap_n(T *dst, const T *src, std::size_t n) {
+    static_assert(std::is_trivially_copyable_v<T>, "bulk conversion requires a trivially copyable type");
+    detail::swap_n<T>(reinterpret_cast<uint8_t *>(dst), reinterpret_cast<const uint8_t *>(src), n);
+}
+
+/**
+ * @brief convert multiple values from big endian to host endian
+ * @details src and dst may be identical (in place conversion), but must not overlap otherwise
+ * @tparam T data type
+ * @param dst destination (space for at least n values)
+ * @param src source (at least n values)
+ * @param n number of values
+ */
+template <typename T>
+[[maybe_unused]] static void big_to_host_n(T *dst, const T *src, std::size_t n) {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    if (dst != src) std::memcpy(dst, src, n * sizeof(T));
+#else
+    swap_n(dst, src, n);
+#endif
+}
+
+/**
+ * @brief convert multiple values from host endian to big endian
+ * @details src and dst may be identical (in place conversion), but must not overlap otherwise
+ * @tparam T data type
+ * @param dst destination (space for at least n values)
+ * @param src source (at least n values)
+ * @param n number of values
+ */
+template <typename T>
+[[maybe_unused]] static void host_to_big_n(T *dst, const T *src, std::size_t n) {
+    big_to_host_n(dst, src, n);
+}
+
+/**
+ * @brief convert multiple values from little endian to host endian
+ * @details src and dst may be identical (in place conversion), but must not overlap otherwise
+ * @tparam T data type
+ * @param dst destination (space for at least n values)
+ * @param src source (at least n values)
+ * @param n number of values
+ */
+template <typename T>
+[[maybe_unused]] static void little_to_host_n(T *dst, const T *src, std::size_t n) {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    swap_n(dst, src, n);
+#else
+    if (dst != src) std::memcpy(dst, src, n * sizeof(T));
+#endif
+}
+
+/**
+ * @brief convert multiple values from host endian to little endian
+ * @details src and dst may be identical (in place conversion), but must not overlap otherwise
+ * @tparam T data type
+ * @param dst destination (space for at least n values)
+ * @param src source (at least n values)
+ * @param n number of values
+ */
+template <typename T>
+[[maybe_unused]] static void host_to_little_n(T *dst, const T *src, std::size_t n) {
+    little_to_host_n(dst, src, n);
+}
+
 }  // namespace endian
@@ -5,11 +5,13 @@
 
 #include "license.hpp"
 
+#include <algorithm>
 #include <array>
 #include <chrono>
 #include <csignal>
 #include <filesystem>
 #include <iostream>
+#include <memory>
 #include <sysexits.h>
 #include <thread>
 #include <unistd.h>
@@ -31,6 +33,10 @@
 #    pragma GCC diagnostic pop
 #endif
 
+#include "Async_Logger.hpp"
+#include "Cycle_Controller.hpp"
+#include "Modbus_Raw_TCP.hpp"
+#include "Modbus_TCP_Server.hpp"
 #include "Print_Time.hpp"
 #include "WAGO_MB_TCP_Coupler.hpp"
 
@@ -80,16 +86,104 @@ int main(int argc, char **argv) {
                           "It should only be used if the shared memory of an improperly terminated instance continues "
                           "to exist as an orphan and is no longer used.");
     options.add_options()("q,quiet", "Disable output");
-    options.add_options()("d,debug", "Enable modbus debug output");
+    options.add_options()("d,debug", "Enable modbus debug output (libmodbus backend only)");
+    options.add_options()("b,backend",
+                          "modbus backend: 'libmodbus' or 'raw' (precomputed request frames, pipelined requests and "
+                          "responses decoded directly into the shared memory)",
+                          cxxopts::value<std::string>()->default_value("libmodbus"));
+    options.add_options()("no-pipelining",
+                          "raw backend: wait for each response before the next request is sent. "
+                          "Use this option for couplers that can not handle multiple outstanding requests.");
+    options.add_options()("quickack",
+                          "re-arm TCP_QUICKACK after each response, so the acknowledgements of the responses are not "
+                          "delayed");
+    options.add_options()("busy-poll",
+                          "busy poll the modbus socket for the given time in µs while waiting for a response "
+                          "(SO_BUSY_POLL; values above net.core.busy_read require CAP_NET_ADMIN) (0: disabled)",
+                          cxxopts::value<int>()->default_value("0"));
+    options.add_options()("socket-priority",
+                          "SO_PRIORITY of the modbus socket (-1: default)",
+                          cxxopts::value<int>()->default_value("-1"));
+    options.add_options()("tos",
+                          "IP TOS / traffic class of the modbus requests: 0 ... 255 (DSCP << 2), 'coupler' (use the "
+                          "Modbus TOS configured on the coupler) or 'default'",
+                          cxxopts::value<std::string>()->default_value("default"));
+    options.add_options()("response-timeout",
+                          "timeout of a modbus response in ms",
+                          cxxopts::value<std::size_t>()->default_value("500"));
+    options.add_options()("byte-timeout",
+                          "libmodbus backend: timeout between the bytes of a modbus response in ms (0: disabled)",
+                          cxxopts::value<std::size_t>()->default_value("500"));
+    options.add_options()("timestamping",
+                          "raw backend: measure the latency of the transfers with kernel socket timestamps "
+                          "(hardware timestamps if available). The latency is published in the shared memory "
+                          "<prefix>STATUS.");
     options.add_options()("c,cycle",
                           "set cycle time in ms (default: 0; as fast as possible)",
                           cxxopts::value<std::size_t>()->default_value("0"));
+    options.add_options()("cycle-max",
+                          "enable the adaptive cycle time: the cycle time is adjusted to the measured duration of the "
+                          "cycles, but not above the given value in ms (default: 0; disabled). --cycle is used as "
+                          "initial cycle time.",
+                          cxxopts::value<std::size_t>()->default_value("0"));
+    options.add_options()("cycle-min",
+                          "lower limit of the adaptive cycle time in ms",
+                          cxxopts::value<std::size_t>()->default_value("0"));
+    options.add_options()("watchdog",
+                          "enable the fieldbus watchdog of the coupler with the given timeout in ms (multiple of 100). "
+                          "The coupler sets the outputs to the safe state if no cycle is completed within the timeout.",
+                          cxxopts::value<std::size_t>()->default_value("0"));
+    options.add_options()("diagnostics",
+                          "interval of the coupler diagnostics reads in ms (0: disabled). "
+                          "The diagnostics are read in the idle time of the cycle and published in the shared memory "
+                          "<prefix>STATUS. Without cycle time (--cycle 0) there is no idle time: the diagnostics are "
+                          "only read if this option is given explicitly, they delay the next cycle.",
+                          cxxopts::value<std::size_t>()->default_value("1000"));
     options.add_options()("no-cycle-time-fail", "Do not fail if the cycle time is repeatedly exceeded");
     options.add_options()("no-cycle-time-warn", "Do not print a warning if the cycle time is exceeded");
     options.add_options()("read-start-image",
                           "do not initialize output registers with zero, but read values from coupler");
     options.add_options()(
             "p,prefix", "name prefix for the shared memories", cxxopts::value<std::string>()->default_value("wago_"));
+    options.add_options()("clamp-config",
+                          "load descriptors of additional analog or complex modules from the given file",
+                          cxxopts::value<std::string>());
+    options.add_options()("scaling",
+                          "load scaling parameters of the analog input modules from the given file. "
+                          "The scaled values are stored in the shared memory <prefix>AI_EU.",
+                          cxxopts::value<std::string>());
+    options.add_options()(
+            "record", "record the input images of each cycle to the given file", cxxopts::value<std::string>());
+    options.add_options()("replay",
+                          "drive the shared memories from a recorded session (see --record) instead of a coupler",
+                          cxxopts::value<std::string>());
+    options.add_options()("replay-speed",
+                          "replay speed factor (default: 1; 0: as fast as possible)",
+                          cxxopts::value<double>()->default_value("1"));
+    options.add_options()("replay-loop", "restart the replay at the end of the recording");
+    options.add_options()("gateway",
+                          "serve the process data images to other modbus clients on the given port or service. "
+                          "The coupler only sees one client, regardless of the number of gateway clients.",
+                          cxxopts::value<std::string>());
+    options.add_options()("gateway-host",
+                          "listen address of the gateway",
+                          cxxopts::value<std::string>()->default_value("127.0.0.1"));
+    options.add_options()("gateway-clients",
+                          "maximum number of gateway clients",
+                          cxxopts::value<std::size_t>()->default_value("16"));
+    options.add_options()("stream",
+                          "stream the changed values of each cycle to subscribers on the given Unix domain socket. "
+                          "An existing socket file is only replaced if --force is used.",
+                          cxxopts::value<std::string>());
+    options.add_options()("stream-queue",
+                          "maximum number of queued bytes per stream subscriber. "
+                          "Subscribers that exceed the limit are disconnected.",
+                          cxxopts::value<std::size_t>()->default_value("1048576"));
+    options.add_options()("memfd",
+                          "create the shared memories as sealed memfds instead of named shared memories and hand them "
+                          "to consumers on the given Unix domain socket. "
+                          "An existing socket file is only replaced if --force is used.",
+                          cxxopts::value<std::string>());
     options.add_options()("version", "print application version");
     options.add_options()("license", "show licences");
     options.add_options()("host", "Modbus client host/address", cxxopts::value<std::string>());
@@ -132,20 +226,237 @@ int main(int argc, char **argv) {
         return EX_OK;
     }
 
+    const auto FORCE_SHM = args.count("force") > 0;
+    const auto QUIET     = args.count("quiet") > 0;
+
+    // serve the images to other modbus clients (if requested)
+    auto start_gateway = [&args](WAGO_Modbus::TCP_Coupler_SHM &wago) {
+        if (!args.count("gateway")) return true;
+        try {
+            wago.start_gateway(args["gateway-host"].as<std::string>(),
+                               args["gateway"].as<std::string>(),
+                               args["gateway-clients"].as<std::size_t>());
+        } catch (const std::exception &e) {
+            std::cerr << Print_Time::iso << " ERROR: Failed to start modbus gateway: " << e.what() << std::endl;
+            return false;
+        }
+        return true;
+    };
+
+    // stream the changed values to socket subscribers (if requested)
+    auto start_change_stream = [&args, FORCE_SHM](WAGO_Modbus::TCP_Coupler_SHM &wago) {
+        if (!args.count("stream")) return true;
+        try {
+            wago.start_change_stream(
+                    args["stream"].as<std::string>(), FORCE_SHM, args["stream-queue"].as<std::size_t>());
+        } catch (const std::exception &e) {
+            std::cerr << Print_Time::iso << " ERROR: Failed to start change stream: " << e.what() << std::endl;
+            return false;
+        }
+        return true;
+    };
+
+    if (args.count("replay")) {
+        const auto REPLAY_SPEED = args["replay-speed"].as<double>();
+        const auto REPLAY_LOOP  = args.count("replay-loop") > 0;
+
+        if (REPLAY_SPEED < 0) {
+            std::cerr << Print_Time::iso << " ERROR: replay speed must not be negative" << std::endl;
+            return exit_usage();
+        }
+
+        std::unique_ptr<WAGO_Modbus::Session_Player> player;
+        WAGO_Modbus::TCP_Coupler_SHM                 wago;
+
+        if (args.count("memfd")) wago.set_memfd_handover(args["memfd"].as<std::string>(), FORCE_SHM);
+
+        if (args.count("clamp-config")) {
+            try {
+                wago.load_clamp_config(args["clamp-config"].as<std::string>());
+            } catch (const std::exception &e) {
+                std::cerr << Print_Time::iso << " ERROR: Failed to load module configuration: " << e.what()
+                          << std::endl;
+                return EX_CONFIG;
+            }
+        }
+
+        if (args.count("scaling")) {
+            try {
+                wago.load_scaling_config(args["scaling"].as<std::string>());
+            } catch (const std::exception &e) {
+                std::cerr << Print_Time::iso << " ERROR: Failed to load scaling configuration: " << e.what()
+                          << std::endl;
+                return EX_CONFIG;
+            }
+        }
+
+        try {
+            player = std::make_unique<WAGO_Modbus::Session_Player>(args["replay"].as<std::string>());
+            wago.init_replay(*player, args["prefix"].as<std::string>(), !FORCE_SHM);
+        } catch (const std::exception &e) {
+            std::cerr << Print_Time::iso << " ERROR: Failed to load recorded session: " << e.what() << std::endl;
+            return EX_NOINPUT;
+        }
+
+        if (!start_gateway(wago)) return EX_UNAVAILABLE;
+        if (!start_change_stream(wago)) return EX_UNAVAILABLE;
+
+        if (!QUIET) {
+            const auto clampinfo = wago.get_clamp_info();
+            std::cout << "Replaying session with " << clampinfo.size() << " clamps:" << std::endl;
+            for (const auto &i : clampinfo)
+                std::cout << "    " << i << std::endl;
+        }
+
+        int ret = EX_OK;
+
+        // start of the current replay pass
+        auto        replay_start = std::chrono::steady_clock::now();
+        std::size_t frames       = 0;
+
+        while (!terminate) {
+            std::chrono::nanoseconds timestamp {};
+
+            try {
+                if (!player->next_frame(timestamp)) {
+                    // stop at the end of the recording, or if the recording does not contain any frame
+                    if (!REPLAY_LOOP || frames == 0) break;
+
+                    player->rewind();
+                    replay_start = std::chrono::steady_clock::now();
+                    frames       = 0;
+                    continue;
+                }
+
+                if (REPLAY_SPEED > 0) {
+                    std::this_thread::sleep_until(
+                            replay_start +
+                            std::chrono::duration_cast<std::chrono::nanoseconds>(timestamp / REPLAY_SPEED));
+                }
+
+                wago.replay_image(*player);
+                ++frames;
+            } catch (const std::exception &e) {
+                std::cerr << Print_Time::iso << " ERROR: Failed to replay recorded session: " << e.what() << std::endl;
+                ret = EX_DATAERR;
+                break;
+            }
+        }
+
+        std::cerr << Print_Time::iso << " INFO : Terminating..." << std::endl;
+        return ret;
+    }
+
     if (args.count("host") == 0) {
         std::cerr << Print_Time::iso << " ERROR: no host specified" << std::endl;
         return exit_usage();
     }
 
-    const std::string &service      = args.count("service") ? args["service"].as<std::string>() : "502";
-    const auto         FORCE_SHM    = args.count("force") > 0;
-    const auto         QUIET        = args.count("quiet") > 0;
-    const auto         START_IMAGE  = args.count("read-start-image") > 0;
-    const auto         CYCLE_TIME   = args["cycle"].as<std::size_t>();
-    const auto         CYCLE_NOFAIL = args.count("no-cycle-time-fail");
-    const auto         CYCLE_NOWARN = args.count("no-cycle-time-warn");
+    const std::string &service            = args.count("service") ? args["service"].as<std::string>() : "502";
+    const auto         START_IMAGE        = args.count("read-start-image") > 0;
+    const auto         CYCLE_TIME         = args["cycle"].as<std::size_t>();
+    const auto         CYCLE_MIN          = args["cycle-min"].as<std::size_t>();
+    const auto         CYCLE_MAX          = args["cycle-max"].as<std::size_t>();
+    const auto         CYCLE_NOFAIL       = args.count("no-cycle-time-fail");
+    const auto         CYCLE_NOWARN       = args.count("no-cycle-time-warn");
+    const auto         WATCHDOG           = args["watchdog"].as<std::size_t>();
+    const auto         DIAGNOSTICS_INLINE = args.count("diagnostics") > 0;
+
+    if (CYCLE_MAX && CYCLE_MIN > CYCLE_MAX) {
+        std::cerr << Print_Time::iso << " ERROR: minimum cycle time greater than maximum cycle time" << std::endl;
+        return exit_usage();
+    }
 
-    WAGO_Modbus::TCP_Coupler_SHM wago(args["host"].as<std::string>(), service, args.count("debug") > 0 && !QUIET);
+    if (WATCHDOG && WATCHDOG <= std::max(CYCLE_TIME, CYCLE_MAX)) {
+        std::cerr << Print_Time::iso << " ERROR: watchdog timeout must be greater than the cycle time" << std::endl;
+        return exit_usage();
+    }
+
+    // tuning of the modbus socket
+    Modbus_Transport::Socket_Options socket_options;
+    socket_options.quick_ack        = args.count("quickack") > 0;
+    socket_options.busy_poll        = args["busy-poll"].as<int>();
+    socket_options.priority         = args["socket-priority"].as<int>();
+    socket_options.response_timeout = std::chrono::milliseconds(args["response-timeout"].as<std::size_t>());
+    socket_options.byte_timeout     = std::chrono::milliseconds(args["byte-timeout"].as<std::size_t>());
+
+    const auto &TOS       = args["tos"].as<std::string>();
+    const bool  TOS_MATCH = TOS == "coupler";
+    if (!TOS_MATCH && TOS != "default") {
+        try {
+            std::size_t end    = 0;
+            socket_options.tos = std::stoi(TOS, &end, 0);
+            if (end != TOS.size() || socket_options.tos < 0 || socket_options.tos > UINT8_MAX)
+                throw std::out_of_range(TOS);
+        } catch (const std::exception &) {
+            std::cerr << Print_Time::iso << " ERROR: invalid TOS '" << TOS << '\'' << std::endl;
+            return exit_usage();
+        }
+    }
+
+    if (socket_options.busy_poll < 0) {
+        std::cerr << Print_Time::iso << " ERROR: busy poll time must not be negative" << std::endl;
+        return exit_usage();
+    }
+
+    if (socket_options.priority < -1) {
+        std::cerr << Print_Time::iso << " ERROR: invalid socket priority " << socket_options.priority << std::endl;
+        return exit_usage();
+    }
+
+    if (socket_options.response_timeout.count() == 0) {
+        std::cerr << Print_Time::iso << " ERROR: response timeout must be greater than 0" << std::endl;
+        return exit_usage();
+    }
+
+    const auto &BACKEND = args["backend"].as<std::string>();
+
+    std::unique_ptr<Modbus_Transport> transport;
+    if (BACKEND == "libmodbus") {
+        transport = std::make_unique<Modbus_TCP_Server>(
+                args["host"].as<std::string>(), service, args.count("debug") > 0 && !QUIET);
+    } else if (BACKEND == "raw") {
+        auto raw = std::make_unique<Modbus_Raw_TCP>(
+                args["host"].as<std::string>(), service, args.count("no-pipelining") == 0);
+        raw->set_timestamping(args.count("timestamping") > 0);
+        transport = std::move(raw);
+    } else {
+        std::cerr << Print_Time::iso << " ERROR: unknown modbus backend '" << BACKEND << '\'' << std::endl;
+        return exit_usage();
+    }
+
+    transport->set_socket_options(socket_options);
+
+    WAGO_Modbus::TCP_Coupler_SHM wago(std::move(transport));
+    wago.set_match_coupler_tos(TOS_MATCH);
+
+    try {
+        wago.set_watchdog(std::chrono::milliseconds(WATCHDOG));
+    } catch (const std::out_of_range &e) {
+        std::cerr << Print_Time::iso << " ERROR: invalid watchdog timeout: " << e.what() << std::endl;
+        return exit_usage();
+    }
+
+    wago.set_diagnostics_interval(std::chrono::milliseconds(args["diagnostics"].as<std::size_t>()));
+    if (args.count("memfd")) wago.set_memfd_handover(args["memfd"].as<std::string>(), FORCE_SHM);
+
+    if (args.count("clamp-config")) {
+        try {
+            wago.load_clamp_config(args["clamp-config"].as<std::string>());
+        } catch (const std::exception &e) {
+            std::cerr << Print_Time::iso << " ERROR: Failed to load module configuration: " << e.what() << std::endl;
+            return EX_CONFIG;
+        }
+    }
+
+    if (args.count("scaling")) {
+        try {
+            wago.load_scaling_config(args["scaling"].as<std::string>());
+        } catch (const std::exception &e) {
+            std::cerr << Print_Time::iso << " ERROR: Failed to load scaling configuration: " << e.what() << std::endl;
+            return EX_CONFIG;
+        }
+    }
 
     try {
         wago.init(args["prefix"].as<std::string>(), !FORCE_SHM);
@@ -155,6 +466,18 @@ int main(int argc, char **argv) {
         return EX_UNAVAILABLE;
     }
 
+    if (args.count("record")) {
+        try {
+            wago.start_recording(args["record"].as<std::string>());
+        } catch (const std::exception &e) {
+            std::cerr << Print_Time::iso << " ERROR: Failed to start recording: " << e.what() << std::endl;
+            return EX_CANTCREAT;
+        }
+    }
+
+    if (!start_gateway(wago)) return EX_UNAVAILABLE;
+    if (!start_change_stream(wago)) return EX_UNAVAILABLE;
+
     if (!QUIET) {
         const auto couplerinfo = wago.get_coupler_info();
         std::cout << "Found WAGO Coupler" << std::endl;
@@ -186,19 +509,33 @@ int main(int argc, char **argv) {
      * The application is terminated if cycle_fail is greather than MAX_FAIL.
      *
      * This mechanism quickly terminates the program if the cycle time is permanently exceeded,
-     * but sporadic exceeding does not lead to termination
+     * but sporadic exceeding does not lead to termination.
+     *
+     * With the adaptive cycle time (--cycle-max), the cycle time is increased instead.
+     * Only exceeding the maximum cycle time counts as failure.
      */
     const std::size_t MAX_FAIL   = 100;
     std::size_t       cycle_fail = 0;
 
+    // fixed cycle time: min == max
+    const auto       CYCLE_UPPER = std::chrono::milliseconds(CYCLE_MAX ? CYCLE_MAX : CYCLE_TIME);
+    const auto       CYCLE_LOWER = std::chrono::milliseconds(CYCLE_MAX ? CYCLE_MIN : CYCLE_TIME);
+    Cycle_Controller cycle(CYCLE_LOWER, CYCLE_UPPER, CYCLE_TIME ? std::chrono::milliseconds(CYCLE_TIME) : CYCLE_UPPER);
+
     // time until the thread will sleep to wait for the next cycle
     decltype(std::chrono::steady_clock::now()) sleep_time = std::chrono::steady_clock::now();
 
+    // messages of the cycle loop are formatted and written by a background thread
+    using Level = Async_Logger::Level;
+    Async_Logger logger(std::cerr);
+
     while (!terminate) {
+        const auto cycle_start = std::chrono::steady_clock::now();
+
         try {
             wago.fetch_image();
         } catch (const std::exception &e) {
-            std::cerr << Print_Time::iso << " ERROR: Failed to fetch input image: " << e.what() << std::endl;
+            logger.log(Level::ERROR, "Failed to fetch input image: ", e.what());
             ret = EX_SOFTWARE;
             break;
         }
@@ -206,42 +543,80 @@ int main(int argc, char **argv) {
         try {
             wago.send_image();
         } catch (const std::exception &e) {
-            std::cerr << Print_Time::iso << " ERROR: Failed to send output image: " << e.what() << std::endl;
+            logger.log(Level::ERROR, "Failed to send output image: ", e.what());
             ret = EX_SOFTWARE;
             break;
         }
 
-        if (CYCLE_TIME) {
-            sleep_time = sleep_time + std::chrono::milliseconds(CYCLE_TIME);
+        // adaptive cycle time: a diagnostics read that is due needs a reserve in the idle time of the cycle
+        const auto cycle_duration  = std::chrono::steady_clock::now() - cycle_start;
+        const auto previous_period = cycle.get_period();
+        const auto period          = cycle.update(cycle_duration, wago.get_diagnostics_duration());
+        wago.publish_cycle_time(period, cycle.get_average_duration());
+
+        if (period.count()) {
+            // end of this cycle with the period it was started with (a raised period must not hide the overrun)
+            const auto deadline = sleep_time + previous_period;
+            sleep_time          = sleep_time + period;
 
             auto n = std::chrono::steady_clock::now();
 
-            if (n > sleep_time) {
-                if (!CYCLE_NOWARN) {
-                    std::cerr << Print_Time::iso << " WARN : Cycle time exceeded by "
-                              << std::chrono::duration_cast<std::chrono::microseconds>(n - sleep_time).count() << "µs"
-                              << std::endl;
+            // below the maximum the adaptive cycle time is increased instead
+            if (n > deadline) {
+                if (!CYCLE_NOWARN && cycle.at_max()) {
+                    logger.log(Level::WARN,
+                               "Cycle time exceeded by ",
+                               std::chrono::duration_cast<std::chrono::microseconds>(n - deadline).count(),
+                               "µs");
                 }
 
-                if (!CYCLE_NOFAIL) {
+                if (!CYCLE_NOFAIL && cycle.at_max()) {
                     cycle_fail += 10;
                     if (cycle_fail > MAX_FAIL) {
-                        std::cerr << Print_Time::iso << " ERROR: cycle time repeatedly exceeded" << std::endl;
+                        logger.log(Level::ERROR, "cycle time repeatedly exceeded");
                         ret = EX_TEMPFAIL;
                         break;
                     }
                 }
 
-                // set time of last sleep to now, otherwise it will likely fail again in the next cycle
+                // restart the schedule now (also if the period was raised): missed cycles are not caught up,
+                // otherwise it will likely fail again in the next cycle
                 sleep_time = n;
             } else if (cycle_fail) {
                 --cycle_fail;
             }
+        }
 
-            std::this_thread::sleep_until(sleep_time);
+        // diagnostics in the idle time of the cycle (also detects added or removed modules)
+        // without cycle time they delay the next cycle: only if requested explicitly (--diagnostics)
+        if (period.count() || DIAGNOSTICS_INLINE) {
+            try {
+                const auto generation = wago.get_layout_generation();
+                const bool recording  = wago.is_recording();
+                wago.poll_diagnostics(period.count() ? sleep_time : std::chrono::steady_clock::time_point::max());
+
+                if (wago.get_layout_generation() != generation) {
+                    logger.log(Level::WARN, "Module configuration changed. Shared memories recreated.");
+                    if (recording) logger.log(Level::WARN, "Recording stopped.");
+
+                    if (!QUIET) {
+                        const auto clampinfo = wago.get_clamp_info();
+                        std::cout << "Found " << clampinfo.size() << " clamps:" << std::endl;
+                        for (const auto &i : clampinfo)
+                            std::cout << "    " << i << std::endl;
+                    }
+                }
+            } catch (const std::exception &e) {
+                logger.log(Level::ERROR, "Failed to apply new module configuration: ", e.what());
+                ret = EX_SOFTWARE;
+                break;
+            }
         }
+
+        if (period.count()) std::this_thread::sleep_until(sleep_time);
     }
 
-    std::cerr << Print_Time::iso << " INFO : Terminating..." << std::endl;
+    // queued messages are written when the logger is destroyed
+    logger.log(Level::INFO, "Terminating...");
     return ret;
 }
@@ -0,0 +1,261 @@
+/*
+ * Copyright (C) 2023 Nikolas Koesling <nikolas@koesling.info>.
+ * This program is free software. You can redistribute it and/or modify it under the terms of the MIT License.
+ */
+
+#include "Analog_Scaling.hpp"
+#include "Clamp_Registry.hpp"
+#include "Test.hpp"
+#include "WAGO_MB_Clamps.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+using WAGO_Modbus::Analog_Scaling;
+
+// the same selection as Analog_Scaling::apply (the test is compiled once per path, see test/CMakeLists.txt)
+#if defined(__AVX2__)
+static constexpr const char *PATH = "AVX2";
+#elif defined(__SSE2__)
+static constexpr const char *PATH = "SSE2";
+#elif defined(__ARM_NEON)
+static constexpr const char *PATH = "NEON";
+#else
+static constexpr const char *PATH = "scalar";
+#endif
+
+// analog input module without built-in scaling parameters (3 channels: tail of the vectorized loop)
+static constexpr WAGO_Modbus::Clamp_Descriptor
+        CUSTOM {9999, 3, 3, 0, 0, 0, WAGO_Modbus::Clamp_Data_Type::INT16, "test"};
+
+/**
+ * @brief scalar reference of the conversion (double precision)
+ */
+static double reference(const Analog_Scaling::Parameters &parameters, uint16_t raw) {
+    const auto value = static_cast<uint16_t>(raw & ~parameters.status_mask);
+    const auto count = parameters.is_signed ? static_cast<double>(static_cast<int16_t>(value)) : value;
+    return static_cast<double>(parameters.offset) + static_cast<double>(parameters.gain) * count;
+}
+
+/**
+ * @brief float tolerance of a conversion (the bias of unsigned values is part of the offset)
+ */
+static double tolerance(const Analog_Scaling::Parameters &parameters) {
+    const double range = std::fabs(static_cast<double>(parameters.offset)) +
+                         std::fabs(static_cast<double>(parameters.gain)) * 65536.0;
+    return 4.0 * range * static_cast<double>(std::numeric_limits<float>::epsilon());
+}
+
+/**
+ * @brief bitwise comparison of two floats
+ */
+static bool same(float a, float b) {
+    return std::memcmp(&a, &b, sizeof(a)) == 0;
+}
+
+/**
+ * @brief raw test values: limits, sign boundaries, status bits and a pseudo random sequence
+ */
+static std::vector<uint16_t> raw_values(std::size_t n, std::size_t seed) {
+    static constexpr uint16_t SPECIAL[] = {0x0000, 0x0001, 0x0007, 0x0008, 0x7FF8, 0x7FFF, 0x8000, 0x8007, 0xFFFF};
+
+    std::vector<uint16_t> values(n);
+    for (std::size_t i = 0; i < n; ++i)
+        values[i] = static_cast<uint16_t>((i + seed) % 3 == 0 ? SPECIAL[(i + seed) % std::size(SPECIAL)]
+                                                              : (i + seed) * 40503U);
+    return values;
+}
+
+/**
+ * @brief check apply against the scalar reference
+ * @param scaling scaling (built for the module list)
+ * @param parameters expected parameters of each analog input channel (in image order)
+ * @param name name of the check
+ */
+static void check_apply(const Analog_Scaling                         &scaling,
+                        const std::vector<Analog_Scaling::Parameters> &parameters,
+                        const std::string                             &name) {
+    Test::check(scaling.size() == parameters.size(), name + ": number of channels");
+    if (scaling.size() != parameters.size()) return;
+
+    for (std::size_t seed = 0; seed < 16; ++seed) {
+        const auto         raw = raw_values(parameters.size(), seed);
+        std::vector<float> result(parameters.size() + 1, -1.0F);
+        scaling.apply(raw.data(), result.data());
+
+        for (std::size_t i = 0; i < parameters.size(); ++i) {
+            const double expected = reference(parameters[i], raw[i]);
+            const double error    = std::fabs(static_cast<double>(result[i]) - expected);
+            Test::check(error <= tolerance(parameters[i]),
+                        name + ": channel " + std::to_string(i) + " raw " + std::to_string(raw[i]) + " expected " +
+                                std::to_string(expected) + " got " + std::to_string(result[i]));
+        }
+        Test::check(same(result.back(), -1.0F), name + ": no write behind the result");
+    }
+}
+
+/**
+ * @brief module list with the expected parameters of each analog input channel
+ */
+struct Layout {
+    WAGO_Modbus::Clamp_Table                clamps;
+    std::vector<Analog_Scaling::Parameters> parameters;  // expected parameters (index: analog input image index)
+
+    /**
+     * @brief add a module of the built-in table with its default parameters
+     */
+    void add(const WAGO_Modbus::Clamp_Registry &registry, uint16_t product_id) {
+        const auto &descriptor = registry.get(product_id);
+        clamps.add_analog(descriptor);
+        parameters.insert(parameters.end(), descriptor.input_words, Analog_Scaling::get_default(product_id));
+    }
+};
+
+/**
+ * @brief signed and unsigned modules with built-in and configured parameters, vector loop and tail
+ */
+static void test_apply(const WAGO_Modbus::Clamp_Registry &registry) {
+    // 4 + 4 + 2 + 4 + 4 + 3 = 21 channels: two vectors and a tail of 5 values
+    Layout layout;
+    layout.add(registry, 453);  // unsigned, status bits
+    layout.add(registry, 457);  // signed, status bits
+    layout.clamps.add_digital(0x8801);
+    layout.add(registry, 454);  // unsigned with offset
+    layout.add(registry, 460);  // signed, no status bits
+    layout.add(registry, 455);  // configured below
+    layout.clamps.add_analog(CUSTOM);
+
+    Analog_Scaling scaling;
+
+    const Analog_Scaling::Parameters configured {-5.0F, 0.25F, 0x000F, true};
+    scaling.set_parameters(6, configured);
+    std::fill(layout.parameters.end() - 4, layout.parameters.end(), configured);
+
+    const Analog_Scaling::Parameters custom {100.0F, -0.5F, 0x8001, false};
+    scaling.set_parameters(7, custom);
+    layout.parameters.insert(layout.parameters.end(), 3, custom);
+
+    scaling.build(layout.clamps);
+    check_apply(scaling, layout.parameters, "mixed modules");
+
+    // status bits are cleared before the conversion (channels with the status mask 0x0007)
+    const std::size_t     n = layout.parameters.size();
+    std::vector<uint16_t> raw(n, 0x7FFF);
+    std::vector<uint16_t> cleared(n, 0x7FF8);
+    std::vector<float>    result(n);
+    std::vector<float>    result_cleared(n);
+    scaling.apply(raw.data(), result.data());
+    scaling.apply(cleared.data(), result_cleared.data());
+    for (std::size_t i = 0; i < n; ++i) {
+        if ((layout.parameters[i].status_mask & 0x0007) != 0x0007) continue;
+        Test::check(same(result[i], result_cleared[i]), "status bits of channel " + std::to_string(i) + " cleared");
+    }
+    Test::check(std::fabs(result[0] - 20.0F * 32760.0F / 32767.0F) < 1e-3F, "750-453 upper end of range");
+
+    // unknown modules are not scaled (unsigned value), less values than one vector
+    Layout tail;
+    tail.clamps.add_analog(CUSTOM);
+    tail.parameters.assign(3, {0.0F, 1.0F, 0, false});
+    Analog_Scaling tail_scaling;
+    tail_scaling.build(tail.clamps);
+    check_apply(tail_scaling, tail.parameters, "tail only");
+
+    Layout vector;
+    vector.add(registry, 457);
+    vector.add(registry, 453);
+    Analog_Scaling vector_scaling;
+    vector_scaling.build(vector.clamps);
+    check_apply(vector_scaling, vector.parameters, "one vector");
+}
+
+/**
+ * @brief path of a temporary configuration file
+ */
+static std::string config_path() {
+    return "/tmp/test_scaling_" + std::to_string(getpid()) + ".conf";
+}
+
+/**
+ * @brief write the temporary configuration file and load it
+ */
+static void load(Analog_Scaling &scaling, const std::string &content) {
+    {
+        std::ofstream file(config_path());
+        file << content;
+    }
+    scaling.load_config(config_path());
+}
+
+/**
+ * @brief configuration file: valid lines are applied, invalid lines are rejected
+ */
+static void test_load_config(const WAGO_Modbus::Clamp_Registry &registry) {
+    Layout layout;
+    layout.add(registry, 453);
+    layout.add(registry, 457);
+    layout.add(registry, 459);
+
+    Analog_Scaling scaling;
+    load(scaling,
+         "# module offset gain [status mask [signed|unsigned]]\n"
+         "\n"
+         "1 1.5 0.5\n"
+         "   2 -2 0.25 0x0003 unsigned   \n"
+         "3 0 2 7 signed\n"
+         "# 3 0 0\n");
+    scaling.build(layout.clamps);
+    auto &expected = layout.parameters;
+    std::fill(expected.begin(), expected.begin() + 4, Analog_Scaling::Parameters {1.5F, 0.5F, 0, false});
+    std::fill(expected.begin() + 4, expected.begin() + 8, Analog_Scaling::Parameters {-2.0F, 0.25F, 3, false});
+    std::fill(expected.begin() + 8, expected.end(), Analog_Scaling::Parameters {0.0F, 2.0F, 7, true});
+    check_apply(scaling, expected, "configuration file");
+
+    static constexpr const char *INVALID[] = {
+            "0 1 1",             // module 0
+            "x 1 1",             // module not a number
+            "1x 1 1",            // trailing characters
+            "1 1",               // gain missing
+            "1 a 1",             // offset not a number
+            "1 1 1 0x10000",     // status mask too large
+            "1 1 1 7z",          // status mask not a number
+            "1 1 1 7 maybe",     // invalid sign
+            "1 1 1 7 signed 1",  // trailing field
+    };
+    for (const auto *line : INVALID) {
+        Analog_Scaling invalid;
+        const std::string content = std::string("# valid\n1 0 1\n") + line + '\n';
+        Test::check_throws<std::runtime_error>([&]() { load(invalid, content); },
+                                               std::string("invalid line '") + line + '\'');
+    }
+
+    Test::check_throws<std::runtime_error>([]() { Analog_Scaling().load_config("/nonexistent/scaling.conf"); },
+                                           "missing configuration file");
+
+    // configuration of a module that is not an analog input module
+    WAGO_Modbus::Clamp_Table digital;
+    digital.add_digital(0x8801);
+    Analog_Scaling not_analog;
+    load(not_analog, "1 0 1\n");
+    Test::check_throws<std::runtime_error>([&]() { not_analog.build(digital); }, "scaling of a digital module");
+}
+
+int main() {
+    std::cout << "scaling path: " << PATH << '\n';
+
+    const WAGO_Modbus::Clamp_Registry registry;
+    test_apply(registry);
+    test_load_config(registry);
+
+    std::remove(config_path().c_str());
+    return Test::result();
+}
@@ -0,0 +1,113 @@
+/*
+ * Copyright (C) 2023 Nikolas Koesling <nikolas@koesling.info>.
+ * This program is free software. You can redistribute it and/or modify it under the terms of the MIT License.
+ */
+
+#include "Area_Planner.hpp"
+#include "Test.hpp"
+
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using WAGO_Modbus::Area_Planner::Register_Map;
+using WAGO_Modbus::Area_Planner::Request;
+
+// address areas of the analog input image (see WAGO_MB_TCP_Coupler::ADDR_DATA_AI_1 / ADDR_DATA_AI_2)
+static constexpr Register_Map<2> MAP({{{0x0000, 256}, {0x6000, 764}}});
+static constexpr std::size_t     LIMIT    = 125;  // Modbus_Transport::MAX_READ_REGISTERS
+static constexpr std::size_t     CAPACITY = 1020;
+
+// the plans are usable at compile time
+static_assert(MAP.capacity() == CAPACITY);
+static_assert(MAP.request_count(CAPACITY, LIMIT) == 10);
+static_assert(MAP.plan<10>(CAPACITY, LIMIT)[3].address == 0x6000);
+
+static std::vector<Request> plan(std::size_t image_size, std::size_t limit) {
+    std::vector<Request> result;
+    MAP.plan(image_size, limit, [&result](const Request &request) { result.push_back(request); });
+    return result;
+}
+
+static bool equal(const Request &request, uint16_t address, std::size_t size, std::size_t offset) {
+    return request.address == address && request.size == size && request.offset == offset;
+}
+
+/**
+ * @brief check the invariants of a plan: requests cover the image contiguously, do not exceed the limit and do not
+ *        span two areas. The number of requests matches request_count.
+ */
+static void check_plan(std::size_t image_size, std::size_t limit) {
+    const auto        requests = plan(image_size, limit);
+    const std::string name     = "plan(" + std::to_string(image_size) + ", " + std::to_string(limit) + ")";
+
+    Test::check(requests.size() == MAP.request_count(image_size, limit), name + ": request_count");
+
+    std::size_t offset = 0;
+    for (const auto &request : requests) {
+        Test::check(request.offset == offset, name + ": contiguous offsets");
+        Test::check(request.size > 0 && request.size <= limit, name + ": request size");
+
+        // area of the request
+        std::size_t area_offset = 0;
+        std::size_t area        = 0;
+        while (request.offset >= area_offset + MAP.get_area(area).second)
+            area_offset += MAP.get_area(area++).second;
+
+        const auto &[start, size] = MAP.get_area(area);
+        Test::check(request.address == start + (request.offset - area_offset), name + ": address");
+        Test::check(request.offset + request.size <= area_offset + size, name + ": request spans two areas");
+        offset += request.size;
+    }
+    Test::check(offset == image_size, name + ": image covered");
+}
+
+int main() {
+    // sizes: 0, 1, limit, limit + 1
+    Test::check(plan(0, LIMIT).empty(), "size 0: no request");
+    Test::check(MAP.request_count(0, LIMIT) == 0, "size 0: request_count");
+
+    auto requests = plan(1, LIMIT);
+    Test::check(requests.size() == 1 && equal(requests[0], 0x0000, 1, 0), "size 1");
+
+    requests = plan(LIMIT, LIMIT);
+    Test::check(requests.size() == 1 && equal(requests[0], 0x0000, LIMIT, 0), "size limit");
+
+    requests = plan(LIMIT + 1, LIMIT);
+    Test::check(requests.size() == 2 && equal(requests[0], 0x0000, LIMIT, 0) && equal(requests[1], LIMIT, 1, LIMIT),
+                "size limit + 1");
+
+    // area boundary
+    requests = plan(256, LIMIT);
+    Test::check(requests.size() == 3 && equal(requests[2], 250, 6, 250), "size 256: end of the first area");
+
+    requests = plan(257, LIMIT);
+    Test::check(requests.size() == 4 && equal(requests[2], 250, 6, 250) && equal(requests[3], 0x6000, 1, 256),
+                "size 257: first value of the second area");
+
+    // regression: the second area was requested at its size (ADDR_DATA_AI_2.second) instead of its start address
+    for (const auto &request : plan(CAPACITY, LIMIT)) {
+        if (request.offset < 256) continue;
+        Test::check(request.address >= 0x6000, "second area requested at its start address");
+        Test::check(request.address != 764, "second area not requested at its size");
+    }
+
+    // capacity
+    requests = plan(CAPACITY, LIMIT);
+    Test::check(requests.size() == 10, "capacity: 3 + 7 requests");
+    Test::check(!requests.empty() && equal(requests.back(), 0x6000 + 750, 14, 1006), "capacity: last request");
+
+    // invariants for all image sizes
+    for (const std::size_t limit : {std::size_t(1), std::size_t(7), LIMIT, std::size_t(256), CAPACITY}) {
+        for (std::size_t size = 0; size <= CAPACITY; ++size)
+            check_plan(size, limit);
+    }
+
+    // errors
+    Test::check_throws<std::out_of_range>([] { plan(CAPACITY + 1, LIMIT); }, "size > capacity");
+    Test::check_throws<std::invalid_argument>([] { plan(1, 0); }, "limit 0");
+    Test::check_throws<std::out_of_range>([] { static_cast<void>(MAP.plan<9>(CAPACITY, LIMIT)); },
+                                          "too many requests");
+
+    return Test::result();
+}
@@ -0,0 +1,314 @@
+/*
+ * Copyright (C) 2023 Nikolas Koesling <nikolas@koesling.info>.
+ * This program is free software. You can redistribute it and/or modify it under the terms of the MIT License.
+ */
+
+#include "Change_Stream.hpp"
+#include "Test.hpp"
+#include "WAGO_MB_Clamps.hpp"
+
+#include <array>
+#include <cstring>
+#include <string>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <vector>
+
+using WAGO_Modbus::Change_Stream;
+
+// 8 DI, 4 DO, AI_CLAMPS analog modules with AI_WORDS input words each
+static constexpr std::size_t DI_SIZE   = 8;
+static constexpr std::size_t DO_SIZE   = 4;
+static constexpr std::size_t AI_CLAMPS = 4;
+static constexpr std::size_t AI_WORDS  = 255;
+static constexpr std::size_t AI_SIZE   = AI_CLAMPS * AI_WORDS;
+static constexpr uint16_t    AI_FIRST  = 2;  // module index of the first analog module
+
+static constexpr WAGO_Modbus::Clamp_Descriptor
+        AI_DESCRIPTOR {9999, AI_WORDS, AI_WORDS, 0, 0, 0, WAGO_Modbus::Clamp_Data_Type::UINT16, "test"};
+
+static constexpr std::size_t QUEUE_LIMIT = 64 * 1024;
+static constexpr std::size_t MAX_CYCLES  = 10000;  // upper bound for the cycles until a disconnect
+
+struct Batch {
+    Change_Stream::Batch_Header         header {};
+    std::vector<Change_Stream::Record> records;
+};
+
+/**
+ * @brief process data images of the test layout
+ */
+struct Images {
+    std::array<uint8_t, DI_SIZE>  di {};
+    std::array<uint8_t, DO_SIZE>  dout {};
+    std::array<uint16_t, AI_SIZE> ai {};
+
+    [[nodiscard]] std::array<const void *, WAGO_Modbus::_REG_TYPES_SIZE_> get() const {
+        return {di.data(), dout.data(), ai.data(), ai.data()};
+    }
+};
+
+/**
+ * @brief path of the socket of the test
+ */
+static std::string socket_path() {
+    return "/tmp/test_change_stream_" + std::to_string(getpid()) + ".sock";
+}
+
+/**
+ * @brief connect a subscriber
+ */
+static int connect_subscriber(const std::string &path) {
+    const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd == -1) return -1;
+
+    sockaddr_un address {};
+    address.sun_family = AF_UNIX;
+    std::strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+    if (connect(fd, reinterpret_cast<const sockaddr *>(&address), sizeof(address))) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/**
+ * @brief send filters
+ */
+static bool send_filters(int fd, const std::vector<Change_Stream::Filter> &filters) {
+    const auto  size = filters.size() * sizeof(Change_Stream::Filter);
+    const auto *data = reinterpret_cast<const uint8_t *>(filters.data());
+    for (std::size_t sent = 0; sent < size;) {
+        const auto n = send(fd, data + sent, size - sent, MSG_NOSIGNAL);
+        if (n <= 0) return false;
+        sent += static_cast<std::size_t>(n);
+    }
+    return true;
+}
+
+/**
+ * @brief read the next batch (the stream sends within publish, so a batch is either complete or absent)
+ * @return false if no batch is available
+ */
+static bool read_batch(int fd, Batch &batch) {
+    if (recv(fd, &batch.header, sizeof(batch.header), MSG_DONTWAIT | MSG_WAITALL) !=
+        static_cast<ssize_t>(sizeof(batch.header)))
+        return false;
+
+    batch.records.resize(batch.header.count);
+    const auto size = batch.records.size() * sizeof(Change_Stream::Record);
+    return size == 0 || recv(fd, batch.records.data(), size, MSG_WAITALL) == static_cast<ssize_t>(size);
+}
+
+/**
+ * @brief read all available data
+ * @return number of read bytes, -1 if the connection was closed
+ */
+static ssize_t drain(int fd, int flags) {
+    std::array<uint8_t, 4096> buffer {};
+    ssize_t                   total = 0;
+    for (;;) {
+        const auto n = recv(fd, buffer.data(), buffer.size(), flags);
+        if (n == 0) return -1;
+        if (n < 0) return total;
+        total += n;
+    }
+}
+
+/**
+ * @brief count the records of a batch that belong to a module
+ */
+static std::size_t count_records(const Batch &batch, uint16_t clamp, uint8_t image) {
+    std::size_t count = 0;
+    for (const auto &record : batch.records)
+        if (record.clamp == clamp && record.image == image) ++count;
+    return count;
+}
+
+/**
+ * @brief subscriber without filters: snapshot of all values, then only the changed values
+ */
+static void test_changes(const WAGO_Modbus::Clamp_Table &clamps) {
+    Change_Stream stream(socket_path(), true, QUEUE_LIMIT);
+    stream.set_layout(clamps, 1);
+
+    const int fd = connect_subscriber(socket_path());
+    Test::check(fd != -1, "connect subscriber");
+
+    Images images;
+    images.di[3]  = 1;
+    images.ai[17] = 1234;
+
+    Batch batch;
+    stream.publish(images.get());
+    Test::check(stream.get_subscriber_count() == 1, "subscriber accepted");
+    Test::check(read_batch(fd, batch), "first batch");
+    Test::check(batch.header.flags == Change_Stream::FLAG_SNAPSHOT, "first batch is a snapshot");
+    Test::check(batch.header.layout_generation == 1, "layout generation");
+    Test::check(batch.records.size() == DI_SIZE + DO_SIZE + AI_SIZE, "snapshot contains all values");
+
+    stream.publish(images.get());
+    Test::check(!read_batch(fd, batch), "no batch without changes");
+
+    images.di[5]            = 1;
+    images.ai[AI_WORDS + 2] = 42;
+    stream.publish(images.get());
+    Test::check(read_batch(fd, batch), "batch after change");
+    Test::check(batch.header.flags == 0, "change batch is not a snapshot");
+    Test::check(batch.records.size() == 2, "only changed values");
+    Test::check(batch.records[0].image == WAGO_Modbus::DI && batch.records[0].channel == 5 &&
+                        batch.records[0].value == 1,
+                "changed digital value");
+    Test::check(batch.records[1].image == WAGO_Modbus::AI && batch.records[1].clamp == AI_FIRST + 1 &&
+                        batch.records[1].channel == 2 && batch.records[1].value == 42,
+                "changed analog value");
+
+    // a layout change results in a snapshot
+    stream.set_layout(clamps, 2);
+    stream.publish(images.get());
+    Test::check(read_batch(fd, batch), "batch after layout change");
+    Test::check(batch.header.flags == Change_Stream::FLAG_SNAPSHOT, "snapshot after layout change");
+    Test::check(batch.header.layout_generation == 2, "new layout generation");
+    Test::check(batch.records.size() == DI_SIZE + DO_SIZE + AI_SIZE, "snapshot after layout change is complete");
+
+    close(fd);
+}
+
+/**
+ * @brief subscriber with filters: only the selected channels are sent
+ */
+static void test_filters(const WAGO_Modbus::Clamp_Table &clamps) {
+    Change_Stream stream(socket_path(), true, QUEUE_LIMIT);
+    stream.set_layout(clamps, 1);
+
+    const int fd = connect_subscriber(socket_path());
+    Test::check(fd != -1, "connect subscriber");
+
+    Images images;
+    Batch  batch;
+    stream.publish(images.get());
+    Test::check(read_batch(fd, batch) && batch.records.size() == DI_SIZE + DO_SIZE + AI_SIZE, "initial snapshot");
+
+    // DI channels 2..4, the last 5 channels of the second analog module (count beyond the module is clamped)
+    // and filters of a non-existing module and image that are ignored
+    const std::vector<Change_Stream::Filter> filters {
+            {0, WAGO_Modbus::DI, 0, 2, 3},
+            {AI_FIRST + 1, WAGO_Modbus::AI, 0, AI_WORDS - 5, 100},
+            {1000, WAGO_Modbus::DI, 0, 0, 8},
+            {0, 7, 0, 0, 8},
+    };
+    Test::check(send_filters(fd, filters), "send filters");
+
+    stream.publish(images.get());
+    Test::check(read_batch(fd, batch), "batch after filter");
+    Test::check(batch.header.flags == Change_Stream::FLAG_SNAPSHOT, "snapshot after filter");
+    Test::check(batch.records.size() == 8, "snapshot contains the selected values");
+    Test::check(count_records(batch, 0, WAGO_Modbus::DI) == 3, "selected digital values");
+    Test::check(count_records(batch, AI_FIRST + 1, WAGO_Modbus::AI) == 5, "selected analog values");
+
+    // changes of values that are not selected are not sent
+    images.di[1] = 1;
+    images.di[5] = 1;
+    images.ai[0] = 7;
+    stream.publish(images.get());
+    Test::check(!read_batch(fd, batch), "no batch for unselected changes");
+
+    images.di[4]                = 1;
+    images.ai[2 * AI_WORDS - 1] = 99;
+    stream.publish(images.get());
+    Test::check(read_batch(fd, batch), "batch for selected changes");
+    Test::check(batch.records.size() == 2, "only selected changes");
+    Test::check(batch.records[0].channel == 4 && batch.records[0].value == 1, "selected digital change");
+    Test::check(batch.records[1].channel == AI_WORDS - 1 && batch.records[1].value == 99, "selected analog change");
+
+    // a filter split between two publish calls is applied once complete
+    const Change_Stream::Filter filter {0, WAGO_Modbus::DI, 0, 0, 1};
+    const auto                 *data = reinterpret_cast<const uint8_t *>(&filter);
+    Test::check(send(fd, data, 3, MSG_NOSIGNAL) == 3, "send partial filter");
+    stream.publish(images.get());
+    Test::check(!read_batch(fd, batch), "partial filter not applied");
+    Test::check(send(fd, data + 3, sizeof(filter) - 3, MSG_NOSIGNAL) == sizeof(filter) - 3, "send filter rest");
+    stream.publish(images.get());
+    Test::check(read_batch(fd, batch), "batch after completed filter");
+    Test::check(batch.records.size() == 9 && count_records(batch, 0, WAGO_Modbus::DI) == 4,
+                "completed filter added to the selection");
+
+    // the selection is rebuilt after a layout change
+    stream.set_layout(clamps, 2);
+    stream.publish(images.get());
+    Test::check(read_batch(fd, batch), "batch after layout change");
+    Test::check(batch.records.size() == 9, "selection kept after layout change");
+
+    close(fd);
+}
+
+/**
+ * @brief subscribers that do not read are disconnected, subscribers that read are kept
+ */
+static void test_queue_limit(const WAGO_Modbus::Clamp_Table &clamps) {
+    Change_Stream stream(socket_path(), true, QUEUE_LIMIT);
+    stream.set_layout(clamps, 1);
+
+    const int slow = connect_subscriber(socket_path());
+    const int fast = connect_subscriber(socket_path());
+    Test::check(slow != -1 && fast != -1, "connect subscribers");
+
+    Images images;
+    for (std::size_t cycle = 0; cycle < MAX_CYCLES && stream.get_dropped_count() == 0; ++cycle) {
+        for (auto &value : images.ai)
+            value = static_cast<uint16_t>(cycle);
+        stream.publish(images.get());
+        Test::check(drain(fast, MSG_DONTWAIT) != -1, "fast subscriber connected");
+    }
+
+    Test::check(stream.get_dropped_count() == 1, "slow subscriber dropped");
+    Test::check(stream.get_subscriber_count() == 1, "fast subscriber kept");
+
+    // the connection of the slow subscriber is closed after the queued data
+    Test::check(drain(slow, 0) == -1, "slow subscriber disconnected");
+
+    close(slow);
+    close(fast);
+}
+
+/**
+ * @brief subscribers that send more than MAX_FILTERS filters are disconnected
+ */
+static void test_filter_limit(const WAGO_Modbus::Clamp_Table &clamps) {
+    Change_Stream stream(socket_path(), true, QUEUE_LIMIT);
+    stream.set_layout(clamps, 1);
+
+    const int fd = connect_subscriber(socket_path());
+    Test::check(fd != -1, "connect subscriber");
+
+    Images images;
+    stream.publish(images.get());
+    Test::check(stream.get_subscriber_count() == 1, "subscriber accepted");
+
+    const std::vector<Change_Stream::Filter> filters(4097, {0, WAGO_Modbus::DI, 0, 0, 1});
+    Test::check(send_filters(fd, filters), "send filters");
+
+    // filters are read in portions: the subscriber is disconnected after a bounded number of cycles
+    for (std::size_t cycle = 0; cycle < MAX_CYCLES && stream.get_subscriber_count(); ++cycle)
+        stream.publish(images.get());
+    Test::check(stream.get_subscriber_count() == 0, "subscriber with too many filters disconnected");
+    Test::check(stream.get_dropped_count() == 0, "disconnect is not counted as dropped");
+
+    close(fd);
+}
+
+int main() {
+    WAGO_Modbus::Clamp_Table clamps;
+    clamps.add_digital(0x8801);
+    clamps.add_digital(0x8402);
+    for (std::size_t i = 0; i < AI_CLAMPS; ++i)
+        clamps.add_analog(AI_DESCRIPTOR);
+
+    test_changes(clamps);
+    test_filters(clamps);
+    test_queue_limit(clamps);
+    test_filter_limit(clamps);
+
+    return Test::result();
+}
@@ -0,0 +1,95 @@
+/*
+ * Copyright (C) 2023 Nikolas Koesling <nikolas@koesling.info>.
+ * This program is free software. You can redistribute it and/or modify it under the terms of the MIT License.
+ */
+
+#include "Cycle_Controller.hpp"
+#include "Test.hpp"
+
+#include <chrono>
+#include <stdexcept>
+
+using namespace std::chrono_literals;
+
+/**
+ * @brief the period follows average + 4 * deviation: increases immediately, decreases by 1/16 of the difference
+ */
+static void test_adaption() {
+    Cycle_Controller controller(1us, 1s, 1us);
+    Test::check(controller.get_period() == 1us, "initial period");
+
+    // first measurement: average 100us, deviation 50us --> target 300us
+    Test::check(controller.update(100us, 0ns) == 300us, "immediate increase to the target");
+    Test::check(controller.get_average_duration() == 100us, "first measurement is the average");
+
+    // average 100us, deviation 37.5us --> target 250us, period 300us - 50us / 16
+    Test::check(controller.update(100us, 0ns) == 296875ns, "decrease by 1/16 of the difference");
+
+    // average 212.5us, deviation 253.125us --> target 1225us
+    Test::check(controller.update(1ms, 0ns) == 1225us, "immediate increase after a slow cycle");
+    Test::check(controller.get_average_duration() == 212500ns, "average duration");
+
+    // the period converges towards the target
+    auto previous = controller.get_period();
+    for (int i = 0; i < 10; ++i) {
+        const auto period = controller.update(100us, 0ns);
+        Test::check(period < previous, "period decreases while the cycles are fast");
+        previous = period;
+    }
+}
+
+/**
+ * @brief the period is limited to [min, max]
+ */
+static void test_limits() {
+    Cycle_Controller controller(1ms, 2ms, 500us);
+    Test::check(controller.get_period() == 1ms, "initial period limited to the lower bound");
+
+    Test::check(controller.update(10us, 0ns) == 1ms, "period limited to the lower bound");
+    Test::check(!controller.at_max(), "not at the upper bound");
+
+    Test::check(controller.update(10ms, 0ns) == 2ms, "period limited to the upper bound");
+    Test::check(controller.at_max(), "at the upper bound");
+
+    Test::check(Cycle_Controller(1ms, 2ms, 5ms).get_period() == 2ms, "initial period limited to the upper bound");
+}
+
+/**
+ * @brief a reserve extends only the next cycle
+ */
+static void test_reserve() {
+    Cycle_Controller controller(1us, 10ms, 1us);
+
+    Test::check(controller.update(100us, 50us) == 350us, "reserve extends the next cycle");
+    Test::check(controller.get_period() == 350us, "period of the next cycle includes the reserve");
+    Test::check(controller.update(100us, 0ns) == 296875ns, "reserve does not raise the period");
+
+    Cycle_Controller limited(1us, 320us, 1us);
+    Test::check(limited.update(100us, 50us) == 320us, "reserve limited to the upper bound");
+    Test::check(limited.at_max(), "reserve reaches the upper bound");
+    Test::check(limited.update(100us, 0ns) < 320us, "upper bound without reserve");
+}
+
+/**
+ * @brief min == max: fixed period
+ */
+static void test_fixed() {
+    Cycle_Controller controller(1ms, 1ms, 5ms);
+    Test::check(controller.get_period() == 1ms, "fixed initial period");
+    Test::check(controller.update(10ms, 0ns) == 1ms, "fixed period after a slow cycle");
+    Test::check(controller.update(1us, 0ns) == 1ms, "fixed period after a fast cycle");
+    Test::check(controller.update(1us, 5ms) == 1ms, "fixed period with reserve");
+    Test::check(controller.get_average_duration() > 1ms, "average duration is estimated");
+}
+
+int main() {
+    test_adaption();
+    test_limits();
+    test_reserve();
+    test_fixed();
+
+    Test::check_throws<std::invalid_argument>([]() { Cycle_Controller(2ms, 1ms, 1ms); },
+                                              "maximum less than minimum");
+
+    return Test::result();
+}
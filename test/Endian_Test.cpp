@@ -0,0 +1,119 @@
+/*
+ * Copyright (C) 2023 Nikolas Koesling <nikolas@koesling.info>.
+ * This program is free software. You can redistribute it and/or modify it under the terms of the MIT License.
+ */
+
+#include "Test.hpp"
+#include "endian.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// the same selection as endian::detail::swap_n (the test is compiled once per path, see test/CMakeLists.txt)
+#if defined(__AVX2__)
+static constexpr const char *PATH = "AVX2";
+#elif defined(__SSSE3__)
+static constexpr const char *PATH = "SSSE3";
+#elif defined(__SSE2__)
+static constexpr const char *PATH = "SSE2 (16 bit only)";
+#elif defined(__ARM_NEON)
+static constexpr const char *PATH = "NEON";
+#else
+static constexpr const char *PATH = "scalar";
+#endif
+
+static constexpr std::size_t MAX_VALUES = 80;    // more than two vectors of 16 bit values + tail
+static constexpr std::size_t GUARD      = 32;    // bytes behind the destination that must not be written
+static constexpr uint8_t     GUARD_BYTE = 0xA5;  // value of the guard bytes
+
+/**
+ * @brief check swap_n and big_to_host_n against a byte wise reference for all lengths up to MAX_VALUES
+ * @details
+ *      the lengths include multiples of the vector widths and all tails. Source and destination are misaligned by
+ *      every offset below the value size. The bytes behind the destination must not be written.
+ */
+template <typename T>
+static void check_swap(const std::string &type) {
+    constexpr std::size_t N = sizeof(T);
+
+    std::vector<uint8_t> source(MAX_VALUES * N + N);
+    for (std::size_t i = 0; i < source.size(); ++i)
+        source[i] = static_cast<uint8_t>(i * 7 + 3);
+
+    for (std::size_t offset = 0; offset < N; ++offset) {
+        for (std::size_t n = 0; n <= MAX_VALUES; ++n) {
+            const std::string name = type + " n=" + std::to_string(n) + " offset=" + std::to_string(offset);
+            const uint8_t    *src  = source.data() + offset;
+
+            // reference: reverse the bytes of each value
+            std::vector<uint8_t> expected(n * N);
+            for (std::size_t v = 0; v < n; ++v) {
+                for (std::size_t b = 0; b < N; ++b)
+                    expected[v * N + b] = src[v * N + N - 1 - b];
+            }
+
+            // out of place (unaligned destination)
+            std::vector<uint8_t> buffer(offset + n * N + GUARD, GUARD_BYTE);
+            endian::detail::swap_n<T>(buffer.data() + offset, src, n);
+            bool equal = std::equal(expected.begin(), expected.end(), buffer.begin() + static_cast<long>(offset));
+            Test::check(equal, "swap_n " + name);
+
+            bool guard = true;
+            for (std::size_t i = offset + n * N; i < buffer.size(); ++i)
+                guard = guard && buffer[i] == GUARD_BYTE;
+            Test::check(guard, "swap_n does not write behind the destination " + name);
+
+            // in place
+            std::vector<uint8_t> in_place(src, src + n * N);
+            endian::detail::swap_n<T>(in_place.data(), in_place.data(), n);
+            Test::check(in_place == expected, "swap_n in place " + name);
+
+            // typed interface: big endian to host and back
+            std::vector<T> values(n);
+            std::vector<T> host(n);
+            std::vector<T> big(n);
+            if (n) std::memcpy(values.data(), src, n * N);
+            endian::big_to_host_n(host.data(), values.data(), n);
+            for (std::size_t v = 0; v < n; ++v)
+                Test::check(host[v] == endian::big_to_host(values[v]), "big_to_host_n matches big_to_host " + name);
+            endian::host_to_big_n(big.data(), host.data(), n);
+            Test::check(big == values, "host_to_big_n round trip " + name);
+        }
+    }
+}
+
+/**
+ * @brief print the conversion time of a register image (not checked)
+ */
+static void benchmark() {
+    constexpr std::size_t SIZE       = 1020;  // analog input image of a coupler
+    constexpr std::size_t ITERATIONS = 20000;
+
+    std::vector<uint16_t> image(SIZE);
+    for (std::size_t i = 0; i < SIZE; ++i)
+        image[i] = static_cast<uint16_t>(i);
+
+    const auto start = std::chrono::steady_clock::now();
+    for (std::size_t i = 0; i < ITERATIONS; ++i)
+        endian::big_to_host_n(image.data(), image.data(), image.size());
+    const auto duration = std::chrono::steady_clock::now() - start;
+
+    std::cout << "big_to_host_n (" << PATH << "): " << std::chrono::nanoseconds(duration).count() / ITERATIONS
+              << "ns per " << SIZE << " registers\n";
+}
+
+int main() {
+    std::cout << "endian path: " << PATH << '\n';
+
+    check_swap<uint16_t>("uint16_t");
+    check_swap<uint32_t>("uint32_t");
+    check_swap<uint64_t>("uint64_t");
+
+    benchmark();
+    return Test::result();
+}
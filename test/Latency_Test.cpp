@@ -0,0 +1,79 @@
+/*
+ * Copyright (C) 2023 Nikolas Koesling <nikolas@koesling.info>.
+ * This program is free software. You can redistribute it and/or modify it under the terms of the MIT License.
+ */
+
+#include "Loopback_Server.hpp"
+#include "Modbus_Raw_TCP.hpp"
+#include "Test.hpp"
+
+#include <array>
+#include <chrono>
+#include <stdexcept>
+
+static constexpr std::chrono::microseconds DELAY(2000);  // injected response delay of the server
+static constexpr std::size_t               TRANSFERS = 20;
+
+int main() {
+    Loopback_Server server(DELAY);
+
+    // timestamping enabled: one sample per transfer, the wire time includes the response delay
+    {
+        Modbus_Raw_TCP modbus("127.0.0.1", server.get_service());
+        modbus.set_timestamping(true);
+        modbus.connect();
+        Test::check_throws<std::logic_error>([&modbus] { modbus.set_timestamping(false); },
+                                             "set_timestamping while connected");
+
+        std::array<uint16_t, 10> values {};
+        for (std::size_t i = 0; i < TRANSFERS; ++i)
+            modbus.read_ai(values.data(), 0x100, values.size());
+        Test::check(values[0] == 0x100 && values[9] == 0x109, "register values");
+
+        const auto *latency = modbus.get_latency();
+        Test::check(latency != nullptr, "latency available with timestamping");
+        if (latency) {
+            Test::check(latency->samples + latency->missing == TRANSFERS, "one sample per transfer");
+            Test::check(latency->samples > 0, "samples with timestamps");
+            Test::check(latency->wire >= DELAY, "average wire time >= delay");
+            Test::check(latency->wire_max >= latency->wire, "maximum wire time >= average");
+            Test::check(latency->overhead.count() >= 0, "overhead not negative");
+        }
+        modbus.disconnect();
+    }
+
+    // pipelined transfer: one sample for all requests, the server delays each response
+    {
+        Modbus_Raw_TCP modbus("127.0.0.1", server.get_service());
+        modbus.set_timestamping(true);
+        modbus.connect();
+
+        std::array<uint16_t, 3> values {};
+        const auto              handle = modbus.prepare({
+                {Modbus_Transport::Function::READ_INPUT_REGISTERS, 0, 1, &values[0]},
+                {Modbus_Transport::Function::READ_INPUT_REGISTERS, 1, 1, &values[1]},
+                {Modbus_Transport::Function::READ_INPUT_REGISTERS, 2, 1, &values[2]},
+        });
+        modbus.execute(handle);
+        Test::check(values[0] == 0 && values[1] == 1 && values[2] == 2, "pipelined register values");
+
+        const auto *latency = modbus.get_latency();
+        if (latency && latency->samples == 1)
+            Test::check(latency->wire >= 3 * DELAY, "pipelined wire time >= delay of all responses");
+        else Test::check(false, "pipelined transfer: one sample");
+        modbus.disconnect();
+    }
+
+    // timestamping disabled: no latency statistics
+    {
+        Modbus_Raw_TCP modbus("127.0.0.1", server.get_service());
+        modbus.connect();
+
+        std::array<uint16_t, 10> values {};
+        modbus.read_ai(values.data(), 0, values.size());
+        Test::check(modbus.get_latency() == nullptr, "no latency without timestamping");
+        modbus.disconnect();
+    }
+
+    return Test::result();
+}
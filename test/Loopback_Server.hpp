@@ -0,0 +1,183 @@
+/*
+ * Copyright (C) 2023 Nikolas Koesling <nikolas@koesling.info>.
+ * This program is free software. You can redistribute it and/or modify it under the terms of the MIT License.
+ */
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <string>
+#include <sys/socket.h>
+#include <system_error>
+#include <thread>
+#include <unistd.h>
+
+/**
+ * @brief minimal Modbus TCP server on the loopback interface
+ * @details
+ *      Answers the process data functions of Modbus_Transport after an injected delay.
+ *      Read registers return the address of each register as value, read bits return every second bit set.
+ *      Write requests are acknowledged without storing the values.
+ *
+ *      The server listens on an ephemeral port (see get_service) and serves one connection at a time.
+ */
+class Loopback_Server final {
+private:
+    int                        listen_sock = -1;  // listening socket
+    std::atomic<int>           client_sock {-1};  // socket of the current connection
+    std::atomic<bool>          stop {false};      // terminate the server thread
+    std::chrono::microseconds  delay;             // delay of each response
+    std::string                service;           // port of the server
+    std::thread                thread;            // server thread
+    std::atomic<std::uint64_t> requests {0};      // number of answered requests
+
+public:
+    /**
+     * @brief start server
+     * @param delay delay of each response
+     *
+     * @exception std::system_error failed to create the listening socket
+     */
+    explicit Loopback_Server(std::chrono::microseconds delay = std::chrono::microseconds(0)) : delay(delay) {
+        listen_sock = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (listen_sock == -1) throw std::system_error(errno, std::generic_category(), "socket");
+
+        sockaddr_in address {};
+        address.sin_family      = AF_INET;
+        address.sin_port        = 0;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        socklen_t length        = sizeof(address);
+        if (bind(listen_sock, reinterpret_cast<sockaddr *>(&address), sizeof(address)) == -1 ||
+            listen(listen_sock, 1) == -1 ||
+            getsockname(listen_sock, reinterpret_cast<sockaddr *>(&address), &length) == -1) {
+            const int error = errno;
+            close(listen_sock);
+            throw std::system_error(error, std::generic_category(), "failed to create loopback server");
+        }
+
+        service = std::to_string(ntohs(address.sin_port));
+        thread  = std::thread(&Loopback_Server::run, this);
+    }
+
+    ~Loopback_Server() {
+        stop.store(true);
+        shutdown(listen_sock, SHUT_RDWR);
+        const int client = client_sock.load();
+        if (client != -1) shutdown(client, SHUT_RDWR);
+        thread.join();
+        close(listen_sock);
+    }
+
+    Loopback_Server(const Loopback_Server &other)            = delete;
+    Loopback_Server(Loopback_Server &&other)                 = delete;
+    Loopback_Server &operator=(const Loopback_Server &other) = delete;
+    Loopback_Server &operator=(Loopback_Server &&other)      = delete;
+
+    /**
+     * @brief port of the server (service argument of the modbus transports)
+     */
+    [[nodiscard]] const std::string &get_service() const noexcept { return service; }
+
+    /**
+     * @brief number of answered requests
+     */
+    [[nodiscard]] std::uint64_t get_requests() const noexcept { return requests.load(); }
+
+private:
+    void run() {
+        while (!stop.load()) {
+            const int client = accept4(listen_sock, nullptr, nullptr, SOCK_CLOEXEC);
+            if (client == -1) {
+                if (errno == EINTR || errno == ECONNABORTED) continue;
+                return;
+            }
+
+            // responses are sent immediately (like a coupler)
+            const int flag = 1;
+            setsockopt(client, IPPROTO_TCP, TCP_NODELAY, &flag, sizeof(flag));
+
+            client_sock.store(client);
+            if (stop.load()) shutdown(client, SHUT_RDWR);
+            serve(client);
+            client_sock.store(-1);
+            close(client);
+        }
+    }
+
+    static bool receive(int sock, uint8_t *data, std::size_t size) {
+        while (size) {
+            const auto received = recv(sock, data, size, 0);
+            if (received == -1 && errno == EINTR) continue;
+            if (received <= 0) return false;
+            data += received;
+            size -= static_cast<std::size_t>(received);
+        }
+        return true;
+    }
+
+    static void put_u16(uint8_t *dst, std::size_t value) {
+        dst[0] = static_cast<uint8_t>((value >> 8u) & 0xFFu);
+        dst[1] = static_cast<uint8_t>(value & 0xFFu);
+    }
+
+    void serve(int sock) {
+        std::array<uint8_t, 260> request {};
+        std::array<uint8_t, 260> response {};
+
+        // MBAP header, then unit id + PDU
+        while (receive(sock, request.data(), 7)) {
+            const std::size_t length = static_cast<std::size_t>(request[4] << 8u | request[5]);
+            if (length < 2 || length > request.size() - 6 || !receive(sock, request.data() + 7, length - 1)) return;
+
+            const uint8_t     function = request[7];
+            const std::size_t addr     = static_cast<std::size_t>(request[8] << 8u | request[9]);
+            const std::size_t size     = static_cast<std::size_t>(request[10] << 8u | request[11]);
+
+            std::memcpy(response.data(), request.data(), 4);
+            response[6] = request[6];
+            response[7] = function;
+
+            std::size_t pdu_size = 0;
+            switch (function) {
+                case 0x01:
+                case 0x02: {
+                    const std::size_t bytes = (size + 7) / 8;
+                    response[8]             = static_cast<uint8_t>(bytes);
+                    std::memset(response.data() + 9, 0x55, bytes);
+                    pdu_size = 2 + bytes;
+                    break;
+                }
+                case 0x03:
+                case 0x04:
+                    response[8] = static_cast<uint8_t>(size * 2);
+                    for (std::size_t i = 0; i < size; ++i)
+                        put_u16(response.data() + 9 + 2 * i, addr + i);
+                    pdu_size = 2 + size * 2;
+                    break;
+                case 0x0F:
+                case 0x10:
+                    std::memcpy(response.data() + 8, request.data() + 8, 4);
+                    pdu_size = 5;
+                    break;
+                default:
+                    // illegal function
+                    response[7] = static_cast<uint8_t>(function | 0x80);
+                    response[8] = 0x01;
+                    pdu_size    = 2;
+                    break;
+            }
+            put_u16(response.data() + 4, pdu_size + 1);
+
+            if (delay.count()) std::this_thread::sleep_for(delay);
+            if (send(sock, response.data(), 7 + pdu_size, MSG_NOSIGNAL) == -1) return;
+            ++requests;
+        }
+    }
+};
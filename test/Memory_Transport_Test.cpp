@@ -0,0 +1,276 @@
+/*
+ * Copyright (C) 2023 Nikolas Koesling <nikolas@koesling.info>.
+ * This program is free software. You can redistribute it and/or modify it under the terms of the MIT License.
+ */
+
+#include "Coupler_Status.hpp"
+#include "Modbus_Memory_Transport.hpp"
+#include "Output_Ownership.hpp"
+#include "Output_Transaction.hpp"
+#include "Test.hpp"
+#include "WAGO_MB_TCP_Coupler.hpp"
+#include "cxxshm.hpp"
+
+#include <array>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <unistd.h>
+
+// coupler constants (see TCP_Coupler_SHM::check_constants)
+static constexpr uint16_t CONSTANTS_ADDR = 0x2000;
+static constexpr uint16_t CONSTANTS[]    = {0x0000, 0xFFFF, 0x1234, 0xAAAA, 0x5555, 0x7FFF, 0x8000, 0x3FFF, 0x4000};
+
+static constexpr uint16_t CLAMPCONFIG_ADDR = 0x2030;
+static constexpr uint16_t OUTPUT_ADDR      = 0x0200;  // first output in the coil / register table
+
+// coupler, 750-453 (4 AI), 8 DI, 4 DO, 750-553 (4 AO)
+static constexpr uint16_t    CLAMPCONFIG[] = {0x0352, 453, 0x8801, 0x8402, 553};
+static constexpr std::size_t AI_SIZE       = 4;
+static constexpr std::size_t AO_SIZE       = 4;
+static constexpr std::size_t DI_SIZE       = 8;
+static constexpr std::size_t DO_SIZE       = 4;
+
+static constexpr std::size_t CYCLES = 200;
+
+static constexpr uint16_t                  PROCESS_IMAGE_BITS_ADDR = 0x1022;  // AO size in bits (first of four)
+static constexpr std::chrono::milliseconds DIAGNOSTICS_INTERVAL(1);
+
+/**
+ * @brief prefix of the shared memories of the coupler
+ */
+static std::string shm_prefix() {
+    return "test_memory_" + std::to_string(getpid()) + '_';
+}
+
+/**
+ * @brief create coupler that is connected to a memory transport
+ * @param memory set to the memory transport (owned by the coupler)
+ */
+static std::unique_ptr<WAGO_Modbus::TCP_Coupler_SHM> make_coupler(Modbus_Memory_Transport *&memory) {
+    auto transport = std::make_unique<Modbus_Memory_Transport>(42);
+    memory         = transport.get();
+
+    for (std::size_t i = 0; i < std::size(CONSTANTS); ++i)
+        memory->get_input_registers()[CONSTANTS_ADDR + i] = CONSTANTS[i];
+    for (std::size_t i = 0; i < std::size(CLAMPCONFIG); ++i)
+        memory->get_holding_registers()[CLAMPCONFIG_ADDR + i] = CLAMPCONFIG[i];
+
+    auto coupler = std::make_unique<WAGO_Modbus::TCP_Coupler_SHM>(std::move(transport));
+    coupler->set_diagnostics_interval(DIAGNOSTICS_INTERVAL);
+    coupler->init(shm_prefix(), true);
+    return coupler;
+}
+
+/**
+ * @brief random inputs are fetched to the image, random outputs are sent to the device
+ */
+static void
+        check_round_trip(WAGO_Modbus::TCP_Coupler_SHM &coupler, Modbus_Memory_Transport &memory, std::mt19937 &rng) {
+    std::uniform_int_distribution<unsigned> word(0, 0xFFFF);
+
+    for (std::size_t cycle = 0; cycle < CYCLES; ++cycle) {
+        for (std::size_t i = 0; i < AI_SIZE; ++i)
+            memory.get_input_registers()[i] = static_cast<uint16_t>(word(rng));
+        for (std::size_t i = 0; i < DI_SIZE; ++i)
+            memory.get_discrete_inputs()[i] = static_cast<uint8_t>(word(rng) & 1u);
+
+        coupler.fetch_image();
+
+        bool inputs = true;
+        for (std::size_t i = 0; i < AI_SIZE; ++i)
+            inputs = inputs && coupler.read_ai(i) == memory.get_input_registers()[i];
+        for (std::size_t i = 0; i < DI_SIZE; ++i)
+            inputs = inputs && coupler.read_di(i) == static_cast<bool>(memory.get_discrete_inputs()[i]);
+        Test::check(inputs, "inputs round trip (cycle " + std::to_string(cycle) + ')');
+
+        std::array<uint16_t, AO_SIZE> ao {};
+        std::array<bool, DO_SIZE>     do_ {};
+        for (std::size_t i = 0; i < AO_SIZE; ++i) {
+            ao[i] = static_cast<uint16_t>(word(rng));
+            coupler.write_ao(i, ao[i]);
+        }
+        for (std::size_t i = 0; i < DO_SIZE; ++i) {
+            do_[i] = word(rng) & 1u;
+            coupler.write_do(i, do_[i]);
+        }
+
+        coupler.send_image();
+
+        bool outputs = true;
+        for (std::size_t i = 0; i < AO_SIZE; ++i)
+            outputs = outputs && memory.get_holding_registers()[OUTPUT_ADDR + i] == ao[i];
+        for (std::size_t i = 0; i < DO_SIZE; ++i)
+            outputs = outputs && static_cast<bool>(memory.get_coils()[OUTPUT_ADDR + i]) == do_[i];
+        Test::check(outputs, "outputs round trip (cycle " + std::to_string(cycle) + ')');
+    }
+}
+
+/**
+ * @brief each transaction takes at least the simulated latency; prints the cycle time (not checked)
+ */
+static void check_latency(WAGO_Modbus::TCP_Coupler_SHM &coupler, Modbus_Memory_Transport &memory) {
+    for (const auto latency : {std::chrono::microseconds(0), std::chrono::microseconds(50)}) {
+        memory.set_latency(latency);
+
+        const auto transactions = memory.get_transaction_count();
+        const auto start        = std::chrono::steady_clock::now();
+        for (std::size_t cycle = 0; cycle < CYCLES; ++cycle) {
+            coupler.fetch_image();
+            coupler.send_image();
+        }
+        const auto duration = std::chrono::steady_clock::now() - start;
+        const auto count    = memory.get_transaction_count() - transactions;
+
+        Test::check(count >= 2 * CYCLES, "at least one transaction per fetch and send");
+        Test::check(duration >= static_cast<long>(count) * latency, "transactions take the simulated latency");
+
+        std::cout << "latency " << latency.count() << "us: " << std::chrono::nanoseconds(duration).count() / CYCLES
+                  << "ns per cycle (" << count / CYCLES << " transactions)\n";
+    }
+    memory.set_latency(std::chrono::nanoseconds(0));
+}
+
+/**
+ * @brief injected faults fail the cycle, the next cycle transfers the images again
+ */
+static void check_faults(WAGO_Modbus::TCP_Coupler_SHM &coupler, Modbus_Memory_Transport &memory, std::mt19937 &rng) {
+    memory.get_input_registers()[0] = 0x1111;
+    memory.inject_faults(1);
+    Test::check_throws<std::runtime_error>([&coupler] { coupler.fetch_image(); }, "injected fault in fetch_image");
+
+    coupler.fetch_image();
+    Test::check(coupler.read_ai(0) == 0x1111, "image fetched after the fault");
+
+    coupler.write_ao(0, 0x2222);
+    memory.inject_faults(1);
+    Test::check_throws<std::runtime_error>([&coupler] { coupler.send_image(); }, "injected fault in send_image");
+    coupler.send_image();
+    Test::check(memory.get_holding_registers()[OUTPUT_ADDR] == 0x2222, "image sent after the fault");
+
+    memory.set_fault_rate(1.0);
+    Test::check_throws<std::runtime_error>([&coupler] { coupler.fetch_image(); }, "fault rate 1");
+    memory.set_fault_rate(0.0);
+
+    Test::check_throws<std::invalid_argument>([&memory] { memory.set_fault_rate(1.5); }, "fault rate out of range");
+
+    // the images still round trip after the faults
+    check_round_trip(coupler, memory, rng);
+}
+
+/**
+ * @brief a transaction that is never committed blocks the outputs only until it is aborted
+ */
+static void check_transaction_abort(WAGO_Modbus::TCP_Coupler_SHM &coupler, Modbus_Memory_Transport &memory) {
+    namespace Output_Transaction = WAGO_Modbus::Output_Transaction;
+
+    cxxshm::SharedMemory ao_shm(shm_prefix() + "AO");
+    cxxshm::SharedMemory status_shm(shm_prefix() + "STATUS", true);
+    auto                *ao      = ao_shm.get_addr<uint16_t *>();
+    auto                &trailer = *Output_Transaction::trailer(ao, AO_SIZE * sizeof(uint16_t));
+    const auto          &status  = *status_shm.get_addr<const WAGO_Modbus::Coupler_Status::Status *>();
+
+    auto aborts = [&status]() {
+        uint64_t value = 0;
+        WAGO_Modbus::Coupler_Status::read(status, [&value](const auto &s) { value = s.transaction_aborts; });
+        return value;
+    };
+
+    auto *first  = Output_Transaction::attach(trailer, 1);
+    auto *second = Output_Transaction::attach(trailer, 2);
+    Test::check(first && second && first != second, "writers attach to separate entries");
+    if (!first || !second) return;
+
+    // committed transaction
+    Test::check(Output_Transaction::transaction(*second, [ao]() { ao[0] = 0x1234; }), "transaction committed");
+    coupler.send_image();
+    Test::check(memory.get_holding_registers()[OUTPUT_ADDR] == 0x1234, "committed transaction sent");
+
+    // writer terminates during a transaction
+    Output_Transaction::begin(*first);
+    ao[0] = 0x4321;
+    for (std::size_t cycle = 1; cycle < Output_Transaction::TIMEOUT_CYCLES; ++cycle)
+        coupler.send_image();
+    Test::check(memory.get_holding_registers()[OUTPUT_ADDR] == 0x1234, "transaction in progress not sent");
+    Test::check(aborts() == 0, "no transaction aborted before the timeout");
+
+    coupler.send_image();
+    Test::check(memory.get_holding_registers()[OUTPUT_ADDR] == 0x4321, "aborted transaction sent");
+    Test::check(aborts() == 1, "aborted transaction counted in the status");
+    Test::check(!Output_Transaction::commit(*first), "commit of an aborted transaction fails");
+    Test::check(first->token.load() == 0, "entry of the aborted transaction released");
+
+    // the other writer is not affected
+    Test::check(second->token.load() == 2, "entry of the other writer kept");
+    Test::check(Output_Transaction::transaction(*second, [ao]() { ao[0] = 0x5678; }), "transaction after abort");
+    coupler.send_image();
+    Test::check(memory.get_holding_registers()[OUTPUT_ADDR] == 0x5678, "transaction after abort sent");
+    Output_Transaction::detach(*second, 2);
+}
+
+/**
+ * @brief the ownership of a writer that stops renewing its lease is released, a renewing writer keeps it
+ */
+static void check_ownership_lease(WAGO_Modbus::TCP_Coupler_SHM &coupler) {
+    namespace Output_Ownership = WAGO_Modbus::Output_Ownership;
+
+    cxxshm::SharedMemory owners_shm(shm_prefix() + "OWNERS");
+    auto                &header = *owners_shm.get_addr<Output_Ownership::Header *>();
+    Test::check(header.clamp_count >= 2, "output ownership slots");
+    if (header.clamp_count < 2) return;
+
+    Test::check(Output_Ownership::claim(header, 0, 1), "first writer claims module 0");
+    Test::check(Output_Ownership::claim(header, 1, 2), "second writer claims module 1");
+
+    for (std::size_t check = 0; check <= Output_Ownership::LEASE_INTERVALS; ++check) {
+        std::this_thread::sleep_for(2 * DIAGNOSTICS_INTERVAL);
+        Output_Ownership::renew(header, 1, 2);
+        coupler.send_image();
+    }
+
+    Test::check(Output_Ownership::slots(header)[0].owner.load() == 0, "expired lease released");
+    Test::check(!Output_Ownership::renew(header, 0, 1), "expired lease can not be renewed");
+    Test::check(Output_Ownership::slots(header)[1].owner.load() == 2, "renewed lease kept");
+    Output_Ownership::release(header, 1, 2);
+}
+
+/**
+ * @brief the outputs of the coupler are kept if the images are recreated
+ */
+static void check_relayout(WAGO_Modbus::TCP_Coupler_SHM &coupler, Modbus_Memory_Transport &memory) {
+    coupler.write_ao(1, 0x3333);
+    coupler.write_do(1, true);
+    coupler.send_image();
+
+    // the coupler reports other image sizes: the images are recreated by the diagnostics
+    const auto generation = coupler.get_layout_generation();
+    memory.get_input_registers()[PROCESS_IMAGE_BITS_ADDR] ^= 0x10;
+    std::this_thread::sleep_for(DIAGNOSTICS_INTERVAL);
+    for (std::size_t step = 0; step < 4 && coupler.get_layout_generation() == generation; ++step)
+        coupler.poll_diagnostics();
+    Test::check(coupler.get_layout_generation() == generation + 1, "images recreated");
+
+    Test::check(coupler.read_ao(1) == 0x3333 && coupler.read_do(1), "outputs read back to the new images");
+    coupler.send_image();
+    Test::check(memory.get_holding_registers()[OUTPUT_ADDR + 1] == 0x3333, "analog output kept after relayout");
+    Test::check(memory.get_coils()[OUTPUT_ADDR + 1], "digital output kept after relayout");
+}
+
+int main() {
+    Modbus_Memory_Transport *memory  = nullptr;
+    auto                     coupler = make_coupler(memory);
+    std::mt19937             rng(1);
+
+    check_round_trip(*coupler, *memory, rng);
+    check_latency(*coupler, *memory);
+    check_faults(*coupler, *memory, rng);
+    check_transaction_abort(*coupler, *memory);
+    check_ownership_lease(*coupler);
+    check_relayout(*coupler, *memory);
+
+    return Test::result();
+}
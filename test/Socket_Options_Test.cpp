@@ -0,0 +1,85 @@
+/*
+ * Copyright (C) 2023 Nikolas Koesling <nikolas@koesling.info>.
+ * This program is free software. You can redistribute it and/or modify it under the terms of the MIT License.
+ */
+
+#include "Loopback_Server.hpp"
+#include "Modbus_Raw_TCP.hpp"
+#include "Test.hpp"
+
+#include <array>
+#include <chrono>
+#include <iostream>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <string>
+#include <sys/socket.h>
+
+static constexpr std::size_t TRANSFERS = 2000;
+
+/**
+ * @brief loopback benchmark of the raw backend with and without TCP_NODELAY and TCP_QUICKACK
+ * @details
+ *      TCP_NODELAY is always set by the transports (see Modbus_Transport::Socket_Options). For the comparison, it is
+ *      cleared on the connected socket. The round trip times are printed (not checked), the register values and the
+ *      socket options are checked.
+ */
+static void benchmark(const Loopback_Server &server, bool nodelay, bool quick_ack, bool pipelining) {
+    const std::string name = std::string(nodelay ? "TCP_NODELAY" : "Nagle") + (quick_ack ? " + TCP_QUICKACK" : "") +
+                             (pipelining ? ", pipelined" : "");
+
+    Modbus_Raw_TCP modbus("127.0.0.1", server.get_service(), pipelining);
+    modbus.set_timestamping(true);
+
+    Modbus_Transport::Socket_Options options;
+    options.quick_ack = quick_ack;
+    modbus.set_socket_options(options);
+    modbus.connect();
+
+    int       flag   = 0;
+    socklen_t length = sizeof(flag);
+    getsockopt(modbus.get_socket(), IPPROTO_TCP, TCP_NODELAY, &flag, &length);
+    Test::check(flag != 0, name + ": TCP_NODELAY set by connect");
+
+    if (!nodelay) {
+        flag = 0;
+        setsockopt(modbus.get_socket(), IPPROTO_TCP, TCP_NODELAY, &flag, sizeof(flag));
+    }
+
+    // inputs and outputs of a small coupler in one transfer
+    std::array<uint16_t, 8> ai {};
+    std::array<uint16_t, 4> ao {1, 2, 3, 4};
+    std::array<uint8_t, 16> di {};
+    const auto              handle = modbus.prepare({
+            {Modbus_Transport::Function::READ_INPUT_REGISTERS, 0x10, ai.size(), ai.data()},
+            {Modbus_Transport::Function::READ_DISCRETE_INPUTS, 0, di.size(), di.data()},
+            {Modbus_Transport::Function::WRITE_MULTIPLE_REGISTERS, 0x200, ao.size(), ao.data()},
+    });
+
+    const auto start = std::chrono::steady_clock::now();
+    for (std::size_t i = 0; i < TRANSFERS; ++i)
+        modbus.execute(handle);
+    const auto duration = std::chrono::steady_clock::now() - start;
+
+    Test::check(ai[0] == 0x10 && ai[7] == 0x17 && di[0] == 1 && di[1] == 0, name + ": values");
+
+    std::cout << name << ": " << std::chrono::nanoseconds(duration).count() / TRANSFERS << "ns per transfer";
+    if (const auto *latency = modbus.get_latency())
+        std::cout << " (wire " << latency->wire.count() << "ns, overhead " << latency->overhead.count() << "ns)";
+    std::cout << '\n';
+
+    modbus.disconnect();
+}
+
+int main() {
+    Loopback_Server server;
+
+    for (const bool pipelining : {true, false}) {
+        for (const bool nodelay : {true, false}) {
+            for (const bool quick_ack : {false, true})
+                benchmark(server, nodelay, quick_ack, pipelining);
+        }
+    }
+
+    return Test::result();
+}
@@ -0,0 +1,60 @@
+/*
+ * Copyright (C) 2023 Nikolas Koesling <nikolas@koesling.info>.
+ * This program is free software. You can redistribute it and/or modify it under the terms of the MIT License.
+ */
+
+#pragma once
+
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+/**
+ * @brief minimal test helpers
+ * @details
+ *      Each test is an executable that returns EXIT_FAILURE if a check failed (see add_coupler_test in
+ *      test/CMakeLists.txt). Failed checks are written to std::cerr.
+ */
+namespace Test {
+
+inline int failures = 0;  //*< number of failed checks
+
+/**
+ * @brief check a condition
+ * @param condition condition that must be true
+ * @param description description of the check (written if the check failed)
+ */
+inline void check(bool condition, const std::string &description) {
+    if (condition) return;
+    ++failures;
+    std::cerr << "FAILED: " << description << '\n';
+}
+
+/**
+ * @brief check that a function throws an exception of the given type
+ * @tparam Exception expected exception type
+ * @param function function that is called
+ * @param description description of the check (written if the check failed)
+ */
+template <typename Exception, typename Function>
+void check_throws(Function &&function, const std::string &description) {
+    try {
+        function();
+    } catch (const Exception &) {
+        return;
+    } catch (...) {
+        check(false, description + " (unexpected exception type)");
+        return;
+    }
+    check(false, description + " (no exception)");
+}
+
+/**
+ * @brief result of the test (return value of main)
+ */
+inline int result() {
+    if (failures) std::cerr << failures << " checks failed\n";
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+}  // namespace Test